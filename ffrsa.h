@@ -22,6 +22,11 @@ extern "C" {
 #endif
 
 typedef struct FFRSA ffrsa_t;
+typedef struct FFRSA_KEY ffrsa_key_t;
+typedef struct FFRSA_CTX ffrsa_ctx_t;
+typedef struct FFRSA_POOL ffrsa_pool_t;
+typedef struct FFRSA_RING ffrsa_ring_t;
+typedef struct FFRSA_KEYPOOL ffrsa_keypool_t;
 
 //Create rsa key with specified number of bits.
 //Returns NULL if bits is too small due to the used padding scheme.
@@ -29,8 +34,20 @@ typedef struct FFRSA ffrsa_t;
 //it generates a key. Performance sensitive applications should
 //already have the key saved and the handle created using one of the
 //ffrsa_create_from functions.
+//The prime search runs on every online CPU core.
 ffrsa_t* ffrsa_create(uint32_t bits);
 
+//Same as ffrsa_create, but the prime search uses num_threads threads. p and q are
+//searched for concurrently when num_threads is at least 2. Pass 1 to generate the
+//key on the calling thread only.
+ffrsa_t* ffrsa_create_parallel(uint32_t bits, uint32_t num_threads);
+
+//Same as ffrsa_create, but all randomness used to generate the key is derived from
+//seed through SHAKE256. The same seed always produces a bit-identical key, regardless
+//of the number of threads used. This is meant for reproducible benchmarks and tests.
+//The key is only as secret as the seed.
+ffrsa_t* ffrsa_create_seeded(uint32_t bits, const uint8_t* seed, int seed_len);
+
 //Create rsa key from a public key buffer. Keys created in this manner can
 //only encrypt.
 ffrsa_t* ffrsa_create_from_public_key(const uint8_t* key);
@@ -59,7 +76,11 @@ int ffrsa_get_public_key(ffrsa_t* rsa, uint8_t* key, int size_bytes);
 //of the RSA key.
 int ffrsa_get_max_msg_len(ffrsa_t* rsa);
 
+//Get the size in bytes of every ciphertext produced by ffrsa_encrypt, which is the byte length of the modulus.
+int ffrsa_get_ciphertext_len(ffrsa_t* rsa);
+
 //Max value of msg_len is dictated by the bit length of the RSA key.
+//The ciphertext is always ffrsa_get_ciphertext_len bytes long.
 //Returns 0 on success and 1 on error.
 int ffrsa_encrypt(ffrsa_t* rsa, uint8_t* src, int msg_len);
 
@@ -72,6 +93,109 @@ int ffrsa_decrypt(ffrsa_t* rsa, uint8_t* src, int msg_len);
 //number of bytes of the result.
 void ffrsa_get_result(ffrsa_t* rsa, uint8_t** result, int* msg_len);
 
+//An ffrsa_t holds the key and the scratch its encryptions and decryptions write to, so it can only be
+//used by one thread at a time. To use one key from many threads, give each thread its own context of
+//the key returned by ffrsa_get_key. The key is never modified after creation, and functions that only
+//read it (getting key buffers and sizes) may be called on rsa from any thread.
+
+//Returns the key of rsa. It belongs to rsa, which must outlive every context created for it.
+const ffrsa_key_t* ffrsa_get_key(ffrsa_t* rsa);
+
+//Create a context for encrypting and decrypting with key on one thread. Each context is
+//allocated on its own cache lines, so threads using different contexts don't slow each other down.
+ffrsa_ctx_t* ffrsa_ctx_create(const ffrsa_key_t* key);
+void ffrsa_ctx_destroy(ffrsa_ctx_t* ctx);
+
+//Same as ffrsa_encrypt, ffrsa_decrypt and ffrsa_get_result, but the scratch and the result buffer
+//are those of ctx.
+int ffrsa_ctx_encrypt(ffrsa_ctx_t* ctx, uint8_t* src, int msg_len);
+int ffrsa_ctx_decrypt(ffrsa_ctx_t* ctx, uint8_t* src, int msg_len);
+void ffrsa_ctx_get_result(ffrsa_ctx_t* ctx, uint8_t** result, int* msg_len);
+
+//Operations that batches and rings run.
+#define FFRSA_OP_ENCRYPT 0
+#define FFRSA_OP_DECRYPT 1
+
+//Create a pool of num_threads workers that run batches of operations with key, each with its own
+//context. The thread calling a batch function is one of the workers, so num_threads-1 threads are
+//started. Pass 0 for num_threads to use every online CPU core. key must outlive the pool.
+//NULL is returned on error.
+ffrsa_pool_t* ffrsa_pool_create(const ffrsa_key_t* key, int num_threads);
+
+//Stops the threads of the pool. No batch may be running on it.
+void ffrsa_pool_destroy(ffrsa_pool_t* pool);
+
+//Encrypts or decrypts the count messages src[i] of msg_lens[i] bytes on the workers of pool. Each
+//worker starts on its own share of the messages and takes over messages of other workers once it is
+//done with its own. The result of message i is written to out + i*out_stride, its length to out_lens[i]
+//and what ffrsa_encrypt or ffrsa_decrypt would have returned for it to status[i]. A result longer than
+//out_stride fails with status 1. out_stride should be ffrsa_get_ciphertext_len when encrypting and
+//ffrsa_get_max_msg_len when decrypting. Batches on one pool run one after another. Returns 0 if
+//every message succeeded and 1 otherwise.
+int ffrsa_encrypt_batch(ffrsa_pool_t* pool, uint8_t* const* src, const int* msg_lens, int count, uint8_t* out, int out_stride, int* out_lens, int* status);
+int ffrsa_decrypt_batch(ffrsa_pool_t* pool, uint8_t* const* src, const int* msg_lens, int count, uint8_t* out, int out_stride, int* out_lens, int* status);
+
+//A request posted to a ring. src and out must stay valid until its completion is reaped.
+typedef struct FFRSA_SQE
+{
+	uint64_t user_tag; //copied to the completion
+	int op; //FFRSA_OP_ENCRYPT or FFRSA_OP_DECRYPT
+	uint8_t* src;
+	int src_len;
+	uint8_t* out; //receives the result
+	int out_size;
+} ffrsa_sqe_t;
+
+typedef struct FFRSA_CQE
+{
+	uint64_t user_tag;
+	int status; //what ffrsa_encrypt or ffrsa_decrypt would have returned, or 1 if out was too small
+	int out_len;
+} ffrsa_cqe_t;
+
+//Create a ring that runs requests for key on num_threads worker threads, so that the threads posting
+//them never wait for an operation. Pass 0 for num_threads to use every online CPU core. The
+//submission queue holds entries requests, rounded up to a power of 2, and twice as many may be in
+//flight before completions have to be reaped. Posting and reaping take no locks, and any thread may
+//do either. Rings need eventfd and are only available on Linux. key must outlive the ring.
+//NULL is returned on error.
+ffrsa_ring_t* ffrsa_ring_create(const ffrsa_key_t* key, uint32_t entries, int num_threads);
+
+//Stops the workers once they have run every submitted request. Completions that weren't reaped are lost.
+void ffrsa_ring_destroy(ffrsa_ring_t* ring);
+
+//Returns an eventfd that is readable while completions are waiting to be reaped, for adding the ring
+//to an event loop. It belongs to the ring, and only ffrsa_ring_reap may read it.
+int ffrsa_ring_get_fd(ffrsa_ring_t* ring);
+
+//Posts up to count requests. Returns the number posted, which is less than count if the submission
+//queue is full or too many requests are in flight.
+int ffrsa_ring_submit(ffrsa_ring_t* ring, const ffrsa_sqe_t* sqes, int count);
+
+//Copies up to max completions into cqes without blocking and returns how many there were.
+int ffrsa_ring_reap(ffrsa_ring_t* ring, ffrsa_cqe_t* cqes, int max);
+
+//Same as ffrsa_ring_reap, but blocks until at least one completion is there.
+int ffrsa_ring_wait(ffrsa_ring_t* ring, ffrsa_cqe_t* cqes, int max);
+
+//Create a pool that keeps pool_size freshly generated keys ready for each of the num_sizes
+//bit lengths in bits. Keys are generated and refilled by num_threads low priority background
+//threads so that applications needing new keys don't block on ffrsa_create. NULL is returned
+//on error.
+ffrsa_keypool_t* ffrsa_keypool_create(const uint32_t* bits, int num_sizes, int pool_size, int num_threads);
+
+//Stops the background threads and destroys any keys left in the pool. This blocks until key
+//generations already in progress finish.
+void ffrsa_keypool_destroy(ffrsa_keypool_t* pool);
+
+//Take a ready key with the specified number of bits out of the pool without blocking on key
+//generation. The returned key belongs to the caller and must be destroyed with ffrsa_destroy.
+//Returns NULL if the pool has no key of that size ready.
+ffrsa_t* ffrsa_keypool_take(ffrsa_keypool_t* pool, uint32_t bits);
+
+//Returns the number of keys with the specified number of bits ready to be taken.
+int ffrsa_keypool_get_ready_count(ffrsa_keypool_t* pool, uint32_t bits);
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,20 +12,44 @@
 #include "ffmem.h"
 #include "fflog.h"
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
-#include <math.h>
-#include <list>
+#include <vector>
+#include <atomic>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "fftime.h"
+#include "ffrand.h"
 
-#define FFBI_RAND_BITS 16
 #define FFBI_REALLOC_GROWTH_FACTOR 2.0
 #define FFBI_DIV_DEBUG 0
+//Fewest digits a bigint is created with. It is a floor the API relies on rather than a crossover:
+//ffbi_create_reserved_bits, ffbi_create_preallocated and the prime generators reject smaller sizes,
+//and ffbi_create already starts with FFBI_INLINE_DIGITS, so it doesn't decide allocation sizes and
+//ffbi_tune doesn't measure it.
 #define FFBI_MIN_ALLOC_DIGITS 3
-#define FFBI_PRIME_TEST_NUM_SCRATCHES 4
-#define FFBI_MOD_POW_NUM_SCRATCHES 6
+//ffbi_create reserves enough inline digits for a value of this many bits plus a carry
+#define FFBI_INLINE_BITS 2048
+#define FFBI_INLINE_DIGITS (FFBI_INLINE_BITS/FFBI_BITS_PER_DIGIT + 2)
+#define FFBI_PRIME_TEST_NUM_VALS 5
+#define FFBI_MOD_POW_NUM_VALS 5
+#define FFBI_MOD_INV_NUM_VALS 9
+//Each column of an accumulator can absorb this many values below 2^FFBI_BITS_PER_DIGIT before it overflows a word.
+#define FFBI_ACC_MAX_TERMS ((((ffbi_word_t)1) << (FFBI_WORD_SIZE - FFBI_BITS_PER_DIGIT)) - 1)
+//Digits a full column can spill into when it is normalized.
+#define FFBI_ACC_CARRY_DIGITS ((FFBI_WORD_SIZE + FFBI_BITS_PER_DIGIT - 1)/FFBI_BITS_PER_DIGIT)
+//Above 64 digits, products are accumulated in tiles of this many digits of each operand.
+#ifndef FFBI_MUL_TILE_DIGITS
+#define FFBI_MUL_TILE_DIGITS 4096
+#endif
 #define FFBI_MUL_CACHE_ENABLED 0
 #define FFBI_DIV_CACHE_ENABLED 1
+//Counting of operations for ffbi_stats_snapshot. It costs a lookup of the thread's context per operation.
+#ifndef FFBI_STATS_ENABLED
+#define FFBI_STATS_ENABLED 0
+#endif
 
 #if defined(__GNUC__) && !defined(__ANDROID__) && !defined(__APPLE__)
 	#if FFBI_MUL_CACHE_ENABLED
@@ -47,29 +71,32 @@
 	typedef uint64_t ffbi_cache_word_t;
 #endif
 
-static ffbi_word_t _digit_max;
-static ffbi_word_t _digit_max_plus_1;
-static uint8_t _rand_not_seeded = 1;
-static const ffbi_word_t _rand_max = (ffbi_word_t)pow(2.0, (double)FFBI_RAND_BITS) - 1;
-static const ffbi_word_t _rand_max_plus_1 = (ffbi_word_t)pow(2.0, (double)FFBI_RAND_BITS);
-static uint8_t _ffbi_initialized = 0;
+//Per-thread state is aligned to this so that two threads never write to the same cache line.
+#define FFBI_CACHE_LINE_SIZE 64
+
+static constexpr ffbi_word_t _digit_max_plus_1 = ((ffbi_word_t)1) << FFBI_BITS_PER_DIGIT;
+static constexpr ffbi_word_t _digit_max = _digit_max_plus_1 - 1;
 
 #if FFBI_MUL_CACHE_ENABLED
-static ffbi_cache_word_t _cache_mul_digit_max;
-static uint32_t _min_mul_cache_len;
+static constexpr ffbi_cache_word_t _cache_mul_digit_max = (((ffbi_cache_word_t)1) << FFBI_CACHE_MUL_BITS_PER_DIGIT) - 1;
+static constexpr uint32_t _min_mul_cache_len = (FFBI_CACHE_MUL_BITS_PER_DIGIT + FFBI_BITS_PER_DIGIT - 1)/FFBI_BITS_PER_DIGIT;
 #endif
 
 #if FFBI_DIV_CACHE_ENABLED
-static ffbi_cache_word_t _cache_div_digit_max;
-static ffbi_cache_word_t _cache_div_digit_max_plus_1;
+static constexpr ffbi_cache_word_t _cache_div_digit_max_plus_1 = ((ffbi_cache_word_t)1) << FFBI_CACHE_DIV_BITS_PER_DIGIT;
+static constexpr ffbi_cache_word_t _cache_div_digit_max = _cache_div_digit_max_plus_1 - 1;
 #endif
 
 typedef struct FFBI
 {
 	uint32_t num_allocated_digits;
 	uint32_t num_used_digits;
-	ffbi_word_t* digits;
+	ffbi_word_t* digits; //points at the inline digits following the header unless the bigint outgrew them
+	uint32_t num_inline_digits;
 	uint8_t reallocation_allowed;
+	uint8_t is_view; //digits belong to the caller and are never written
+	uint8_t is_mapped; //digits are a shared mapping of the file map_fd
+	int map_fd;
 	ffbi_cache_word_t* cache;
 	uint32_t cache_num_allocated_digits;
 	uint32_t cache_num_used_digits;
@@ -77,12 +104,66 @@ typedef struct FFBI
 	uint32_t cache_bits_per_digit;
 } ffbi_t;
 
-struct FFBI_SCRATCH
+//The header and inline digits share one allocation of ffbi_word_t, which keeps the digits aligned.
+#define FFBI_HEADER_WORDS ((sizeof(ffbi_t) + sizeof(ffbi_word_t) - 1)/sizeof(ffbi_word_t))
+
+static inline ffbi_word_t* ffbi_inline_digits(ffbi_t* p)
+{
+	return ((ffbi_word_t*)p) + FFBI_HEADER_WORDS;
+}
+
+//Views are read-only, so every function writing to a bigint makes sure it isn't one.
+#define FFBI_RETURN_IF_VIEW(p, ...) do{if((p)->is_view){\
+	fflog_debug_print("a view can't be written to.\n");\
+	return __VA_ARGS__;}}while(0)
+
+//Frees digits that were allocated separately from the header.
+static inline void ffbi_free_digits(ffbi_t* p)
+{
+	if(p->reallocation_allowed && !p->is_mapped && p->digits != ffbi_inline_digits(p))
+		ffmem_free_arr(p->digits);
+}
+
+//Gives the kernel advice about num_digits digits of p from first_digit on, if p is mapped.
+static void ffbi_advise(ffbi_t* p, uint32_t first_digit, uint32_t num_digits, int advice)
+{
+	if(!p->is_mapped)
+		return;
+	uintptr_t page_size = (uintptr_t)sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t)(p->digits + first_digit) & ~(page_size - 1);
+	uintptr_t end = (uintptr_t)(p->digits + first_digit + num_digits);
+	madvise((void*)start, end - start, advice);
+}
+
+struct FFBI_SIEVE
+{
+	ffbi_t** primes;
+	int num_primes;
+	ffbi_t** primorials;
+	int num_primorials;
+};
+
+//Bigints handed out by a workspace are laid out back to back in block, each taking
+//slot_words words. Bigints requested past the end of block come from overflow until
+//the next ffbi_workspace_reserve with no open frames folds them into a larger block.
+struct alignas(FFBI_CACHE_LINE_SIZE) FFBI_WORKSPACE
 {
-	ffbi_t** val;
-	int num_vals;
-	ffbi_scratch_t* child;
-	uint32_t num_children;
+	ffbi_word_t* block;
+	uint32_t num_slots;
+	uint32_t slot_digits;
+	uint32_t top;
+	std::vector<ffbi_t*>* overflow;
+};
+
+//All mutable state used by ffbi on behalf of a thread.
+struct alignas(FFBI_CACHE_LINE_SIZE) FFBI_CTX
+{
+	ffbi_workspace_t* ws; //created on first use
+	ffrand_t* rand; //when set, random values come from this stream instead of the thread's CSPRNG
+#if FFBI_STATS_ENABLED
+	ffbi_stats_t stats;
+	uint32_t stats_active; //bit per FFBI_STATS_ operation that is running
+#endif
 };
 
 void ffbi_get_digits(ffbi_t* p, ffbi_word_t** digits, uint32_t* num_used_digits, uint32_t* num_allocated_digits, uint32_t* bits_per_digit)
@@ -95,6 +176,7 @@ void ffbi_get_digits(ffbi_t* p, ffbi_word_t** digits, uint32_t* num_used_digits,
 
 void ffbi_set_digits(ffbi_t* p, ffbi_word_t* digits, uint32_t num_used_digits, uint32_t num_allocated_digits, uint32_t bits_per_digit)
 {
+	FFBI_RETURN_IF_VIEW(p);
 	if(bits_per_digit != FFBI_BITS_PER_DIGIT)
 	{
 		fflog_debug_print("Automatic conversion of bits_per_digit is not supported currently. The only accepted value is %d.\n", FFBI_BITS_PER_DIGIT);
@@ -102,38 +184,22 @@ void ffbi_set_digits(ffbi_t* p, ffbi_word_t* digits, uint32_t num_used_digits, u
 	}
 	if(digits)
 	{
-		ffmem_free_arr(p->digits);
+		if(p->is_mapped)
+		{
+			fflog_debug_print("the digits of a mapped bigint can't be replaced.\n");
+			return;
+		}
+		ffbi_free_digits(p);
 		p->digits = digits;
 	}
 	p->num_used_digits = num_used_digits;
 	p->num_allocated_digits = num_allocated_digits;
+	p->cache_valid = 0;
 }
 
 void ffbi_init()
 {
-	if(_ffbi_initialized == 0)
-	{
-		_digit_max_plus_1 = 1;
-		_digit_max_plus_1 <<= FFBI_BITS_PER_DIGIT;
-		_digit_max = _digit_max_plus_1 - 1;
-
-#if FFBI_MUL_CACHE_ENABLED
-		_cache_mul_digit_max = 1;
-		_cache_mul_digit_max <<= FFBI_CACHE_MUL_BITS_PER_DIGIT;
-		_cache_mul_digit_max--;
-		_min_mul_cache_len = FFBI_CACHE_MUL_BITS_PER_DIGIT/FFBI_BITS_PER_DIGIT;
-		if(FFBI_CACHE_MUL_BITS_PER_DIGIT%FFBI_BITS_PER_DIGIT > 0)
-			_min_mul_cache_len++;
-#endif
-
-#if FFBI_DIV_CACHE_ENABLED
-		_cache_div_digit_max_plus_1 = 1;
-		_cache_div_digit_max_plus_1 <<= FFBI_CACHE_DIV_BITS_PER_DIGIT;
-		_cache_div_digit_max = _cache_div_digit_max_plus_1 - 1;
-#endif
-
-		_ffbi_initialized = 1;
-	}
+	//all constants are computed at compile time, so there is nothing left to initialize
 }
 
 //Makes sure cache in p has at least cache_num_digits allocated.
@@ -156,43 +222,28 @@ static void ffbi_cache_prepare(ffbi_t* p, uint32_t cache_num_digits, uint8_t ret
 	}
 }
 
-static uint32_t ffbi_significant_bits_uint8(uint8_t num)
+//Returns the number of bits needed to hold num, counting 0 as 1 bit.
+template<typename T>
+static inline uint32_t ffbi_bit_width(T num)
 {
-	if(num == 0)
-		return 1;
-	uint32_t count = 0;
-	while(num>0)
+	if(sizeof(T) > sizeof(uint64_t))
 	{
-		num>>=1;
-		count += 1;
+		uint64_t hi = (uint64_t)(num >> 32 >> 32);
+		if(hi)
+			return 128 - (uint32_t)__builtin_clzll(hi);
 	}
-	return count;
+	uint64_t lo = (uint64_t)num;
+	return lo ? 64 - (uint32_t)__builtin_clzll(lo) : 1;
 }
 
 static uint32_t ffbi_significant_bits_cache_word(ffbi_cache_word_t num)
 {
-	if(num == 0)
-		return 1;
-	uint32_t count = 0;
-	while(num>0)
-	{
-		num>>=1;
-		count += 1;
-	}
-	return count;
+	return ffbi_bit_width(num);
 }
 
 static ffbi_word_t ffbi_significant_bits(ffbi_word_t num)
 {
-	if(num == 0)
-		return 1;
-	uint32_t count = 0;
-	while(num>0)
-	{
-		num>>=1;
-		count += 1;
-	}
-	return count;
+	return ffbi_bit_width(num);
 }
 
 /*
@@ -218,22 +269,15 @@ typedef struct FFBI_BASE_CONVERT
 	uint32_t dst_digit_max;
 } ffbi_base_convert_t;
 
-static ffbi_base_convert_t* ffbi_base_convert_create(uint32_t dst_bits_per_digit, uint32_t src_bits_per_digit, uint32_t total_used_bits)
-{
-	ffbi_base_convert_t* ret = ffmem_alloc(ffbi_base_convert_t);
-	ret->dst_bits_per_digit = dst_bits_per_digit;
-	ret->src_bits_per_digit = src_bits_per_digit;
-	ret->total_used_bits = total_used_bits;
-	ret->src_num_digits = total_used_bits/src_bits_per_digit + (total_used_bits%src_bits_per_digit > 0);
-	ret->dst_num_full_digits = total_used_bits/dst_bits_per_digit;
-	ret->dst_remaining_bits = total_used_bits%dst_bits_per_digit;
-	ret->dst_num_digits = ret->dst_num_full_digits + (ret->dst_remaining_bits > 0);
-	return ret;
-}
-
-static void ffbi_base_convert_destroy(ffbi_base_convert_t* ctx)
+static void ffbi_base_convert_init(ffbi_base_convert_t* ctx, uint32_t dst_bits_per_digit, uint32_t src_bits_per_digit, uint32_t total_used_bits)
 {
-	ffmem_free(ctx);
+	ctx->dst_bits_per_digit = dst_bits_per_digit;
+	ctx->src_bits_per_digit = src_bits_per_digit;
+	ctx->total_used_bits = total_used_bits;
+	ctx->src_num_digits = total_used_bits/src_bits_per_digit + (total_used_bits%src_bits_per_digit > 0);
+	ctx->dst_num_full_digits = total_used_bits/dst_bits_per_digit;
+	ctx->dst_remaining_bits = total_used_bits%dst_bits_per_digit;
+	ctx->dst_num_digits = ctx->dst_num_full_digits + (ctx->dst_remaining_bits > 0);
 }
 
 template<typename dst_t, typename src_t>
@@ -303,17 +347,20 @@ static void ffbi_base_convert_exec(ffbi_base_convert_t* ctx, dst_t* dst, src_t*
 }
 
 //Loads cache into normal representation. Cache is expected to be correctly built.
-static void ffbi_cache_retrieve(ffbi_t* p)
+//Returns 0 on success and 1 if p can't be reallocated to hold the value.
+static int ffbi_cache_retrieve(ffbi_t* p)
 {
 	uint32_t sigbits = ffbi_significant_bits_cache_word(p->cache[p->cache_num_used_digits-1]);
 	uint32_t total_used_bits = (p->cache_num_used_digits-1)*p->cache_bits_per_digit + sigbits;
-	ffbi_base_convert_t* ctx = ffbi_base_convert_create(FFBI_BITS_PER_DIGIT, p->cache_bits_per_digit, total_used_bits);
-	if(ctx->dst_num_digits > p->num_allocated_digits)
-		ffbi_reallocate_digits(p, ctx->dst_num_digits, 0);
+	ffbi_base_convert_t convert;
+	ffbi_base_convert_t* ctx = &convert;
+	ffbi_base_convert_init(ctx, FFBI_BITS_PER_DIGIT, p->cache_bits_per_digit, total_used_bits);
+	if(ctx->dst_num_digits > p->num_allocated_digits && ffbi_reallocate_digits(p, ctx->dst_num_digits, 0))
+		return 1;
 	p->num_used_digits = ctx->dst_num_digits;
 	ffbi_base_convert_exec<ffbi_word_t, ffbi_cache_word_t>(ctx, p->digits, p->cache);
-	ffbi_base_convert_destroy(ctx);
 	p->cache_valid = 1;
+	return 0;
 }
 
 static void ffbi_cache_update(ffbi_t* p, uint32_t target_bits_per_digit, ffbi_cache_word_t cache_digit_max)
@@ -323,7 +370,9 @@ static void ffbi_cache_update(ffbi_t* p, uint32_t target_bits_per_digit, ffbi_ca
 	p->cache_bits_per_digit = target_bits_per_digit;
 	uint32_t sigbits = ffbi_significant_bits(p->digits[p->num_used_digits-1]);
 	uint32_t total_used_bits = (p->num_used_digits-1)*FFBI_BITS_PER_DIGIT + sigbits;
-	ffbi_base_convert_t* ctx = ffbi_base_convert_create(p->cache_bits_per_digit, FFBI_BITS_PER_DIGIT, total_used_bits);
+	ffbi_base_convert_t convert;
+	ffbi_base_convert_t* ctx = &convert;
+	ffbi_base_convert_init(ctx, p->cache_bits_per_digit, FFBI_BITS_PER_DIGIT, total_used_bits);
 	p->cache_num_used_digits = ctx->dst_num_digits;
 	if(p->cache)
 	{
@@ -340,24 +389,53 @@ static void ffbi_cache_update(ffbi_t* p, uint32_t target_bits_per_digit, ffbi_ca
 		p->cache_num_allocated_digits = p->cache_num_used_digits;
 	}
 	ffbi_base_convert_exec<ffbi_cache_word_t, ffbi_word_t>(ctx, p->cache, p->digits);
-	ffbi_base_convert_destroy(ctx);
 	p->cache_valid = 1;
 }
 
-//Create a new bigint with value of 0.
-ffbi_t* ffbi_create()
+//Constructs a bigint with value of 0 in block, followed by num_inline_digits digits.
+static ffbi_t* ffbi_init_block(ffbi_word_t* block, uint32_t num_inline_digits)
 {
-	ffbi_t* ret = ffmem_alloc(ffbi_t);
+	ffbi_t* ret = new(block) ffbi_t;
 	memset(ret, 0, sizeof(ffbi_t));
-	ret->num_allocated_digits = FFBI_MIN_ALLOC_DIGITS;
-	ret->digits = ffmem_alloc_arr(ffbi_word_t, ret->num_allocated_digits);
+	ret->num_inline_digits = num_inline_digits;
+	ret->num_allocated_digits = num_inline_digits;
+	ret->digits = ffbi_inline_digits(ret);
 	ret->reallocation_allowed = 1;
 	ret->num_used_digits = 1;
-	ret->digits[0] = 0;
-	ffbi_init();
+	if(num_inline_digits > 0)
+		ret->digits[0] = 0;
 	return ret;
 }
 
+//Frees everything p owns apart from the block holding its header.
+static void ffbi_release(ffbi_t* p)
+{
+	if(p->is_mapped)
+	{
+		if(p->num_allocated_digits > 0)
+			munmap(p->digits, (size_t)p->num_allocated_digits*sizeof(ffbi_word_t));
+		close(p->map_fd);
+	}
+	ffbi_free_digits(p);
+	if(p->cache)
+		ffmem_free_arr(p->cache);
+}
+
+//Allocates the header and num_inline_digits digits in a single block.
+static ffbi_t* ffbi_alloc(uint32_t num_inline_digits)
+{
+	ffbi_word_t* block = ffmem_alloc_arr(ffbi_word_t, FFBI_HEADER_WORDS + num_inline_digits);
+	if(block == NULL)
+		return NULL;
+	return ffbi_init_block(block, num_inline_digits);
+}
+
+//Create a new bigint with value of 0.
+ffbi_t* ffbi_create()
+{
+	return ffbi_alloc(FFBI_INLINE_DIGITS);
+}
+
 //Create a new bigint with value of 0. Initial memory capacity is allocated to fit up to specified number of bits.
 ffbi_t* ffbi_create_reserved_bits(uint32_t bits)
 {
@@ -369,29 +447,70 @@ ffbi_t* ffbi_create_reserved_bits(uint32_t bits)
 		fflog_debug_print("bits arg must be at least %d.\n", FFBI_BITS_PER_DIGIT*FFBI_MIN_ALLOC_DIGITS);
 		return NULL;
 	}
-	ffbi_t* ret = ffmem_alloc(ffbi_t);
-	memset(ret, 0, sizeof(ffbi_t));
-	ret->num_allocated_digits = num_digits;
-	ret->digits = ffmem_alloc_arr(ffbi_word_t, num_digits);
-	ret->reallocation_allowed = 1;
-	ret->num_used_digits = 1;
-	ret->digits[0] = 0;
-	ffbi_init();
-	return ret;
+	return ffbi_alloc(num_digits);
 }
 
 ffbi_t* ffbi_create_reserved_digits(uint32_t digits)
 {
 	if(digits < FFBI_MIN_ALLOC_DIGITS)
 		digits = FFBI_MIN_ALLOC_DIGITS;
-	ffbi_t* ret = ffmem_alloc(ffbi_t);
-	memset(ret, 0, sizeof(ffbi_t));
-	ret->num_allocated_digits = digits;
-	ret->digits = ffmem_alloc_arr(ffbi_word_t, digits);
-	ret->reallocation_allowed = 1;
-	ret->num_used_digits = 1;
+	return ffbi_alloc(digits);
+}
+
+//Grows the file behind p to num_digits digits and maps all of it. The new mapping is made before the
+//old one is dropped, so p keeps its digits if it fails. Returns 0 on success and 1 on error.
+static int ffbi_map_digits(ffbi_t* p, uint32_t num_digits)
+{
+	size_t size = (size_t)num_digits*sizeof(ffbi_word_t);
+	if(ftruncate(p->map_fd, (off_t)size) != 0)
+	{
+		fflog_debug_print("couldn't grow the file to %llu bytes.\n", (unsigned long long)size);
+		return 1;
+	}
+	void* digits = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, p->map_fd, 0);
+	if(digits == MAP_FAILED)
+	{
+		fflog_debug_print("couldn't map %llu bytes.\n", (unsigned long long)size);
+		return 1;
+	}
+	if(p->num_allocated_digits > 0)
+		munmap(p->digits, (size_t)p->num_allocated_digits*sizeof(ffbi_word_t));
+	p->digits = (ffbi_word_t*)digits;
+	p->num_allocated_digits = num_digits;
+	return 0;
+}
+
+ffbi_t* ffbi_create_mapped(const char* path, uint32_t bits)
+{
+	uint32_t num_digits = bits/FFBI_BITS_PER_DIGIT + 1;
+	if(num_digits < FFBI_MIN_ALLOC_DIGITS)
+		num_digits = FFBI_MIN_ALLOC_DIGITS;
+	int fd;
+	if(path)
+		fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	else
+	{
+		const char* dir = getenv("TMPDIR");
+		char temp_path[4096];
+		snprintf(temp_path, sizeof(temp_path), "%s/ffbi-XXXXXX", dir ? dir : "/tmp");
+		fd = mkstemp(temp_path);
+		if(fd >= 0)
+			unlink(temp_path);
+	}
+	if(fd < 0)
+	{
+		fflog_debug_print("couldn't open the file to map.\n");
+		return NULL;
+	}
+	ffbi_t* ret = ffbi_alloc(0);
+	ret->is_mapped = 1;
+	ret->map_fd = fd;
+	if(ffbi_map_digits(ret, num_digits))
+	{
+		ffbi_destroy(ret);
+		return NULL;
+	}
 	ret->digits[0] = 0;
-	ffbi_init();
 	return ret;
 }
 
@@ -410,1281 +529,2394 @@ ffbi_t* ffbi_create_preallocated(uint8_t* buffer, int size_bytes)
 		fflog_debug_print("size_bytes can't be less than %d.\n", (int)(FFBI_MIN_ALLOC_DIGITS*sizeof(uint32_t)));
 		return NULL;
 	}
-	ffbi_t* ret = ffmem_alloc(ffbi_t);
-	memset(ret, 0, sizeof(ffbi_t));
+	ffbi_t* ret = ffbi_alloc(0);
 	ret->num_allocated_digits = size_bytes/sizeof(ffbi_word_t);
 	ret->digits = (ffbi_word_t*)buffer;
 	ret->reallocation_allowed = 0;
-	ret->num_used_digits = 1;
 	ret->digits[0] = 0;
-	ffbi_init();
 	return ret;
 }
 
-ffbi_scratch_t* ffbi_scratch_create()
-{
-	ffbi_scratch_t* ret = ffmem_alloc(ffbi_scratch_t);
-	memset(ret, 0, sizeof(ffbi_scratch_t));
-	ffbi_init();
-	return ret;
-}
+//Bytes are moved in chunks of half a word, so that a chunk plus a partial digit always fits in a word.
+#if FFBI_WORD_SIZE == 128
+typedef uint64_t ffbi_chunk_t;
+#define ffbi_chunk_swap(c) __builtin_bswap64(c)
+#else
+typedef uint32_t ffbi_chunk_t;
+#define ffbi_chunk_swap(c) __builtin_bswap32(c)
+#endif
+#define FFBI_CHUNK_BITS (FFBI_WORD_SIZE/2)
+#define FFBI_CHUNK_BYTES (FFBI_CHUNK_BITS/8)
 
-static void ffbi_scratch_destroy_impl(ffbi_scratch_t* scratch, uint8_t free_scratch, uint8_t is_arr)
+//The conversions below index a number of size_bytes bytes from its least significant byte.
+//BigEndian says whether buffer holds it with the most significant byte first instead.
+
+template<bool BigEndian>
+static inline uint8_t ffbi_byte_load(const uint8_t* buffer, int size_bytes, int i)
 {
-	if(scratch->num_children > 1)
-	{
-		for(uint32_t i=1;i<scratch->num_children;i++)
-			ffbi_scratch_destroy_impl(&scratch->child[i], 0, 0);
-		ffbi_scratch_destroy_impl(scratch->child, 1, 1);
-	}
-	else if(scratch->num_children == 1)
-		ffbi_scratch_destroy_impl(scratch->child, 1, 0);
-	if(scratch->num_vals > 0)
-	{
-		for(int i=0;i<scratch->num_vals;i++)
-			ffbi_destroy(scratch->val[i]);
-		ffmem_free_arr(scratch->val);
-	}
-	if(free_scratch)
-	{
-		if(is_arr)
-			ffmem_free_arr(scratch);
-		else
-			ffmem_free(scratch);
-	}
+	return BigEndian ? buffer[size_bytes-1-i] : buffer[i];
 }
 
-void ffbi_scratch_destroy(ffbi_scratch_t* scratch)
+template<bool BigEndian>
+static inline void ffbi_byte_store(uint8_t* buffer, int size_bytes, int i, uint8_t byte)
 {
-	ffbi_scratch_destroy_impl(scratch, 1, 0);
+	if(BigEndian)
+		buffer[size_bytes-1-i] = byte;
+	else
+		buffer[i] = byte;
 }
 
-//Makes sure scratch has num_vals bigints available to use with at least val_digits
-//number of allocated digits each.
-static void ffbi_scratch_prepare(ffbi_scratch_t* scratch, int num_vals, int val_digits)
+//Loads the chunk made of bytes i to i+FFBI_CHUNK_BYTES-1.
+template<bool BigEndian>
+static inline ffbi_chunk_t ffbi_chunk_load(const uint8_t* buffer, int size_bytes, int i)
 {
-	int num_existing_vals = scratch->num_vals;
-	if(scratch->num_vals == 0)
-	{
-		scratch->val = ffmem_alloc_arr(ffbi_t*, num_vals);
-		scratch->num_vals = num_vals;
-		for(int i=0;i<num_vals;i++)
-			scratch->val[i] = ffbi_create_reserved_digits(val_digits);
-		return;
-	}
-	if(num_vals > scratch->num_vals)
+	ffbi_chunk_t chunk;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if(BigEndian)
 	{
-		ffbi_t** val = ffmem_alloc_arr(ffbi_t*, num_vals);
-		int i = 0;
-		for(;i<scratch->num_vals;i++)
-			val[i] = scratch->val[i];
-		for(;i<num_vals;i++)
-			val[i] = ffbi_create_reserved_digits(val_digits);
-		ffmem_free_arr(scratch->val);
-		scratch->val = val;
-		scratch->num_vals = num_vals;
-	}
-	for(int i=0;i<num_existing_vals;i++)
-	{
-		if(scratch->val[i]->num_allocated_digits < (uint32_t)val_digits)
-			ffbi_reallocate_digits(scratch->val[i], val_digits, 1);
+		memcpy(&chunk, buffer + size_bytes - i - FFBI_CHUNK_BYTES, sizeof(chunk));
+		return ffbi_chunk_swap(chunk);
 	}
+	memcpy(&chunk, buffer + i, sizeof(chunk));
+#else
+	chunk = 0;
+	for(int j=FFBI_CHUNK_BYTES-1;j>=0;j--)
+		chunk = (chunk << 8) | ffbi_byte_load<BigEndian>(buffer, size_bytes, i + j);
+#endif
+	return chunk;
 }
 
-//Create a new bigint to be used as a sieve for primality testing.
-//n is the max possible prime value that the sieve contains.
-//A recommended value is 100000. NULL is returned on error.
-void ffbi_get_sieve(ffbi_scratch_t* sieve, uint32_t n)
+template<bool BigEndian>
+static inline void ffbi_chunk_store(uint8_t* buffer, int size_bytes, int i, ffbi_chunk_t chunk)
 {
-	if(n < 3)
-	{
-		fflog_debug_print("n can't be less than 3.\n");
-		return;
-	}
-	uint8_t* arr =  ffmem_alloc_arr(uint8_t, n);
-	memset(arr, 1, n);
-	ffbi_word_t k = 2;
-	ffbi_word_t k_end = n/2+1;
-	ffbi_word_t i;
-	while(1)
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if(BigEndian)
 	{
-		//get new k
-		for(;k<k_end;k++)
-		{
-			if(arr[k] == 1)
-				break;
-		}
-		//check if done
-		if(k==k_end)
-			break;
-		//if not done, cross out multiples of k
-		for(i=k*2;i<n;i+=k)
-			arr[i] = 0;
-		k++;
+		chunk = ffbi_chunk_swap(chunk);
+		memcpy(buffer + size_bytes - i - FFBI_CHUNK_BYTES, &chunk, sizeof(chunk));
 	}
-	//count primes
-	int num_primes = 0;
-	for(k=3;k<n;k++)
-		if(arr[k] == 1)
-			num_primes++;
-	//insert them into a sieve
-	if(sieve->num_vals > 0)
+	else
+		memcpy(buffer + i, &chunk, sizeof(chunk));
+#else
+	for(int j=0;j<FFBI_CHUNK_BYTES;j++)
 	{
-		for(i=0;i<(uint32_t)sieve->num_vals;i++)
-			ffbi_destroy(sieve->val[i]);
-		ffmem_free_arr(sieve->val);
+		ffbi_byte_store<BigEndian>(buffer, size_bytes, i + j, (uint8_t)chunk);
+		chunk >>= 8;
 	}
-	sieve->num_vals = num_primes;
-	sieve->val = ffmem_alloc_arr(ffbi_t*, num_primes);
-	int num_digits = 32/FFBI_BITS_PER_DIGIT+((32%FFBI_BITS_PER_DIGIT) > 0);
-	int alloc_digits = num_digits;
-	if(alloc_digits < FFBI_MIN_ALLOC_DIGITS)
-		alloc_digits = FFBI_MIN_ALLOC_DIGITS;
-	for(i=0;i<(uint32_t)num_primes;i++)
-		sieve->val[i] = ffbi_create_reserved_digits(alloc_digits);
-	i=0;
-	for(k=3;k<n;k++)
+#endif
+}
+
+//Unpacks a byte array into digits, filling a word sized accumulator a chunk at a time and
+//taking a whole digit from it at once. Returns the number of digits written without trimming.
+template<bool BigEndian>
+static uint32_t ffbi_bytes_to_digits(ffbi_word_t* digits, const uint8_t* buffer, int size_bytes)
+{
+	ffbi_word_t acc = 0;
+	int acc_bits = 0;
+	int i = 0;
+	uint32_t num_digits = 0;
+	while(i < size_bytes || acc_bits > 0)
 	{
-		if(arr[k] == 1)
+		if(acc_bits < FFBI_BITS_PER_DIGIT)
 		{
-			int j;
-			for(j=0;j<num_digits;j++)
-				sieve->val[i]->digits[j] = (k>>(j*FFBI_BITS_PER_DIGIT))&_digit_max;
-			j--;
-			for(;j>0;j--)
+			if(size_bytes - i >= FFBI_CHUNK_BYTES)
 			{
-				if(sieve->val[i]->digits[j] != 0)
-					break;
+				acc |= ((ffbi_word_t)ffbi_chunk_load<BigEndian>(buffer, size_bytes, i)) << acc_bits;
+				acc_bits += FFBI_CHUNK_BITS;
+				i += FFBI_CHUNK_BYTES;
 			}
-			sieve->val[i]->num_used_digits = j+1;
-			i++;
+			else
+			{
+				while(acc_bits <= FFBI_WORD_SIZE-8 && i < size_bytes)
+				{
+					acc |= ((ffbi_word_t)ffbi_byte_load<BigEndian>(buffer, size_bytes, i++)) << acc_bits;
+					acc_bits += 8;
+				}
+			}
+		}
+		digits[num_digits++] = acc & _digit_max;
+		if(acc_bits > FFBI_BITS_PER_DIGIT)
+		{
+			acc >>= FFBI_BITS_PER_DIGIT;
+			acc_bits -= FFBI_BITS_PER_DIGIT;
+		}
+		else
+		{
+			acc = 0;
+			acc_bits = 0;
 		}
 	}
-	ffmem_free_arr(arr);
+	return num_digits;
 }
 
-//Generate a random bigint with specified number of bits.
-void ffbi_random(ffbi_t* p, uint32_t num_bits)
+//Packs digits into a byte array of exactly size_bytes bytes, zero padded, a chunk at a time.
+//Returns 1 if the value doesn't fit.
+template<bool BigEndian>
+static int ffbi_digits_to_bytes(const ffbi_word_t* digits, uint32_t num_digits, uint8_t* buffer, int size_bytes)
 {
-	if(num_bits < FFBI_BITS_PER_DIGIT)
-	{
-		fflog_debug_print("num_bits can't be less than %d.\n", FFBI_BITS_PER_DIGIT);
-		return;
-	}
-	int num_full_digits = num_bits/FFBI_BITS_PER_DIGIT;
-	int num_digits = num_full_digits;
-	int remaining_bits = num_bits%FFBI_BITS_PER_DIGIT;
-	if(remaining_bits > 0)
-		num_digits++;
-	if(p->num_allocated_digits < (uint32_t)num_digits)
-			ffbi_reallocate_digits(p, num_digits, 0);
-	p->num_used_digits = num_digits;
-
-	//seed the random number generator once per program execution
-	if(_rand_not_seeded)
-	{
-		_rand_not_seeded = 0;
-		srand(time(NULL));
-	}
-
-	//generate a random value for each digit
-	//fflog_print("num_full_digits=%d, num_digits=%d, remaining_bits=%d\n", num_full_digits, num_digits, remaining_bits);
-	int i;
-	for(i=0;i<num_full_digits;i++)
+	ffbi_word_t acc = 0;
+	int acc_bits = 0;
+	uint32_t k = 0;
+	int i = 0;
+	for(;size_bytes - i >= FFBI_CHUNK_BYTES;i+=FFBI_CHUNK_BYTES)
 	{
-		int bits_left = FFBI_BITS_PER_DIGIT;
-		p->digits[i] = 0;
-		while(bits_left >= FFBI_RAND_BITS)
-		{
-			p->digits[i] <<= FFBI_RAND_BITS;
-			p->digits[i] += rand()%(_rand_max_plus_1);
-			bits_left-=FFBI_RAND_BITS;
-		}
-		if(bits_left > 0)
+		while(acc_bits < FFBI_CHUNK_BITS && k < num_digits)
 		{
-			p->digits[i] <<= bits_left;
-			p->digits[i] += rand()%((int)pow(2.0, (double)bits_left));
+			acc |= digits[k++] << acc_bits;
+			acc_bits += FFBI_BITS_PER_DIGIT;
 		}
+		ffbi_chunk_store<BigEndian>(buffer, size_bytes, i, (ffbi_chunk_t)acc);
+		acc >>= FFBI_CHUNK_BITS;
+		acc_bits = acc_bits > FFBI_CHUNK_BITS ? acc_bits - FFBI_CHUNK_BITS : 0;
 	}
-	if(remaining_bits > 0)
+	for(;i<size_bytes;i++)
 	{
-		int bits_left = remaining_bits;
-		p->digits[i] = 0;
-		while(bits_left >= FFBI_RAND_BITS)
+		if(acc_bits < 8 && k < num_digits)
 		{
-			p->digits[i] <<= FFBI_RAND_BITS;
-			p->digits[i] += rand()%(_rand_max_plus_1);
-			bits_left-=FFBI_RAND_BITS;
+			acc |= digits[k++] << acc_bits;
+			acc_bits += FFBI_BITS_PER_DIGIT;
 		}
-		if(bits_left > 0)
-		{
-			p->digits[i] <<= bits_left;
-			p->digits[i] += rand()%((int)pow(2.0, (double)bits_left));
-		}
-		p->digits[i] |= ((ffbi_word_t)1) << (remaining_bits-1);
+		ffbi_byte_store<BigEndian>(buffer, size_bytes, i, (uint8_t)acc);
+		acc >>= 8;
+		acc_bits = acc_bits > 8 ? acc_bits - 8 : 0;
 	}
-	else
-		p->digits[i-1] |= ((ffbi_word_t)1) << (FFBI_BITS_PER_DIGIT-1);
-	p->cache_valid = 0;
+	if(acc != 0)
+		return 1;
+	for(;k<num_digits;k++)
+	{
+		if(digits[k] != 0)
+			return 1;
+	}
+	return 0;
 }
 
-void ffbi_random_with_limit(ffbi_t* p, ffbi_t* limit)
+static uint32_t ffbi_trim_len(const ffbi_word_t* digits, uint32_t num_digits)
 {
-	if(p->num_allocated_digits < limit->num_used_digits)
-		ffbi_reallocate_digits(p, limit->num_used_digits, 0);
-	p->num_used_digits = limit->num_used_digits;
+	while(num_digits > 1 && digits[num_digits-1] == 0)
+		num_digits--;
+	return num_digits;
+}
+
+static int ffbi_reallocate_digits_impl(ffbi_t* p, int target_num_digits, uint8_t retain_value);
 
-	//seed the random number generator once per program execution
-	if(_rand_not_seeded)
+//Sets p to the value of a byte array.
+template<bool BigEndian>
+static void ffbi_set_bytes(ffbi_t* p, const uint8_t* buffer, int size_bytes)
+{
+	if(buffer == NULL || size_bytes < 0)
+		size_bytes = 0;
+	uint32_t num_digits = ((uint32_t)size_bytes*8 + FFBI_BITS_PER_DIGIT - 1)/FFBI_BITS_PER_DIGIT;
+	if(num_digits > p->num_allocated_digits && ffbi_reallocate_digits_impl(p, num_digits, 0))
+		return;
+	if(num_digits == 0)
 	{
-		_rand_not_seeded = 0;
-		srand(time(NULL));
+		p->digits[0] = 0;
+		num_digits = 1;
 	}
+	else
+		ffbi_bytes_to_digits<BigEndian>(p->digits, buffer, size_bytes);
+	p->num_used_digits = ffbi_trim_len(p->digits, num_digits);
+	p->cache_valid = 0;
+}
 
-	//generate a random value for each digit
-	uint8_t p_is_less = 0;
-	int i;
-	//fflog_print("line=%d, rand_max=%u, p_num_digits=%u, lim_num_digits=%u, p_alloc_digit=%u, lim_alloc_digits=%u\n", __LINE__, _rand_max, p->num_used_digits, limit->num_used_digits, p->num_allocated_digits, limit->num_allocated_digits);
-	for(i=(int)p->num_used_digits-1;i>=0;i--)
-	{
-		int bits_left = FFBI_BITS_PER_DIGIT;
-		p->digits[i] = 0;
-		//fflog_print("line=%d, i=%d, p_digit=%u, lim_digit=%u\n", __LINE__, i, p->digits[i], limit->digits[i]);
-		while(bits_left >= FFBI_RAND_BITS)
-		{
-			p->digits[i] <<= FFBI_RAND_BITS;
-			bits_left-=FFBI_RAND_BITS;
-			ffbi_word_t rand_val = rand();
-			if(!p_is_less)
-			{
-				ffbi_word_t lim = (limit->digits[i]>>bits_left) & _rand_max;
-				rand_val %= lim+1;
-				//fflog_print("line=%d, rand_val=%u, lim=%u\n", __LINE__, rand_val, lim);
-				if(rand_val < lim)
-				{
-					p_is_less = 1;
-					//fflog_print("line=%d\n", __LINE__);
-				}
-			}
-			else
-				rand_val %= _rand_max_plus_1;
-			p->digits[i] += rand_val;
-		}
-		//fflog_print("line=%d, bits_left=%d\n", __LINE__, bits_left);
-		if(bits_left > 0)
-		{
-			p->digits[i] <<= bits_left;
-			ffbi_word_t rand_val = rand();
-			uint32_t shift_amount = FFBI_WORD_SIZE-bits_left;
-			if(!p_is_less)
-			{
-				ffbi_word_t lim = (limit->digits[i]<<shift_amount)>>shift_amount;
-				rand_val %= lim+1;
-				//fflog_print("line=%d, rand_val=%u, lim=%u\n", __LINE__, rand_val, lim);
-				if(rand_val < lim)
-					p_is_less = 1;
-			}
-			else
-			{
-				rand_val %= (_digit_max >> shift_amount)+1;
-			}
-			p->digits[i] += rand_val;
-		}
-		//fflog_print("line=%d, p_result=%u, p_is_less=%u\n", __LINE__, p->digits[i], p_is_less);
-	}
-	if(!p_is_less)
+ffbi_view_t* ffbi_view_create()
+{
+	ffbi_t* ret = ffbi_alloc(FFBI_INLINE_DIGITS);
+	if(ret)
+		ret->is_view = 1;
+	return ret;
+}
+
+void ffbi_view_set_digits(ffbi_view_t* v, const ffbi_word_t* digits, uint32_t num_digits)
+{
+	if(!v->is_view)
 	{
-		for(i=0;i<(int)p->num_used_digits;i++)
-		{
-			if(p->digits[i] > 0)
-			{
-				p->digits[i]--;
-				p_is_less = 1;
-				break;
-			}
-		}
-		if(!p_is_less)
-			fflog_debug_print("limit should be greater than 0.\n");
+		fflog_debug_print("v is not a view.\n");
+		return;
 	}
-	for(i=p->num_used_digits-1;i>=0;i--)
+	if(digits == NULL || num_digits == 0)
 	{
-		if(p->digits[i] != 0)
-			break;
+		ffbi_view_set_bytes(v, NULL, 0);
+		return;
 	}
-	p->num_used_digits = i+1;
-	p->cache_valid = 0;
+	ffbi_free_digits(v);
+	v->digits = (ffbi_word_t*)digits;
+	v->num_used_digits = ffbi_trim_len(digits, num_digits);
+	v->num_allocated_digits = num_digits;
+	v->reallocation_allowed = 0;
+	v->cache_valid = 0;
 }
 
-//Generate a random large prime bigint with specified number of bits.
-//The more tests, the greater the chance of the bigint to actually be prime,
-//but the time it takes is considerably longer. 20 for num_tests is recommended
-//as it would mean there is about one-in-a-million chance for the bigint to
-//not be prime. A sieve may be optionally provided to quickly weed out
-//composites before the Fermat primality test. Pass NULL for sieve to skip
-//the sieve test. NULL is returned on error.
-ffbi_t* ffbi_create_random_large_prime(uint32_t bits, uint32_t num_tests, ffbi_scratch_t* sieve)
+void ffbi_view_set_bytes(ffbi_view_t* v, const uint8_t* buffer, int size_bytes)
 {
-	ffbi_t* ret = ffbi_create_reserved_bits(bits);
-	if(ret)
+	if(!v->is_view)
 	{
-		ffbi_scratch_t* scratch = ffbi_scratch_create();
-		ffbi_scratch_prepare(scratch, FFBI_PRIME_TEST_NUM_SCRATCHES, ret->num_allocated_digits);
-		scratch->num_children = 1;
-		scratch->child = ffbi_scratch_create();
-		ffbi_scratch_prepare(scratch, FFBI_MOD_POW_NUM_SCRATCHES, ret->num_allocated_digits);
-		scratch->child->child = ffbi_scratch_create();
-		scratch->child->num_children = 1;
-		do
-		{
-			ffbi_random(ret, bits);
-			ret->digits[0] |= 1;
-		}
-		while(!ffbi_is_large_prime(ret, (int)num_tests, sieve, scratch));
-		ffbi_scratch_destroy(scratch);
+		fflog_debug_print("v is not a view.\n");
+		return;
+	}
+	//take the digits back from the caller before converting into the view's own storage
+	if(!v->reallocation_allowed)
+	{
+		v->digits = ffbi_inline_digits(v);
+		v->num_allocated_digits = v->num_inline_digits;
+		v->reallocation_allowed = 1;
 	}
+	ffbi_set_bytes<false>(v, buffer, size_bytes);
+}
+
+ffbi_sieve_t* ffbi_sieve_create()
+{
+	ffbi_sieve_t* ret = ffmem_alloc(ffbi_sieve_t);
+	memset(ret, 0, sizeof(ffbi_sieve_t));
 	return ret;
 }
 
-//Create a new bigint by making a copy of p. NULL is returned on error.
-ffbi_t* ffbi_create_from_bigint(ffbi_t* p)
+static void ffbi_sieve_clear_primorials(ffbi_sieve_t* sieve)
 {
-	ffbi_t* ret = ffbi_create_reserved_digits(p->num_allocated_digits);
-	ffbi_copy(ret, p);
+	for(int i=0;i<sieve->num_primorials;i++)
+		ffbi_destroy(sieve->primorials[i]);
+	if(sieve->primorials)
+		ffmem_free_arr(sieve->primorials);
+	sieve->primorials = NULL;
+	sieve->num_primorials = 0;
+}
+
+static void ffbi_sieve_clear(ffbi_sieve_t* sieve)
+{
+	ffbi_sieve_clear_primorials(sieve);
+	for(int i=0;i<sieve->num_primes;i++)
+		ffbi_destroy(sieve->primes[i]);
+	if(sieve->primes)
+		ffmem_free_arr(sieve->primes);
+	sieve->primes = NULL;
+	sieve->num_primes = 0;
+}
+
+void ffbi_sieve_destroy(ffbi_sieve_t* sieve)
+{
+	ffbi_sieve_clear(sieve);
+	ffmem_free(sieve);
+}
+
+ffbi_workspace_t* ffbi_workspace_create()
+{
+	ffbi_workspace_t* ret = ffmem_alloc(ffbi_workspace_t);
+	memset(ret, 0, sizeof(ffbi_workspace_t));
+	ret->overflow = ffmem_alloc(std::vector<ffbi_t*>);
 	return ret;
 }
 
-void ffbi_destroy(ffbi_t* p)
+static inline ffbi_t* ffbi_workspace_slot(ffbi_workspace_t* ws, uint32_t i)
 {
-	if(p->reallocation_allowed)
-		ffmem_free_arr(p->digits);
-	if(p->cache)
-		ffmem_free_arr(p->cache);
-	ffmem_free(p);
+	return (ffbi_t*)(ws->block + i*(FFBI_HEADER_WORDS + ws->slot_digits));
 }
 
-//Pass 1 for retain_value if retaining the value is important. Passing 0
-//will result in memory copying and extra checks to see if target_num_digits
-//should be respected.
-void ffbi_reallocate_digits(ffbi_t* p, int target_num_digits, uint8_t retain_value)
+static void ffbi_workspace_clear(ffbi_workspace_t* ws)
 {
-	if(p->reallocation_allowed == 0)
-	{
-		fflog_debug_print("reallocation not allowed.\n");
+	for(uint32_t i=0;i<ws->num_slots;i++)
+		ffbi_release(ffbi_workspace_slot(ws, i));
+	if(ws->block)
+		ffmem_free_arr(ws->block);
+	ws->block = NULL;
+	ws->num_slots = 0;
+	for(size_t i=0;i<ws->overflow->size();i++)
+		ffbi_destroy((*ws->overflow)[i]);
+	ws->overflow->clear();
+}
+
+void ffbi_workspace_destroy(ffbi_workspace_t* ws)
+{
+	ffbi_workspace_clear(ws);
+	ffmem_free(ws->overflow);
+	ffmem_free(ws);
+}
+
+//Makes sure ws can hand out num_vals more bigints of num_digits digits each from its block.
+//The block can only be replaced while no frames are open. Otherwise later requests are served
+//from overflow until the outermost frame is popped and the workspace is reserved again.
+void ffbi_workspace_reserve(ffbi_workspace_t* ws, uint32_t num_vals, uint32_t num_digits)
+{
+	if(ws->top > 0)
 		return;
-	}
-	if(retain_value)
-	{
-		if(target_num_digits < (int)p->num_used_digits)
-			target_num_digits = p->num_used_digits;
-	}
-	else
-	{
-		p->num_used_digits = 1;
-		p->cache_valid = 0;
-	}
-	if(target_num_digits == (int)p->num_allocated_digits)
+	if(num_digits < FFBI_MIN_ALLOC_DIGITS)
+		num_digits = FFBI_MIN_ALLOC_DIGITS;
+	uint32_t num_slots = ws->num_slots + (uint32_t)ws->overflow->size();
+	if(num_slots < num_vals)
+		num_slots = num_vals;
+	uint32_t slot_digits = ws->slot_digits > num_digits ? ws->slot_digits : num_digits;
+	if(num_slots == ws->num_slots && slot_digits == ws->slot_digits)
 		return;
-	if(target_num_digits < FFBI_MIN_ALLOC_DIGITS)
-		target_num_digits = FFBI_MIN_ALLOC_DIGITS;
-	ffbi_word_t* new_allocation = ffmem_alloc_arr(ffbi_word_t, target_num_digits);
-	if(retain_value)
-		memcpy(new_allocation, p->digits, p->num_used_digits*sizeof(ffbi_word_t));
-	ffmem_free_arr(p->digits);
-	p->digits = new_allocation;
-	p->num_allocated_digits = target_num_digits;
+	ffbi_workspace_clear(ws);
+	ws->block = ffmem_alloc_arr(ffbi_word_t, num_slots*(FFBI_HEADER_WORDS + slot_digits));
+	ws->num_slots = num_slots;
+	ws->slot_digits = slot_digits;
+	for(uint32_t i=0;i<num_slots;i++)
+		ffbi_init_block((ffbi_word_t*)ffbi_workspace_slot(ws, i), slot_digits);
 }
 
-//Attempt to reallocate memory used by p to hold specified number of bits.
-//If the specified number of bits is not enough to fit the current bigint value,
-//the reallocated memory will be just enough to fit the current value.
-void ffbi_reallocate(ffbi_t* p, uint32_t target_bits)
+uint32_t ffbi_workspace_push(ffbi_workspace_t* ws)
 {
-	int num_digits = target_bits/FFBI_BITS_PER_DIGIT;
-	if(target_bits%FFBI_BITS_PER_DIGIT > 0)
-		num_digits++;
-	ffbi_reallocate_digits(p, num_digits, 1);
+	return ws->top;
 }
 
-//Uses Fermat primality test to determine if p is prime. Increase
-//num_tests for higher chance p is actually prime. Probability of p being wrongly
-//detected as prime is 2^(-num_tests). If p is less than 16^8, it is not considered
-//large enough and will return false. A sieve may be optionally provided to quickly
-//weed out composites before the Fermat primality test. Pass NULL for sieve to skip
-//the sieve test. 1 is returned if p is prime and 0 is returned if otherwise.
-//scratch contains memory buffers used internally to minimize unnecessary allocations
-//for use in tight loops. Pass NULL for scratch for no optimizations.
-int ffbi_is_large_prime(ffbi_t* p, int num_tests, ffbi_scratch_t* sieve, ffbi_scratch_t* scratch)
+void ffbi_workspace_pop(ffbi_workspace_t* ws, uint32_t frame)
 {
-	if(num_tests < 1 || p == NULL)
-	{
-		fflog_debug_print("invalid arguments\n");
-		return 0;
-	}
-	int ret = 1;
-
-	//make sure we have scratch space
-	uint8_t free_scratch = 0;
-	if(scratch == NULL)
-	{
-		scratch = ffbi_scratch_create();
-		free_scratch = 1;
-	}
-	ffbi_scratch_prepare(scratch, FFBI_PRIME_TEST_NUM_SCRATCHES, p->num_used_digits);
-	ffbi_t** temp = scratch->val;
-	uint8_t free_child = 0;
-	if(scratch->num_children == 0)
-	{
-		scratch->child = ffbi_scratch_create();
-		scratch->num_children = 1;
-		free_child = 1;
-	}
-	ffbi_scratch_prepare(scratch->child, FFBI_MOD_POW_NUM_SCRATCHES, p->num_used_digits);
-	uint8_t free_inner_child = 0;
-	if(scratch->child->num_children == 0)
-	{
-		scratch->child->num_children = 1;
-		scratch->child->child = ffbi_scratch_create();
-		free_inner_child = 1;
-	}
-	ffbi_t* p_minus_1;
+	ws->top = frame;
+}
 
-	//if sieve was provided, see if p divides into any value in the sieve first
-	//uint32_t start_time = fftime_get_time_ms();
-	if(sieve != NULL)
+//Returns the next bigint of the current frame with value of 0 and at least num_digits allocated digits.
+//Returns NULL if the digits can't be allocated, in which case the frame is left as it was.
+ffbi_t* ffbi_workspace_get(ffbi_workspace_t* ws, uint32_t num_digits)
+{
+	ffbi_t* ret;
+	if(ws->top < ws->num_slots)
+		ret = ffbi_workspace_slot(ws, ws->top);
+	else
 	{
-		uint32_t i;
-		for(i=0;i<(uint32_t)sieve->num_vals;i++)
+		uint32_t i = ws->top - ws->num_slots;
+		if(i == ws->overflow->size())
 		{
-			ffbi_t* divisor = sieve->val[i];
-			if(ffbi_cmp(divisor, p) == 1)
-				break;
-			ffbi_div_impl(temp[2], p, divisor, temp[1], temp[3], scratch->child->val[0]);
-			if(temp[1]->num_used_digits == 1 && temp[1]->digits[0] == 0)
+			ret = ffbi_create_reserved_digits(num_digits);
+			if(ret == NULL)
 			{
-				ret = 0;
-				//fflog_print("sieve detected composite.\n");
-				goto finish;
+				fflog_debug_print("couldn't allocate %u digits.\n", num_digits);
+				return NULL;
 			}
+			ws->overflow->push_back(ret);
 		}
+		ret = (*ws->overflow)[i];
 	}
-	//fflog_print("finished sieve test in %u ms\n", fftime_get_time_ms() - start_time);
-
-	//run the Fermat primality test
-	p_minus_1 = temp[0];
-	temp[1]->num_used_digits = 1;
-	temp[1]->digits[0] = 1;
-	ffbi_sub(p_minus_1, p, temp[1]);
-	temp[2]->num_used_digits = 1;
-	temp[2]->digits[0] = 2;
-	ffbi_sub(temp[1], p_minus_1, temp[2]);
-	int k;
-	for(k=0;k<num_tests;k++)
-	{
-		ffbi_t* a = temp[2];
-		ffbi_t* dest = temp[3];
-		ffbi_random_with_limit(a, temp[1]);
-		ffbi_add_u(a, a, 2);
-		//fflog_print("line=%d\n", __LINE__);
-		//uint32_t start_time = fftime_get_time_ms();
-		ffbi_mod_pow(dest, a, p_minus_1, p, scratch->child);
-		//fflog_print("mod_pow finished in %u ms. k=%d\n", fftime_get_time_ms() - start_time, k);
-		//fflog_print("line=%d\n", __LINE__);
-		if(dest->num_used_digits > 1 || dest->digits[0] != 1)
-		{
-			ret = 0;
-			break;
-		}
-	}
-finish:
-	if(free_scratch)
-		ffbi_scratch_destroy(scratch);
-	else
-	{
-		if(free_child)
-		{
-			ffbi_scratch_destroy(scratch->child);
-			scratch->child = NULL;
-			scratch->num_children = 0;
-		}
-		else if(free_inner_child)
-		{
-			ffbi_scratch_destroy(scratch->child->child);
-			scratch->child->child = NULL;
-			scratch->child->num_children = 0;
-		}
-	}
+	if(ret->num_allocated_digits < num_digits && ffbi_reallocate_digits(ret, num_digits, 0))
+		return NULL;
+	ws->top++;
+	ret->num_used_digits = 1;
+	ret->digits[0] = 0;
+	ret->cache_valid = 0;
 	return ret;
 }
 
-uint32_t ffbi_get_significant_bits(ffbi_t* p)
+ffbi_ctx_t* ffbi_ctx_create()
 {
-	return (p->num_used_digits-1)*FFBI_BITS_PER_DIGIT + (uint32_t)ffbi_significant_bits(p->digits[p->num_used_digits-1]);
+	ffbi_ctx_t* ctx = ffmem_alloc(ffbi_ctx_t);
+	ctx->ws = NULL;
+	ctx->rand = NULL;
+#if FFBI_STATS_ENABLED
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+	ctx->stats_active = 0;
+#endif
+	return ctx;
 }
 
-//Returns the size of the buffer necessary to hold the serialized bigint p in bytes.
-int ffbi_get_serialized_size(ffbi_t* p)
+void ffbi_ctx_destroy(ffbi_ctx_t* ctx)
 {
-	uint32_t total_bits = ffbi_get_significant_bits(p);
-	return (int)(total_bits/8 + (total_bits%8 > 0));
+	if(ctx->ws)
+		ffbi_workspace_destroy(ctx->ws);
+	ffmem_free(ctx);
 }
 
-int ffbi_serialize_v2(ffbi_t* p, uint8_t* buffer, int size_bytes, uint32_t total_bits)
+//Destroys the thread's default context when the thread exits.
+typedef struct FFBI_THREAD_CTX
 {
-	ffbi_base_convert_t* ctx = ffbi_base_convert_create(8, FFBI_BITS_PER_DIGIT, total_bits);
-	int num_write_bytes = (int)ctx->dst_num_digits;
-	if(num_write_bytes < size_bytes)
-		return -1;
-	ffbi_base_convert_exec<uint8_t, ffbi_word_t>(ctx, buffer, p->digits);
-	ffbi_base_convert_destroy(ctx);
-	return num_write_bytes;
-}
+	ffbi_ctx_t* own;
+	ffbi_ctx_t* current;
+	~FFBI_THREAD_CTX()
+	{
+		if(own)
+			ffbi_ctx_destroy(own);
+	}
+} ffbi_thread_ctx_t;
 
-int ffbi_serialize(ffbi_t* p, uint8_t* buffer, int size_bytes)
-{
-	uint32_t total_bits = ffbi_get_significant_bits(p);
-	return ffbi_serialize_v2(p, buffer, size_bytes, total_bits);
-}
+static thread_local ffbi_thread_ctx_t _thread_ctx = {NULL, NULL};
 
-void ffbi_print_words(ffbi_t* p)
+ffbi_ctx_t* ffbi_ctx_get_thread()
 {
-	for(unsigned i=0;i<p->num_used_digits;i++)
-		fflog_print("[%llu]", (uint64_t)p->digits[i]);
-	fflog_print("\n");
+	if(_thread_ctx.current)
+		return _thread_ctx.current;
+	if(_thread_ctx.own == NULL)
+		_thread_ctx.own = ffbi_ctx_create();
+	return _thread_ctx.own;
 }
 
-void ffbi_deserialize(ffbi_t* p, uint8_t* buffer, int size_bytes)
+ffbi_ctx_t* ffbi_ctx_set_thread(ffbi_ctx_t* ctx)
 {
-	uint32_t total_bits = (size_bytes-1)*8 + ffbi_significant_bits_uint8(buffer[size_bytes-1]);
-	ffbi_base_convert_t* ctx = ffbi_base_convert_create(FFBI_BITS_PER_DIGIT, 8, total_bits);
-	if(ctx->dst_num_digits > p->num_allocated_digits)
-		ffbi_reallocate_digits(p, ctx->dst_num_digits, 0);
-	p->num_used_digits = ctx->dst_num_digits;
-	ffbi_base_convert_exec<ffbi_word_t, uint8_t>(ctx, p->digits, buffer);
-	ffbi_base_convert_destroy(ctx);
-	p->cache_valid = 0;
+	ffbi_ctx_t* prev = _thread_ctx.current;
+	_thread_ctx.current = ctx;
+	return prev;
 }
 
-//Prints the base 10 string representation of p into stdout appended with newline.
-void ffbi_print(ffbi_t* p)
+void ffbi_ctx_release_thread()
 {
-	if(p->num_used_digits == 1 && p->digits[0] == 0)
+	if(_thread_ctx.own)
 	{
-		fflog_print("0\n");
-		return;
+		if(_thread_ctx.current == _thread_ctx.own)
+			_thread_ctx.current = NULL;
+		ffbi_ctx_destroy(_thread_ctx.own);
+		_thread_ctx.own = NULL;
 	}
-	std::list<uint8_t> p_base_10;
-	ffbi_t* temp = ffbi_create_from_bigint(p);
-	ffbi_t* ten = ffbi_create();
-	ffbi_t* zero = ffbi_create();
-	ten->digits[0] = 10;
-	ffbi_t* r = ffbi_create_reserved_digits(p->num_allocated_digits);
-	ffbi_t* scratch = ffbi_create_reserved_digits(p->num_allocated_digits);
-	ffbi_t* scratch2 = ffbi_create_reserved_digits(p->num_allocated_digits);
-	ffbi_t* scratch3 = ffbi_create_reserved_digits(p->num_allocated_digits);
-	while(ffbi_cmp(temp, zero) == 1)
-	{
-		ffbi_div_impl(scratch3, temp, ten, r, scratch, scratch2);
-		ffbi_copy(temp, scratch3);
-		p_base_10.push_front((uint8_t)r->digits[0]);
-	}
-	std::list<uint8_t>::iterator it;
-	for(it=p_base_10.begin();it!=p_base_10.end();it++)
-		fflog_print("%u",(*it));
-	fflog_print("\n");
-	ffbi_destroy(scratch);
-	ffbi_destroy(scratch2);
-	ffbi_destroy(scratch3);
-	ffbi_destroy(r);
-	ffbi_destroy(zero);
-	ffbi_destroy(ten);
-	ffbi_destroy(temp);
 }
 
-static int ffbi_cmp_cache(ffbi_t* a, ffbi_t* b)
+ffbi_workspace_t* ffbi_ctx_get_workspace(ffbi_ctx_t* ctx)
 {
-	if(a->cache_num_used_digits > b->cache_num_used_digits)
-		return 1;
-	if(a->cache_num_used_digits < b->cache_num_used_digits)
-		return -1;
-	for(int k=(int)a->cache_num_used_digits-1;k>=0;k--)
-	{
-		if(a->cache[k] > b->cache[k])
-			return 1;
-		if(a->cache[k] < b->cache[k])
-			return -1;
-	}
-	return 0;
+	if(ctx->ws == NULL)
+		ctx->ws = ffbi_workspace_create();
+	return ctx->ws;
 }
 
-//[compare] returns 0 if a == b, 1 if a > b, or -1 if a < b.
-int ffbi_cmp(ffbi_t* a, ffbi_t* b)
+ffrand_t* ffbi_ctx_set_rand(ffbi_ctx_t* ctx, ffrand_t* r)
 {
-	//if a has more digits than b, it can be concluded that a is bigger
-	if(a->num_used_digits > b->num_used_digits)
-		return 1;
-	//if b has more digits than a, it can be concluded that b is bigger
-	if(a->num_used_digits < b->num_used_digits)
-		return -1;
-	//if code reaches here, a and b take up the same number of digits
-	//check digit values starting from most significant
-	for(int k=(int)a->num_used_digits-1;k>=0;k--)
-	{
-		if(a->digits[k] > b->digits[k])
-			return 1;
-		if(a->digits[k] < b->digits[k])
-			return -1;
-	}
-	return 0;
+	ffrand_t* prev = ctx->rand;
+	ctx->rand = r;
+	return prev;
 }
 
-//[addition] dest = a + b
-void ffbi_add(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+#if FFBI_STATS_ENABLED
+//Counts a call of op and marks op as running on the thread's context until the scope ends.
+typedef struct FFBI_STATS_SCOPE
 {
-	ffbi_t* larger;
-	uint32_t max_used_digits;
-	uint32_t min_used_digits;
-	if(a->num_used_digits >= b->num_used_digits)
-	{
-		larger = a;
-		min_used_digits = b->num_used_digits;
-	}
-	else
+	ffbi_ctx_t* ctx;
+	uint32_t prev_active;
+	FFBI_STATS_SCOPE(int op)
 	{
-		larger = b;
-		min_used_digits = a->num_used_digits;
+		ctx = ffbi_ctx_get_thread();
+		prev_active = ctx->stats_active;
+		ctx->stats_active |= 1u << op;
+		ctx->stats.ops[op].calls++;
 	}
-	max_used_digits = larger->num_used_digits;
-	if(dest->num_allocated_digits < max_used_digits) //first make sure dest is big enough
+	~FFBI_STATS_SCOPE()
 	{
-		if(dest != a && dest != b)
-			ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), 0);
-		else
-			ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), 1);
+		ctx->stats_active = prev_active;
 	}
+} ffbi_stats_scope_t;
 
-	//add the digits
-	uint32_t k;
-	dest->digits[0] = a->digits[0] + b->digits[0];
-	for(k=1;k<min_used_digits;k++)
-	{
-		dest->digits[k] = a->digits[k] + b->digits[k] + (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
-		dest->digits[k-1] &= _digit_max; //take carry out of previous digit sum
-	}
-	//propagate carry to the rest of the digits
-	for(;k<max_used_digits;k++)
-	{
-		dest->digits[k] = larger->digits[k] + (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
-		dest->digits[k-1] &= _digit_max; //take carry out of previous digit sum
-	}
-	//if last digit still has a carry, dest needs one more digit to hold it
-	k--;
-	if(dest->digits[k] >> FFBI_BITS_PER_DIGIT != 0)
+//Charges work to every running operation.
+static void ffbi_stats_charge(uint64_t limb_ops, uint64_t reallocations, uint64_t bytes_moved)
+{
+	ffbi_ctx_t* ctx = ffbi_ctx_get_thread();
+	for(uint32_t active=ctx->stats_active;active;active&=active-1)
 	{
-		max_used_digits++;
-		if(dest->num_allocated_digits < max_used_digits)
-			ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), 1);
-		dest->digits[k] &= _digit_max; //take carry out of previous digit sum
-		k++;
-		dest->digits[k] = 1; //newly appended digit now holds the carry
+		ffbi_op_stats_t* s = &ctx->stats.ops[__builtin_ctz(active)];
+		s->limb_ops += limb_ops;
+		s->reallocations += reallocations;
+		s->bytes_moved += bytes_moved;
 	}
-	dest->num_used_digits = max_used_digits;
-	dest->cache_valid = 0;
 }
 
-void ffbi_add_u(ffbi_t* dest, ffbi_t* a, uint32_t b)
+static void ffbi_stats_reallocated(uint64_t bytes_copied)
 {
-	if(dest != a)
-	{
-		if(dest->num_allocated_digits < a->num_used_digits)
-			ffbi_reallocate_digits(dest, a->num_used_digits + 2, 0);
-		dest->num_used_digits = a->num_used_digits;
-	}
-	dest->digits[0] = a->digits[0] + (b&_digit_max);
-	if(a->num_used_digits == 1)
-	{
-		dest->digits[1] = dest->digits[0]>>FFBI_BITS_PER_DIGIT;
-		dest->num_used_digits += dest->digits[1];
-	}
-	else
-		dest->digits[1] = a->digits[1] + (dest->digits[0]>>FFBI_BITS_PER_DIGIT);
-	dest->digits[0] &= _digit_max;
-#if FFBI_BITS_PER_DIGIT < 32
-	uint32_t hi = b>>FFBI_BITS_PER_DIGIT;
-	if(hi)
+	ffbi_ctx_t* ctx = ffbi_ctx_get_thread();
+	ctx->stats.reallocations++;
+	ctx->stats.bytes_reallocated += bytes_copied;
+	ffbi_stats_charge(0, 1, bytes_copied);
+}
+
+#define FFBI_STATS_COUNT(op) ffbi_stats_scope_t _stats_scope(op)
+#define FFBI_STATS_CHARGE(limb_ops, bytes_moved) ffbi_stats_charge(limb_ops, 0, bytes_moved)
+#define FFBI_STATS_REALLOCATED(bytes_copied) ffbi_stats_reallocated(bytes_copied)
+#else
+#define FFBI_STATS_COUNT(op)
+#define FFBI_STATS_CHARGE(limb_ops, bytes_moved)
+#define FFBI_STATS_REALLOCATED(bytes_copied)
+#endif
+
+int ffbi_stats_snapshot(ffbi_stats_t* stats)
+{
+#if FFBI_STATS_ENABLED
+	*stats = ffbi_ctx_get_thread()->stats;
+	return 1;
+#else
+	memset(stats, 0, sizeof(ffbi_stats_t));
+	return 0;
+#endif
+}
+
+void ffbi_stats_reset()
+{
+#if FFBI_STATS_ENABLED
+	memset(&ffbi_ctx_get_thread()->stats, 0, sizeof(ffbi_stats_t));
+#endif
+}
+
+ffbi_workspace_t* ffbi_workspace_get_thread()
+{
+	return ffbi_ctx_get_workspace(ffbi_ctx_get_thread());
+}
+
+void ffbi_workspace_release_thread()
+{
+	ffbi_ctx_t* ctx = ffbi_ctx_get_thread();
+	if(ctx->ws)
 	{
-		dest->digits[1] = a->digits[1] + hi;
-		if(dest->num_used_digits == 1)
-			dest->num_used_digits++;
+		ffbi_workspace_destroy(ctx->ws);
+		ctx->ws = NULL;
 	}
-#endif
-	int i = 1;
-	uint32_t carry = dest->digits[i]>>FFBI_BITS_PER_DIGIT;
-	while(carry>0)
+}
+
+static uint64_t ffbi_gcd_digit(uint64_t u, uint64_t v)
+{
+	if(u == 0)
+		return v;
+	if(v == 0)
+		return u;
+	int shift = __builtin_ctzll(u|v);
+	u >>= __builtin_ctzll(u);
+	do
 	{
-		i++;
-		if(i+1 > (int)dest->num_used_digits)
+		v >>= __builtin_ctzll(v);
+		if(u > v)
 		{
-			dest->num_used_digits = i+1;
-			if(dest->num_allocated_digits < dest->num_used_digits)
-				ffbi_reallocate_digits(dest, dest->num_used_digits + 2, 1);
-			dest->digits[i] = 0;
+			uint64_t t = v;
+			v = u;
+			u = t;
 		}
-		dest->digits[i] += carry;
-		carry = dest->digits[i]>>FFBI_BITS_PER_DIGIT;
+		v -= u;
 	}
-	dest->cache_valid = 0;
+	while(v != 0);
+	return u << shift;
 }
 
-#if FFBI_DIV_CACHE_ENABLED
-//a and b's cache is assumed to be already built. dest must not point to a or b.
-static void ffbi_sub_cache(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+//p must not be 0.
+static uint32_t ffbi_trailing_zeros(ffbi_t* p)
 {
-	//dest should have enough allocated digits to fit the larger of a and b
-	uint32_t a_used_digits = a->cache_num_used_digits;
-	uint32_t b_used_digits = b->cache_num_used_digits;
-	uint32_t max_used_digits;
-	uint32_t min_used_digits;
-	if(b_used_digits > a_used_digits)
-	{
-		max_used_digits = b_used_digits;
-		min_used_digits = a_used_digits;
-	}
-	else
-	{
-		max_used_digits = a_used_digits;
-		min_used_digits = b_used_digits;
-	}
-	if(dest->cache_num_allocated_digits < max_used_digits)
-		ffbi_cache_prepare(dest, (int)max_used_digits, 0);
+	uint32_t i = 0;
+	while(p->digits[i] == 0)
+		i++;
+	return i*FFBI_BITS_PER_DIGIT + __builtin_ctzll((uint64_t)p->digits[i]);
+}
 
-	//subtract digits of a and b
-	uint32_t k;
-	dest->cache[0] = a->cache[0] + _cache_div_digit_max_plus_1 - b->cache[0];
-	for(k=1;k<min_used_digits;k++)
-	{
-		ffbi_cache_word_t carry = 1 - (dest->cache[k-1] >> dest->cache_bits_per_digit);
-		dest->cache[k-1] &= _cache_div_digit_max; //clear previous carry
-		dest->cache[k] = a->cache[k] + _cache_div_digit_max_plus_1 - b->cache[k] - carry;
-	}
-	if(b_used_digits > a_used_digits) //then use value of 0 for any digit of a beyond this point
+uint32_t ffbi_bit_length(ffbi_t* p)
+{
+	if(ffbi_is_zero(p))
+		return 0;
+	return ffbi_get_significant_bits(p);
+}
+
+int ffbi_test_bit(ffbi_t* p, uint32_t bit)
+{
+	uint32_t d = bit/FFBI_BITS_PER_DIGIT;
+	if(d >= p->num_used_digits)
+		return 0;
+	return (int)(p->digits[d] >> (bit%FFBI_BITS_PER_DIGIT)) & 1;
+}
+
+uint32_t ffbi_popcount(ffbi_t* p)
+{
+	uint32_t ret = 0;
+	for(uint32_t i=0;i<p->num_used_digits;i++)
+		ret += (uint32_t)__builtin_popcountll((uint64_t)p->digits[i]);
+	return ret;
+}
+
+void ffbi_shr(ffbi_t* dest, ffbi_t* a, uint32_t bits)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	uint32_t digit_shift = bits/FFBI_BITS_PER_DIGIT;
+	uint32_t bit_shift = bits%FFBI_BITS_PER_DIGIT;
+	if(digit_shift >= a->num_used_digits)
 	{
-		for(;k<max_used_digits;k++)
-		{
-			ffbi_cache_word_t carry = 1 - (dest->cache[k-1] >> dest->cache_bits_per_digit);
-			dest->cache[k-1] &= _cache_div_digit_max; //clear previous carry
-			dest->cache[k] = _cache_div_digit_max_plus_1 - b->cache[k] - carry;
-		}
+		dest->num_used_digits = 1;
+		dest->digits[0] = 0;
+		dest->cache_valid = 0;
+		return;
 	}
+	uint32_t len = a->num_used_digits - digit_shift;
+	if(dest->num_allocated_digits < len && ffbi_reallocate_digits(dest, len, 0))
+		return;
+	uint32_t i;
+	//dest is written from the bottom up, which never overwrites digits of a that are still to be read
+	if(bit_shift == 0)
+		memmove(dest->digits, &a->digits[digit_shift], len*sizeof(ffbi_word_t));
 	else
 	{
-		for(;k<max_used_digits;k++) //continue propagating carry as normal since a has at least b number of digits
-		{
-			ffbi_cache_word_t carry = 1 - (dest->cache[k-1] >> dest->cache_bits_per_digit);
-			dest->cache[k-1] &= _cache_div_digit_max; //clear previous carry
-			dest->cache[k] = a->cache[k] + _cache_div_digit_max_plus_1 - carry;
-		}
+		for(i=0;i<len-1;i++)
+			dest->digits[i] = (a->digits[i+digit_shift] >> bit_shift) | ((a->digits[i+digit_shift+1] << (FFBI_BITS_PER_DIGIT-bit_shift)) & _digit_max);
+		dest->digits[i] = a->digits[i+digit_shift] >> bit_shift;
 	}
-	k--;
-	dest->cache[k] &= _cache_div_digit_max; //clear previous carry
+	if(len > 1 && dest->digits[len-1] == 0)
+		len--;
+	dest->num_used_digits = len;
+	dest->cache_valid = 0;
+}
 
-	//see if dest can have less used digits than a, then assign number of used digits
-	for(;k>0;k--)
+void ffbi_shl(ffbi_t* dest, ffbi_t* a, uint32_t bits)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	if(dest != a)
+		ffbi_copy(dest, a);
+	if(bits == 0 || ffbi_is_zero(dest))
+		return;
+	uint32_t digit_shift = bits/FFBI_BITS_PER_DIGIT;
+	uint32_t bit_shift = bits%FFBI_BITS_PER_DIGIT;
+	uint32_t len = dest->num_used_digits + digit_shift + 1;
+	if(dest->num_allocated_digits < len && ffbi_reallocate_digits(dest, len, 1))
+		return;
+	int i;
+	dest->digits[len-1] = 0;
+	for(i=(int)dest->num_used_digits-1;i>=0;i--)
 	{
-		if(dest->cache[k] != 0)
-			break;
+		dest->digits[i+digit_shift+1] |= dest->digits[i] >> (FFBI_BITS_PER_DIGIT-bit_shift);
+		dest->digits[i+digit_shift] = (dest->digits[i] << bit_shift) & _digit_max;
 	}
-	dest->cache_num_used_digits = k+1;
+	memset(dest->digits, 0, digit_shift*sizeof(ffbi_word_t));
+	if(dest->digits[len-1] == 0)
+		len--;
+	dest->num_used_digits = len;
+	dest->cache_valid = 0;
 }
-#endif
 
-//[subtraction] dest = a - b
-void ffbi_sub(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+//Applies op to the digits of a and b, treating missing digits as 0, for len digits.
+template<typename Op>
+static void ffbi_bitwise(ffbi_t* dest, ffbi_t* a, ffbi_t* b, uint32_t len, Op op)
 {
-	//dest should have enough allocated digits to fit the larger of a and b
-	uint32_t a_used_digits = a->num_used_digits;
-	uint32_t b_used_digits = b->num_used_digits;
-	uint32_t max_used_digits;
-	uint32_t min_used_digits;
-	if(b_used_digits > a_used_digits)
+	FFBI_RETURN_IF_VIEW(dest);
+	uint32_t a_len = a->num_used_digits;
+	uint32_t b_len = b->num_used_digits;
+	if(dest->num_allocated_digits < len && ffbi_reallocate_digits(dest, len, dest == a || dest == b))
+		return;
+	for(uint32_t i=0;i<len;i++)
+		dest->digits[i] = op(i < a_len ? a->digits[i] : 0, i < b_len ? b->digits[i] : 0);
+	dest->num_used_digits = ffbi_trim_len(dest->digits, len);
+	dest->cache_valid = 0;
+}
+
+void ffbi_and(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	uint32_t len = a->num_used_digits < b->num_used_digits ? a->num_used_digits : b->num_used_digits;
+	ffbi_bitwise(dest, a, b, len, [](ffbi_word_t x, ffbi_word_t y) { return x & y; });
+}
+
+void ffbi_or(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	uint32_t len = a->num_used_digits > b->num_used_digits ? a->num_used_digits : b->num_used_digits;
+	ffbi_bitwise(dest, a, b, len, [](ffbi_word_t x, ffbi_word_t y) { return x | y; });
+}
+
+void ffbi_xor(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	uint32_t len = a->num_used_digits > b->num_used_digits ? a->num_used_digits : b->num_used_digits;
+	ffbi_bitwise(dest, a, b, len, [](ffbi_word_t x, ffbi_word_t y) { return x ^ y; });
+}
+
+//Returns a % d for a single digit d. d must not be 0.
+static ffbi_word_t ffbi_mod_digit(ffbi_t* a, ffbi_word_t d)
+{
+	ffbi_word_t r = 0;
+	for(int i=(int)a->num_used_digits-1;i>=0;i--)
+		r = ((r << FFBI_BITS_PER_DIGIT) + a->digits[i]) % d;
+	return r;
+}
+
+//Fills a sieve for primality testing.
+//n is the max possible prime value that the sieve contains.
+//A recommended value is 100000.
+void ffbi_get_sieve(ffbi_sieve_t* sieve, uint32_t n)
+{
+	if(n < 3)
 	{
-		max_used_digits = b_used_digits;
-		min_used_digits = a_used_digits;
+		fflog_debug_print("n can't be less than 3.\n");
+		return;
 	}
-	else
+	uint8_t* arr =  ffmem_alloc_arr(uint8_t, n);
+	memset(arr, 1, n);
+	ffbi_word_t k = 2;
+	ffbi_word_t k_end = n/2+1;
+	ffbi_word_t i;
+	while(1)
 	{
-		max_used_digits = a_used_digits;
-		min_used_digits = b_used_digits;
+		//get new k
+		for(;k<k_end;k++)
+		{
+			if(arr[k] == 1)
+				break;
+		}
+		//check if done
+		if(k==k_end)
+			break;
+		//if not done, cross out multiples of k
+		for(i=k*2;i<n;i+=k)
+			arr[i] = 0;
+		k++;
 	}
-	if(dest->num_allocated_digits < max_used_digits)
+	//count primes
+	int num_primes = 0;
+	for(k=3;k<n;k++)
+		if(arr[k] == 1)
+			num_primes++;
+	//insert them into a sieve. primorials built from a previous sieve no longer match it
+	ffbi_sieve_clear(sieve);
+	sieve->num_primes = num_primes;
+	sieve->primes = ffmem_alloc_arr(ffbi_t*, num_primes);
+	int num_digits = 32/FFBI_BITS_PER_DIGIT+((32%FFBI_BITS_PER_DIGIT) > 0);
+	int alloc_digits = num_digits;
+	if(alloc_digits < FFBI_MIN_ALLOC_DIGITS)
+		alloc_digits = FFBI_MIN_ALLOC_DIGITS;
+	for(i=0;i<(uint32_t)num_primes;i++)
+		sieve->primes[i] = ffbi_create_reserved_digits(alloc_digits);
+	i=0;
+	for(k=3;k<n;k++)
 	{
-		if(dest != a)
-			ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), 0);
-		else
-			ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), 1);
+		if(arr[k] == 1)
+		{
+			int j;
+			for(j=0;j<num_digits;j++)
+				sieve->primes[i]->digits[j] = (k>>(j*FFBI_BITS_PER_DIGIT))&_digit_max;
+			j--;
+			for(;j>0;j--)
+			{
+				if(sieve->primes[i]->digits[j] != 0)
+					break;
+			}
+			sieve->primes[i]->num_used_digits = j+1;
+			i++;
+		}
 	}
+	ffmem_free_arr(arr);
+}
 
-	//subtract digits of a and b
-	uint32_t k;
-	dest->digits[0] = a->digits[0] + _digit_max_plus_1 - b->digits[0];
-	for(k=1;k<min_used_digits;k++)
+//Multiplies the primes of a sieve created by ffbi_get_sieve into primorials of at most
+//primorial_bits bits each. The primorials are kept in the sieve so ffbi_is_large_prime can
+//reject a composite with one ffbi_gcd per primorial instead of one division per prime.
+void ffbi_get_sieve_primorials(ffbi_sieve_t* sieve, uint32_t primorial_bits)
+{
+	if(sieve->num_primes == 0)
 	{
-		ffbi_word_t carry = 1 - (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
-		dest->digits[k-1] &= _digit_max; //clear previous carry
-		dest->digits[k] = a->digits[k] + _digit_max_plus_1 - b->digits[k] - carry;
+		fflog_debug_print("sieve must be filled by ffbi_get_sieve first.\n");
+		return;
 	}
-	if(b_used_digits > a_used_digits) //then use value of 0 for any digit of a beyond this point
+	if(primorial_bits < FFBI_BITS_PER_DIGIT)
+		primorial_bits = FFBI_BITS_PER_DIGIT;
+	uint32_t primorial_digits = primorial_bits/FFBI_BITS_PER_DIGIT + 2;
+	std::vector<ffbi_t*> primorials;
+	ffbi_t* product = NULL;
+	ffbi_t* temp = ffbi_create_reserved_digits(primorial_digits);
+	for(int i=0;i<sieve->num_primes;i++)
 	{
-		for(;k<max_used_digits;k++)
+		ffbi_t* prime = sieve->primes[i];
+		if(product != NULL && ffbi_get_significant_bits(product) + ffbi_get_significant_bits(prime) > primorial_bits)
 		{
-			ffbi_word_t carry = 1 - (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
-			dest->digits[k-1] &= _digit_max; //clear previous carry
-			dest->digits[k] = _digit_max_plus_1 - b->digits[k] - carry;
+			primorials.push_back(product);
+			product = NULL;
 		}
-	}
-	else
-	{
-		for(;k<max_used_digits;k++) //continue propagating carry as normal since a has at least b number of digits
+		if(product == NULL)
 		{
-			ffbi_word_t carry = 1 - (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
-			dest->digits[k-1] &= _digit_max; //clear previous carry
-			dest->digits[k] = a->digits[k] + _digit_max_plus_1 - carry;
+			product = ffbi_create_reserved_digits(primorial_digits);
+			ffbi_copy(product, prime);
+		}
+		else
+		{
+			ffbi_mul(temp, product, prime);
+			ffbi_copy(product, temp);
 		}
 	}
-	k--;
-	dest->digits[k] &= _digit_max; //clear previous carry
+	primorials.push_back(product);
+	ffbi_destroy(temp);
 
-	//see if dest can have less used digits than a, then assign number of used digits
-	for(;k>0;k--)
-	{
-		if(dest->digits[k] != 0)
-			break;
-	}
-	dest->num_used_digits = k+1;
-	dest->cache_valid = 0;
+	ffbi_sieve_clear_primorials(sieve);
+	sieve->num_primorials = (int)primorials.size();
+	sieve->primorials = ffmem_alloc_arr(ffbi_t*, sieve->num_primorials);
+	for(int i=0;i<sieve->num_primorials;i++)
+		sieve->primorials[i] = primorials[i];
 }
 
-#if FFBI_MUL_CACHE_ENABLED
-static void ffbi_mul_cache(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+static inline ffrand_t* ffbi_get_rand()
 {
-	ffbi_cache_update(a, FFBI_CACHE_MUL_BITS_PER_DIGIT, _cache_mul_digit_max);
-	ffbi_cache_update(b, FFBI_CACHE_MUL_BITS_PER_DIGIT, _cache_mul_digit_max);
-	uint32_t product_len = a->cache_num_used_digits+b->cache_num_used_digits;
-	ffbi_cache_prepare(dest, product_len, 0);
-	dest->cache_num_used_digits = product_len;
-	dest->cache_bits_per_digit = FFBI_CACHE_MUL_BITS_PER_DIGIT;
-	memset(dest->cache, 0, product_len*sizeof(ffbi_cache_word_t));
-	uint32_t k, i;
-	for(k=0;k<a->cache_num_used_digits;k++)
-	{
-		for(i=0;i<b->cache_num_used_digits;i++)
-		{
-			uint32_t add_index = k+i;
-			dest->cache[add_index] += a->cache[k] * b->cache[i];
-			dest->cache[add_index+1] += dest->cache[add_index]>>FFBI_CACHE_MUL_BITS_PER_DIGIT;
-			dest->cache[add_index] &= _cache_mul_digit_max;
-			add_index++;
-			while((dest->cache[add_index]>>FFBI_CACHE_MUL_BITS_PER_DIGIT) != 0) //propagate carry as long as it exists
-			{
-				dest->cache[add_index] &= _cache_mul_digit_max;
-				add_index++;
-				dest->cache[add_index] += 1;
-				if(add_index >= product_len)
-					break;
-			}
-		}
-	}
-	//see if there are trailing 0-value digits that can be trimmed off of the product
-	if(dest->cache_num_used_digits > 1 && dest->cache[product_len-1] == 0)
-		dest->cache_num_used_digits--;
-
-	ffbi_cache_retrieve(dest);
+	ffrand_t* r = ffbi_ctx_get_thread()->rand;
+	if(r)
+		return r;
+	return ffrand_get_thread();
 }
-#endif
 
-#if FFBI_DIV_CACHE_ENABLED
-static void ffbi_div_cache_mul(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+//Generate a random bigint with specified number of bits.
+void ffbi_random(ffbi_t* p, uint32_t num_bits)
 {
-	uint32_t product_len = a->cache_num_used_digits+b->cache_num_used_digits;
-	ffbi_cache_prepare(dest, product_len, 0);
-	dest->cache_num_used_digits = product_len;
-	dest->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
-	memset(dest->cache, 0, product_len*sizeof(ffbi_cache_word_t));
-	uint32_t k, i;
-	for(k=0;k<a->cache_num_used_digits;k++)
+	FFBI_RETURN_IF_VIEW(p);
+	if(num_bits < FFBI_BITS_PER_DIGIT)
 	{
-		for(i=0;i<b->cache_num_used_digits;i++)
-		{
-			uint32_t add_index = k+i;
-			//ffbi_cache_word_t p = a->cache[k] * b->cache[i];
-			//dest->cache[add_index+1] += p>>FFBI_CACHE_DIV_BITS_PER_DIGIT;
-			//dest->cache[add_index] += p&_cache_div_digit_max;
-			dest->cache[add_index] += a->cache[k] * b->cache[i];
-			/*
-			add_index++;
-			while((dest->cache[add_index]>>FFBI_CACHE_DIV_BITS_PER_DIGIT) != 0) //propagate carry as long as it exists
-			{
-				dest->cache[add_index] &= _cache_div_digit_max;
-				add_index++;
-				dest->cache[add_index] += 1;
-				if(add_index >= product_len)
-					break;
-			}*/
-		}
+		fflog_debug_print("num_bits can't be less than %d.\n", FFBI_BITS_PER_DIGIT);
+		return;
 	}
-	for(i=0;i<product_len-1;i++)
+	int num_digits = num_bits/FFBI_BITS_PER_DIGIT;
+	int remaining_bits = num_bits%FFBI_BITS_PER_DIGIT;
+	if(remaining_bits > 0)
+		num_digits++;
+	if(p->num_allocated_digits < (uint32_t)num_digits && ffbi_reallocate_digits(p, num_digits, 0))
+		return;
+	p->num_used_digits = num_digits;
+
+	//fill whole digits from the random stream, then trim the top digit to the requested bit length
+	ffrand_t* r = ffbi_get_rand();
+	for(int i=0;i<num_digits;i++)
+		p->digits[i] = ffrand_u64(r) & _digit_max;
+	if(remaining_bits > 0)
 	{
-		dest->cache[i+1] += dest->cache[i]>>FFBI_CACHE_DIV_BITS_PER_DIGIT;
-		dest->cache[i] &= _cache_div_digit_max;
+		p->digits[num_digits-1] &= (((ffbi_word_t)1) << remaining_bits) - 1;
+		p->digits[num_digits-1] |= ((ffbi_word_t)1) << (remaining_bits-1);
 	}
-	//see if there are trailing 0-value digits that can be trimmed off of the product
-	if(dest->cache_num_used_digits > 1 && dest->cache[product_len-1] == 0)
-		dest->cache_num_used_digits--;
+	else
+		p->digits[num_digits-1] |= ((ffbi_word_t)1) << (FFBI_BITS_PER_DIGIT-1);
+	p->cache_valid = 0;
 }
-#endif
 
-//[multiplication] dest = a * b
-void ffbi_mul(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+//Uses rejection sampling on whole digits. Each attempt succeeds with a probability of at least one half.
+void ffbi_random_with_limit(ffbi_t* p, ffbi_t* limit)
 {
-	if(ffbi_is_zero(a) || ffbi_is_zero(b))
+	FFBI_RETURN_IF_VIEW(p);
+	if(ffbi_is_zero(limit))
 	{
-		dest->num_used_digits = 1;
-		dest->digits[0] = 0;
-		dest->cache_valid = 0;
+		fflog_debug_print("limit should be greater than 0.\n");
+		p->num_used_digits = 1;
+		p->digits[0] = 0;
+		p->cache_valid = 0;
 		return;
 	}
-	ffbi_t* product;
-	uint32_t a_len = a->num_used_digits;
-	uint32_t b_len = b->num_used_digits;
-	uint32_t product_len =  a_len+b_len;
-	if(dest == a || dest == b)
-		product = ffbi_create_reserved_digits(product_len+FFBI_MIN_ALLOC_DIGITS);
-	else
+	uint32_t num_digits = limit->num_used_digits;
+	if(p->num_allocated_digits < num_digits && ffbi_reallocate_digits(p, num_digits, 0))
+		return;
+	ffbi_word_t top_mask = (((ffbi_word_t)1) << ffbi_significant_bits(limit->digits[num_digits-1])) - 1;
+	ffrand_t* r = ffbi_get_rand();
+	p->num_used_digits = num_digits;
+	do
 	{
-		product = dest;
-		if(product->num_allocated_digits < product_len)
-			ffbi_reallocate_digits(product, product_len+1, 0);
+		for(uint32_t i=0;i<num_digits;i++)
+			p->digits[i] = ffrand_u64(r) & _digit_max;
+		p->digits[num_digits-1] &= top_mask;
 	}
-#if FFBI_MUL_CACHE_ENABLED
-	if(a_len > _min_mul_cache_len || b_len > _min_mul_cache_len)
-		ffbi_mul_cache(product, a, b);
-	else
+	while(ffbi_cmp(p, limit) != -1);
+	int i;
+	for(i=num_digits-1;i>0;i--)
 	{
-#endif
-		product->num_used_digits = product_len;
-		//product->digits[product_len-1] = 0;
-		memset(product->digits, 0, product_len*sizeof(ffbi_word_t));
-		uint32_t k, i;
-		for(k=0;k<a_len;k++)
-		{
-			for(i=0;i<b_len;i++)
-			{
-				uint32_t add_index = k+i;
-				//ffbi_word_t p = a->digits[k] * b->digits[i];
-				//product->digits[add_index] += p&_digit_max;
-				//product->digits[add_index+1] += p>>FFBI_BITS_PER_DIGIT;
-				product->digits[add_index] += a->digits[k] * b->digits[i];
-				/*
-				add_index++;
-				while((product->digits[add_index]>>FFBI_BITS_PER_DIGIT) != 0) //propagate carry as long as it exists
-				{
-					product->digits[add_index] &= _digit_max;
-					add_index++;
-					product->digits[add_index] += 1;
-					if(add_index >= product_len)
-						break;
-				}*/
-			}
-		}
-		for(i=0;i<product_len-1;i++)
-		{
-			product->digits[i+1] += product->digits[i]>>FFBI_BITS_PER_DIGIT;
-			product->digits[i] &= _digit_max;
-		}
-		//see if there are trailing 0-value digits that can be trimmed off of the product
-		if(product->num_used_digits > 1 && product->digits[product_len-1] == 0)
-			product->num_used_digits--;
-		dest->cache_valid = 0;
-#if FFBI_MUL_CACHE_ENABLED
+		if(p->digits[i] != 0)
+			break;
 	}
-#endif
-	if(product != dest) //then copy product to dest
+	p->num_used_digits = i+1;
+	p->cache_valid = 0;
+}
+
+//Generate a random large prime bigint with specified number of bits.
+//The more tests, the greater the chance of the bigint to actually be prime,
+//but the time it takes is considerably longer. 20 for num_tests is recommended
+//as it would mean there is about one-in-a-million chance for the bigint to
+//not be prime. A sieve may be optionally provided to quickly weed out
+//composites before the Fermat primality test. Pass NULL for sieve to skip
+//the sieve test. NULL is returned on error.
+ffbi_t* ffbi_create_random_large_prime(uint32_t bits, uint32_t num_tests, ffbi_sieve_t* sieve)
+{
+	ffbi_t* ret = ffbi_create_reserved_bits(bits);
+	if(ret)
 	{
-		ffbi_copy(dest, product);
-		ffbi_destroy(product);
+		do
+		{
+			ffbi_random(ret, bits);
+			ret->digits[0] |= 1;
+		}
+		while(!ffbi_is_large_prime(ret, (int)num_tests, sieve, NULL));
 	}
+	return ret;
 }
 
-/*
-static void ffbi_mul_karatsuba(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_scratch_t* scratch)
+//Create a new bigint by making a copy of p. NULL is returned on error.
+ffbi_t* ffbi_create_from_bigint(ffbi_t* p)
 {
-	if(a->num_used_digits == 1 || b->num_used_digits == 1)
+	ffbi_t* ret = ffbi_create_reserved_digits(p->num_allocated_digits);
+	ffbi_copy(ret, p);
+	return ret;
+}
+
+void ffbi_destroy(ffbi_t* p)
+{
+	ffbi_release(p);
+	ffmem_free_arr((ffbi_word_t*)p);
+}
+
+//Moves the digits of p to target_num_digits digits of the heap, or back to its inline digits if they are enough.
+//Returns 0 on success and 1 on error, in which case p is left as it was.
+static int ffbi_reallocate_heap_digits(ffbi_t* p, int target_num_digits, uint8_t retain_value)
+{
+	if(target_num_digits < FFBI_MIN_ALLOC_DIGITS)
+		target_num_digits = FFBI_MIN_ALLOC_DIGITS;
+	ffbi_word_t* inline_digits = ffbi_inline_digits(p);
+	if(target_num_digits <= (int)p->num_inline_digits)
 	{
-		ffbi_mul_long(dest, a, b);
-		return;
+		//fall back to the inline digits instead of allocating
+		if(p->digits == inline_digits)
+			return 0;
+		if(retain_value)
+			memcpy(inline_digits, p->digits, p->num_used_digits*sizeof(ffbi_word_t));
+		FFBI_STATS_REALLOCATED(retain_value ? p->num_used_digits*sizeof(ffbi_word_t) : 0);
+		ffmem_free_arr(p->digits);
+		p->digits = inline_digits;
+		p->num_allocated_digits = p->num_inline_digits;
+		return 0;
 	}
-	ffbi_scratch_prepare(scratch, FFBI_KARATSUBA_NUM_VALS, a->num_used_digits+b->num_used_digits);
-	if(scratch->num_children == 0)
+	ffbi_word_t* new_allocation = ffmem_alloc_arr(ffbi_word_t, target_num_digits);
+	if(new_allocation == NULL)
 	{
-		scratch->num_children = 1;
-		scratch->child = ffbi_scratch_create();
+		fflog_debug_print("couldn't allocate %d digits.\n", target_num_digits);
+		return 1;
 	}
-	uint32_t m = a->num_used_digits;
-	if(m < b->num_used_digits)
-		m = b->num_used_digits;
-	uint32_t m2 = m>>1;
-	ffbi_t* high_a = scratch->val[0];
-	ffbi_t* high_b = scratch->val[1];
-	ffbi_t* low_a = scratch->val[2];
-	ffbi_t* low_b = scratch->val[3];
-	ffbi_t* z0 = scratch->val[4];
-	ffbi_t* z1 = scratch->val[5];
-	ffbi_t* z2 = scratch->val[6];
-	uint8_t z2_is_zero = 0;
-	if(m2 >= a->num_used_digits) //then there's no high_a
+	if(retain_value)
+		memcpy(new_allocation, p->digits, p->num_used_digits*sizeof(ffbi_word_t));
+	FFBI_STATS_REALLOCATED(retain_value ? p->num_used_digits*sizeof(ffbi_word_t) : 0);
+	ffbi_free_digits(p);
+	p->digits = new_allocation;
+	p->num_allocated_digits = target_num_digits;
+	return 0;
+}
+
+//Same as ffbi_reallocate_digits, but also resizes the storage a view owns while it isn't over caller digits.
+static int ffbi_reallocate_digits_impl(ffbi_t* p, int target_num_digits, uint8_t retain_value)
+{
+	if(p->reallocation_allowed == 0)
 	{
-		z2->num_used_digits = 1;
-		z2->digits[0] = 0;
-		z2_is_zero = 1;
-		high_a->num_used_digits = 1;
-		high_a->digits[0] = 0;
+		fflog_debug_print("reallocation not allowed.\n");
+		return 1;
 	}
-	else
+	if(retain_value)
 	{
-		high_a->num_used_digits = a->num_used_digits - m2;
-		memcpy(high_a->digits, &a->digits[m2], high_a->num_used_digits*sizeof(uint32_t));
+		if(target_num_digits < (int)p->num_used_digits)
+			target_num_digits = p->num_used_digits;
 	}
-	if(m2 >= b->num_used_digits) //then there's no high_b
+	if(p->is_mapped)
 	{
-		z2->num_used_digits = 1;
-		z2->digits[0] = 0;
-		z2_is_zero = 1;
-		high_b->num_used_digits = 1;
-		high_b->digits[0] = 0;
+		//the file only grows, and its contents stay put when it is mapped again
+		if(target_num_digits > (int)p->num_allocated_digits)
+		{
+			if(ffbi_map_digits(p, (uint32_t)target_num_digits))
+				return 1;
+			FFBI_STATS_REALLOCATED(0);
+		}
 	}
-	else
+	else if(target_num_digits != (int)p->num_allocated_digits && ffbi_reallocate_heap_digits(p, target_num_digits, retain_value))
+		return 1;
+	if(!retain_value)
 	{
-		high_b->num_used_digits = b->num_used_digits - m2;
-		memcpy(high_b->digits, &b->digits[m2], high_b->num_used_digits*sizeof(uint32_t));
+		p->num_used_digits = 1;
+		p->cache_valid = 0;
 	}
-	if(!z2_is_zero)
-		ffbi_mul_karatsuba(z2, high_a, high_b, scratch->child);
-	low_a->num_used_digits = m2;
-	if(low_a->num_used_digits > a->num_used_digits)
-		low_a->num_used_digits = a->num_used_digits;
-	memcpy(low_a->digits, a->digits, low_a->num_used_digits*sizeof(uint32_t));
-	low_b->num_used_digits = m2;
-	if(low_b->num_used_digits > b->num_used_digits)
-		low_b->num_used_digits = b->num_used_digits;
-	memcpy(low_b->digits, b->digits, low_b->num_used_digits*sizeof(uint32_t));
-	ffbi_mul_karatsuba(z0, low_a, low_b, scratch->child);
-	ffbi_add(low_a, low_a, high_a);
-	ffbi_add(low_b, low_b, high_b);
-	ffbi_mul_karatsuba(z1, low_a, low_b, scratch->child);
-	uint32_t m3 = m2<<1;
-	uint32_t temp = z2->num_used_digits + m3;
-	if(temp > scratch->val[0]->num_allocated_digits)
-		ffbi_reallocate_digits(scratch->val[0], temp);
-	scratch->val[0]->num_used_digits = temp;
-	memset(scratch->val[0]->digits, 0, sizeof(uint32_t)*m3);
-	memcpy(&scratch->val[0]->digits[m3], z2->digits, sizeof(uint32_t)*z2->num_used_digits);
-	uint32_t greatest = z1->num_used_digits;
-	if(z2->num_used_digits > greatest)
-		greatest = z2->num_used_digits;
-	if(z0->num_used_digits > greatest)
-		greatest = z0->num_used_digits;
-	temp = greatest + m2;
-	if(temp > scratch->val[2]->num_allocated_digits)
-		ffbi_reallocate_digits(scratch->val[2], temp);
-	memset(scratch->val[2]->digits, 0, sizeof(uint32_t)*m2);
-
-	scratch->val[2]->num_used_digits = z1->num_used_digits + m2;
-	memcpy(&scratch->val[2]->digits[m2],z1->digits, sizeof(uint32_t)*z1->num_used_digits);
-	ffbi_add(scratch->val[0], scratch->val[0], scratch->val[2]);
-
-	scratch->val[2]->num_used_digits = z2->num_used_digits + m2;
-	memcpy(&scratch->val[2]->digits[m2],z2->digits, sizeof(uint32_t)*z2->num_used_digits);
-	ffbi_sub(scratch->val[0], scratch->val[0], scratch->val[2]);
+	return 0;
+}
 
-	scratch->val[2]->num_used_digits = z0->num_used_digits + m2;
-	memcpy(&scratch->val[2]->digits[m2],z0->digits, sizeof(uint32_t)*z0->num_used_digits);
-	ffbi_sub(scratch->val[0], scratch->val[0], scratch->val[2]);
+//Pass 1 for retain_value if retaining the value is important. Passing 0
+//will result in memory copying and extra checks to see if target_num_digits
+//should be respected.
+int ffbi_reallocate_digits(ffbi_t* p, int target_num_digits, uint8_t retain_value)
+{
+	FFBI_RETURN_IF_VIEW(p, 1);
+	return ffbi_reallocate_digits_impl(p, target_num_digits, retain_value);
+}
 
-	ffbi_add(dest, scratch->val[0], z0);
-}*/
-/*
-void ffbi_mul_impl(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_scratch_t* scratch)
+//Attempt to reallocate memory used by p to hold specified number of bits.
+//If the specified number of bits is not enough to fit the current bigint value,
+//the reallocated memory will be just enough to fit the current value.
+void ffbi_reallocate(ffbi_t* p, uint32_t target_bits)
 {
-	ffbi_t* product = dest;
-	uint8_t destroy_product = 0;
-	uint32_t product_len = a->num_used_digits+b->num_used_digits;
-	if(dest == a || dest == b)
-	{
-		product = ffbi_create_reserved_digits(product_len);
-		destroy_product = 1;
-	}
-	if(product->num_allocated_digits < product_len)
-		ffbi_reallocate_digits(product, product_len);
-	uint8_t destroy_scratch = 0;
-	if(scratch == NULL)
-	{
-		scratch = ffbi_scratch_create();
-		destroy_scratch = 1;
-	}
-	ffbi_mul_karatsuba(product, a, b, scratch);
-	if(destroy_product)
-	{
-		ffbi_copy(dest, product);
-		ffbi_destroy(product);
-	}
-	if(destroy_scratch)
-		ffbi_scratch_destroy(scratch);
-}*/
+	int num_digits = target_bits/FFBI_BITS_PER_DIGIT;
+	if(target_bits%FFBI_BITS_PER_DIGIT > 0)
+		num_digits++;
+	ffbi_reallocate_digits(p, num_digits, 1);
+}
 
-#if FFBI_DIV_CACHE_ENABLED
-static void ffbi_get_quotient_digit_cache(int q_index, ffbi_t * q, ffbi_t* rem, ffbi_t* a, ffbi_t* b, int b_len, ffbi_t* product, uint32_t is_not_last_digit, ffbi_t* scratch)
+//cancel may be NULL. When it is set by another thread, the test gives up and reports p as not prime.
+static int ffbi_is_large_prime_impl(ffbi_t* p, int num_tests, ffbi_sieve_t* sieve, ffbi_workspace_t* ws, std::atomic<uint8_t>* cancel)
 {
-	uint32_t k;
-	int cmp = ffbi_cmp_cache(rem, b);
-	if(cmp == 0) //if r = b, then this digit of q is 1
+	if(num_tests < 1 || p == NULL)
 	{
-		q->cache[q_index] = 1;
-		rem->cache_num_used_digits = 1;
-		if(q_index > 0)
-			rem->cache[0] = a->cache[q_index-1]; //update remainder with next digit in dividend
-		else
-			rem->cache[0] = 0;
+		fflog_debug_print("invalid arguments\n");
+		return 0;
 	}
-	else if(cmp == -1) //if r < b, then this digit of q is 0
+	int ret = 1;
+
+	//reserve room for the temporaries of this test and of ffbi_mod_pow
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	uint32_t num_digits = p->num_used_digits+1;
+	ffbi_workspace_reserve(ws, FFBI_PRIME_TEST_NUM_VALS+FFBI_MOD_POW_NUM_VALS, (num_digits<<1)+1);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* temp[FFBI_PRIME_TEST_NUM_VALS];
+	for(int i=0;i<FFBI_PRIME_TEST_NUM_VALS;i++)
+		temp[i] = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* p_minus_1;
+
+	//if sieve was provided, see if p divides into any value in the sieve first
+	//uint32_t start_time = fftime_get_time_ms();
+	if(sieve != NULL && sieve->num_primorials > 0
+		&& ffbi_cmp(sieve->primes[sieve->num_primes-1], p) == -1)
 	{
-		q->cache[q_index] = 0;
-		if(q_index > 0)
+		//p is larger than every prime in the sieve, so any common factor with a primorial means p is composite
+		int i;
+		for(i=0;i<sieve->num_primorials;i++)
 		{
-			if(rem->cache_num_used_digits > 1 || rem->cache[0] > 0)
+			ffbi_t* primorial = sieve->primorials[i];
+			if(primorial->num_used_digits == 1)
 			{
-				rem->cache_num_used_digits++;
-				if(rem->cache_num_allocated_digits < rem->cache_num_used_digits)
-					ffbi_cache_prepare(rem, rem->cache_num_used_digits, 1);
-				for(k=rem->cache_num_used_digits-1;k>0;k--) //shift remainder digits to the left
-					rem->cache[k] = rem->cache[k-1];
+				temp[1]->num_used_digits = 1;
+				temp[1]->digits[0] = ffbi_mod_digit(p, primorial->digits[0]);
+				temp[1]->cache_valid = 0;
+			}
+			else
+			{
+				//divide by a copy since ffbi_div_impl builds a cache in the divisor and the sieve may be shared between threads
+				ffbi_copy(temp[0], primorial);
+				ffbi_div_impl(temp[2], p, temp[0], temp[1], temp[3], temp[4]);
+			}
+			ffbi_gcd(temp[2], temp[1], primorial, temp[3]);
+			if(temp[2]->num_used_digits > 1 || temp[2]->digits[0] != 1)
+			{
+				ret = 0;
+				goto finish;
 			}
-			rem->cache[0] = a->cache[q_index-1]; //update remainder with next digit in dividend
 		}
 	}
-	else //if r > b, divide
+	else if(sieve != NULL)
 	{
-		uint32_t r_len = rem->cache_num_used_digits;
-		//ffbi_cache_word_t leftmost_r;
-		ffbi_cache_word_t leftmost_b = 0;
-		if(r_len == 1)
-		{
-			q->cache[q_index] = rem->cache[0]/b->cache[0];
-			goto skip_q_set;
-		}
-		else if(r_len == 2)
-		{
-			q->cache[q_index] = (rem->cache[1]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + rem->cache[0];
-			if(b_len == 2)
-				leftmost_b = (b->cache[1]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[0];
-			else
-				leftmost_b = b->cache[0];
-		}
-		else if(r_len == 3)
-		{
-			ffbi_cache_word_t shift_amount_x_2 = FFBI_CACHE_DIV_BITS_PER_DIGIT*2;
-			q->cache[q_index] = (rem->cache[r_len-1]<< shift_amount_x_2) + (rem->cache[r_len-2]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + rem->cache[r_len-3];
-			if(r_len > (uint32_t)b_len)
-				leftmost_b = (b->cache[b_len-1]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-2];
-			else
-				leftmost_b = (b->cache[b_len-1]<< shift_amount_x_2) + (b->cache[b_len-2]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-3];
-		}
-		else
-		{
-			ffbi_cache_word_t shift_amount_x_2 = FFBI_CACHE_DIV_BITS_PER_DIGIT*2;
-			ffbi_cache_word_t shift_amount_x_3 = FFBI_CACHE_DIV_BITS_PER_DIGIT*3;
-			q->cache[q_index] = (rem->cache[r_len-1]<<shift_amount_x_3) + (rem->cache[r_len-2]<<shift_amount_x_2) + (rem->cache[r_len-3]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + rem->cache[r_len-4];
-			if(r_len > (uint32_t)b_len)
-				leftmost_b = (b->cache[b_len-1]<<shift_amount_x_2) + (b->cache[b_len-2]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-3];
-			else
-				leftmost_b = (b->cache[b_len-1]<<shift_amount_x_3) + (b->cache[b_len-2]<<shift_amount_x_2) + (b->cache[b_len-3]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-4];
-		}
-		//leftmost_r = q->cache[q_index];
-		q->cache[q_index] /= leftmost_b;
-	skip_q_set:
-		product->cache_num_used_digits = 1;
-		product->cache[0] = q->cache[q_index];
-		ffbi_div_cache_mul(scratch, product, b);
-		uint32_t q_miss_count = 0;
-		while(ffbi_cmp_cache(rem, scratch) == -1)
+		uint32_t i;
+		for(i=0;i<(uint32_t)sieve->num_primes;i++)
 		{
-			q_miss_count++;
-			//fflog_debug_print("product more than remainder. q_miss_count=%u\n", q_miss_count);
-			if(product->cache[0] == 0)
+			ffbi_t* divisor = sieve->primes[i];
+			if(ffbi_cmp(divisor, p) == 1)
 				break;
-			product->cache[0]--;
-			q->cache[q_index]--;
-			ffbi_div_cache_mul(scratch, product, b);
-		}
-		ffbi_sub_cache(product, rem, scratch); //use product to temporarily hold the new remainder
-		//replace the old remainder with the new remainder
-		if(ffbi_cmp_cache(product, b) == 1)
-		{
-			fflog_debug_print("r greater than b.\n");
+			if(divisor->num_used_digits == 1)
+			{
+				if(ffbi_mod_digit(p, divisor->digits[0]) == 0)
+				{
+					ret = 0;
+					goto finish;
+				}
+				continue;
+			}
+			ffbi_copy(temp[0], divisor);
+			ffbi_div_impl(temp[2], p, temp[0], temp[1], temp[3], temp[4]);
+			if(temp[1]->num_used_digits == 1 && temp[1]->digits[0] == 0)
+			{
+				ret = 0;
+				//fflog_print("sieve detected composite.\n");
+				goto finish;
+			}
 		}
-		if(product->cache_num_used_digits > 1 || product->cache[0] > 0)
+	}
+	//fflog_print("finished sieve test in %u ms\n", fftime_get_time_ms() - start_time);
+
+	//run the Fermat primality test
+	p_minus_1 = temp[0];
+	temp[1]->num_used_digits = 1;
+	temp[1]->digits[0] = 1;
+	ffbi_sub(p_minus_1, p, temp[1]);
+	temp[2]->num_used_digits = 1;
+	temp[2]->digits[0] = 2;
+	ffbi_sub(temp[1], p_minus_1, temp[2]);
+	int k;
+	for(k=0;k<num_tests;k++)
+	{
+		if(cancel && cancel->load(std::memory_order_relaxed))
 		{
-			rem->cache_num_used_digits = product->cache_num_used_digits+is_not_last_digit;
-			if(rem->cache_num_allocated_digits < rem->cache_num_used_digits)
-				ffbi_cache_prepare(rem, rem->cache_num_used_digits, 0);
-			rem->cache[0] = 0;
-			for(k=0;k<product->cache_num_used_digits;k++)
-				rem->cache[k+is_not_last_digit] = product->cache[k];
-			rem->cache[0] += a->cache[q_index-is_not_last_digit]*is_not_last_digit; //update remainder with next digit in dividend
+			ret = 0;
+			break;
 		}
-		else
+		ffbi_t* a = temp[2];
+		ffbi_t* dest = temp[3];
+		ffbi_random_with_limit(a, temp[1]);
+		ffbi_add_u(a, a, 2);
+		//fflog_print("line=%d\n", __LINE__);
+		//uint32_t start_time = fftime_get_time_ms();
+		ffbi_mod_pow(dest, a, p_minus_1, p, ws);
+		//fflog_print("mod_pow finished in %u ms. k=%d\n", fftime_get_time_ms() - start_time, k);
+		//fflog_print("line=%d\n", __LINE__);
+		if(dest->num_used_digits > 1 || dest->digits[0] != 1)
 		{
-			rem->cache_num_used_digits = product->cache_num_used_digits;
-			rem->cache[0] = a->cache[q_index-is_not_last_digit]*is_not_last_digit;
+			ret = 0;
+			break;
 		}
 	}
+finish:
+	ffbi_workspace_pop(ws, frame);
+	return ret;
 }
-#endif
 
-static void ffbi_get_quotient_digit(int q_index, ffbi_t * q, ffbi_t* r, ffbi_t* a, ffbi_t* b, int b_len, ffbi_t* product, uint32_t is_not_last_digit, ffbi_t* scratch)
+//Uses Fermat primality test to determine if p is prime. Increase
+//num_tests for higher chance p is actually prime. Probability of p being wrongly
+//detected as prime is 2^(-num_tests). If p is less than 16^8, it is not considered
+//large enough and will return false. A sieve may be optionally provided to quickly
+//weed out composites before the Fermat primality test. Pass NULL for sieve to skip
+//the sieve test. 1 is returned if p is prime and 0 is returned if otherwise.
+//Temporaries come from ws, or from the thread's default workspace if ws is NULL.
+int ffbi_is_large_prime(ffbi_t* p, int num_tests, ffbi_sieve_t* sieve, ffbi_workspace_t* ws)
 {
-	uint32_t k;
-	int cmp = ffbi_cmp(r, b);
-	r->cache_valid = 0;
-	q->cache_valid = 0;
-	if(cmp == 0) //if r = b, then this digit of q is 1
-	{
-		q->digits[q_index] = 1;
-		r->num_used_digits = 1;
-		if(q_index > 0)
-			r->digits[0] = a->digits[q_index-1]; //update remainder with next digit in dividend
-		else
-			r->digits[0] = 0;
-	}
-	else if(cmp == -1) //if r < b, then this digit of q is 0
+	return ffbi_is_large_prime_impl(p, num_tests, sieve, ws, NULL);
+}
+
+typedef struct FFBI_PRIME_SEARCH
+{
+	uint32_t bits;
+	uint32_t num_tests;
+	ffbi_sieve_t* sieve;
+	std::atomic<uint8_t> found;
+	pthread_mutex_t mutex;
+	ffbi_t* result;
+} ffbi_prime_search_t;
+
+typedef struct FFBI_PRIME_SEARCH_WORKER
+{
+	ffbi_prime_search_t* search;
+	pthread_t thread;
+} ffbi_prime_search_worker_t;
+
+static void* ffbi_prime_search_thread(void* param)
+{
+	ffbi_prime_search_worker_t* worker = (ffbi_prime_search_worker_t*)param;
+	ffbi_prime_search_t* search = worker->search;
+	ffbi_t* candidate = ffbi_create_reserved_bits(search->bits);
+	while(!search->found.load(std::memory_order_relaxed))
 	{
-		q->digits[q_index] = 0;
-		if(q_index > 0)
+		ffbi_random(candidate, search->bits);
+		candidate->digits[0] |= 1;
+		if(ffbi_is_large_prime_impl(candidate, (int)search->num_tests, search->sieve, NULL, &search->found))
 		{
-			if(r->num_used_digits > 1 || r->digits[0] > 0)
+			pthread_mutex_lock(&search->mutex);
+			if(search->result == NULL)
 			{
-				r->num_used_digits++;
-				if(r->num_allocated_digits<r->num_used_digits)
-					ffbi_reallocate_digits(r, r->num_used_digits, 1);
-				for(k=r->num_used_digits-1;k>0;k--) //shift remainder digits to the left
-					r->digits[k] = r->digits[k-1];
+				search->result = candidate;
+				candidate = NULL;
+				search->found.store(1);
 			}
-			r->digits[0] = a->digits[q_index-1]; //update remainder with next digit in dividend
+			pthread_mutex_unlock(&search->mutex);
+			break;
 		}
 	}
-	else //if r > b, divide
+	if(candidate)
+		ffbi_destroy(candidate);
+	return NULL;
+}
+
+//Same as ffbi_create_random_large_prime, but candidates are generated and tested on num_threads
+//worker threads, each with its own workspace and its thread's random stream. The first prime found cancels the
+//remaining workers. The sieve is only read, so it may be shared with other concurrent searches.
+ffbi_t* ffbi_create_random_large_prime_parallel(uint32_t bits, uint32_t num_tests, ffbi_sieve_t* sieve, uint32_t num_threads)
+{
+	if(num_threads <= 1)
+		return ffbi_create_random_large_prime(bits, num_tests, sieve);
+	if((bits+FFBI_BITS_PER_DIGIT-1)/FFBI_BITS_PER_DIGIT < FFBI_MIN_ALLOC_DIGITS)
 	{
-		uint32_t r_len = r->num_used_digits;
-		ffbi_word_t leftmost_b = 0;
-		if(r_len == 1)
+		fflog_debug_print("bits arg must be at least %d.\n", FFBI_BITS_PER_DIGIT*FFBI_MIN_ALLOC_DIGITS);
+		return NULL;
+	}
+	ffbi_prime_search_t* search = ffmem_alloc(ffbi_prime_search_t);
+	search->bits = bits;
+	search->num_tests = num_tests;
+	search->sieve = sieve;
+	search->found.store(0);
+	pthread_mutex_init(&search->mutex, NULL);
+	search->result = NULL;
+	ffbi_prime_search_worker_t* workers = ffmem_alloc_arr(ffbi_prime_search_worker_t, num_threads);
+	uint32_t num_started = 0;
+	for(uint32_t i=0;i<num_threads;i++)
+	{
+		workers[i].search = search;
+		if(pthread_create(&workers[i].thread, NULL, ffbi_prime_search_thread, &workers[i]) != 0)
+			break;
+		num_started++;
+	}
+	if(num_started == 0)
+		search->result = ffbi_create_random_large_prime(bits, num_tests, sieve);
+	for(uint32_t i=0;i<num_started;i++)
+		pthread_join(workers[i].thread, NULL);
+	ffbi_t* ret = search->result;
+	pthread_mutex_destroy(&search->mutex);
+	ffmem_free_arr(workers);
+	ffmem_free(search);
+	return ret;
+}
+
+typedef struct FFBI_SEEDED_PRIME_WORKER ffbi_seeded_prime_worker_t;
+
+typedef struct FFBI_SEEDED_PRIME_SEARCH
+{
+	uint32_t bits;
+	uint32_t num_tests;
+	ffbi_sieve_t* sieve;
+	const uint8_t* seed;
+	int seed_len;
+	std::atomic<uint64_t> next_index;
+	uint64_t best_index;
+	pthread_mutex_t mutex;
+	ffbi_t* result;
+	ffbi_seeded_prime_worker_t* workers;
+	uint32_t num_workers;
+} ffbi_seeded_prime_search_t;
+
+struct FFBI_SEEDED_PRIME_WORKER
+{
+	ffbi_seeded_prime_search_t* search;
+	uint64_t index;
+	std::atomic<uint8_t> cancel;
+	pthread_t thread;
+};
+
+//Tests candidates in increasing index order until every index below the best prime found so far is taken.
+static void* ffbi_seeded_prime_search_thread(void* param)
+{
+	ffbi_seeded_prime_worker_t* worker = (ffbi_seeded_prime_worker_t*)param;
+	ffbi_seeded_prime_search_t* search = worker->search;
+	ffrand_t* stream = ffrand_create_seeded(search->seed, search->seed_len);
+	ffbi_ctx_t* ctx = ffbi_ctx_get_thread();
+	ffrand_t* prev_stream = ffbi_ctx_set_rand(ctx, stream);
+	ffbi_t* candidate = ffbi_create_reserved_bits(search->bits);
+	while(1)
+	{
+		uint64_t k = search->next_index.fetch_add(1);
+		pthread_mutex_lock(&search->mutex);
+		if(k >= search->best_index)
+		{
+			pthread_mutex_unlock(&search->mutex);
+			break;
+		}
+		worker->index = k;
+		worker->cancel.store(0);
+		pthread_mutex_unlock(&search->mutex);
+
+		//candidate k and its primality test bases come only from stream k of the seed
+		ffrand_reseed(stream, search->seed, search->seed_len, k);
+		ffbi_random(candidate, search->bits);
+		candidate->digits[0] |= 1;
+		if(!ffbi_is_large_prime_impl(candidate, (int)search->num_tests, search->sieve, NULL, &worker->cancel))
+			continue;
+		pthread_mutex_lock(&search->mutex);
+		if(k < search->best_index)
+		{
+			search->best_index = k;
+			ffbi_t* prev_result = search->result;
+			search->result = candidate;
+			candidate = prev_result ? prev_result : ffbi_create_reserved_bits(search->bits);
+			//workers on later candidates can stop, since a lower index prime always wins
+			for(uint32_t i=0;i<search->num_workers;i++)
+			{
+				if(search->workers[i].index > k)
+					search->workers[i].cancel.store(1);
+			}
+		}
+		pthread_mutex_unlock(&search->mutex);
+	}
+	ffbi_destroy(candidate);
+	ffbi_ctx_set_rand(ctx, prev_stream);
+	ffrand_destroy(stream);
+	return NULL;
+}
+
+//Same as ffbi_create_random_large_prime_parallel, but all randomness is derived from seed through
+//SHAKE256. Candidate k is built from its own stream of the seed and the prime with the lowest k
+//is returned, so the result is identical across runs and for any num_threads.
+ffbi_t* ffbi_create_seeded_large_prime(uint32_t bits, uint32_t num_tests, ffbi_sieve_t* sieve, const uint8_t* seed, int seed_len, uint32_t num_threads)
+{
+	if(seed == NULL || seed_len < 1)
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return NULL;
+	}
+	if((bits+FFBI_BITS_PER_DIGIT-1)/FFBI_BITS_PER_DIGIT < FFBI_MIN_ALLOC_DIGITS)
+	{
+		fflog_debug_print("bits arg must be at least %d.\n", FFBI_BITS_PER_DIGIT*FFBI_MIN_ALLOC_DIGITS);
+		return NULL;
+	}
+	if(num_threads < 1)
+		num_threads = 1;
+	ffbi_seeded_prime_search_t* search = ffmem_alloc(ffbi_seeded_prime_search_t);
+	search->bits = bits;
+	search->num_tests = num_tests;
+	search->sieve = sieve;
+	search->seed = seed;
+	search->seed_len = seed_len;
+	search->next_index.store(0);
+	search->best_index = UINT64_MAX;
+	pthread_mutex_init(&search->mutex, NULL);
+	search->result = NULL;
+	search->workers = ffmem_alloc_arr(ffbi_seeded_prime_worker_t, num_threads);
+	search->num_workers = num_threads;
+	for(uint32_t i=0;i<num_threads;i++)
+	{
+		search->workers[i].search = search;
+		search->workers[i].index = 0;
+		search->workers[i].cancel.store(0);
+	}
+	//the calling thread works as the first worker
+	uint32_t num_started = 1;
+	for(;num_started<num_threads;num_started++)
+	{
+		if(pthread_create(&search->workers[num_started].thread, NULL, ffbi_seeded_prime_search_thread, &search->workers[num_started]) != 0)
+			break;
+	}
+	ffbi_seeded_prime_search_thread(&search->workers[0]);
+	for(uint32_t i=1;i<num_started;i++)
+		pthread_join(search->workers[i].thread, NULL);
+	ffbi_t* ret = search->result;
+	pthread_mutex_destroy(&search->mutex);
+	ffmem_free_arr(search->workers);
+	ffmem_free(search);
+	return ret;
+}
+
+uint32_t ffbi_get_significant_bits(ffbi_t* p)
+{
+	return (p->num_used_digits-1)*FFBI_BITS_PER_DIGIT + (uint32_t)ffbi_significant_bits(p->digits[p->num_used_digits-1]);
+}
+
+//Returns the size of the buffer necessary to hold the serialized bigint p in bytes.
+int ffbi_get_serialized_size(ffbi_t* p)
+{
+	uint32_t total_bits = ffbi_get_significant_bits(p);
+	return (int)(total_bits/8 + (total_bits%8 > 0));
+}
+
+int ffbi_serialize_v2(ffbi_t* p, uint8_t* buffer, int size_bytes, uint32_t total_bits)
+{
+	int num_write_bytes = (int)((total_bits + 7)/8);
+	if(size_bytes < num_write_bytes)
+		return -1;
+	if(ffbi_digits_to_bytes<false>(p->digits, p->num_used_digits, buffer, num_write_bytes))
+		return 0;
+	return num_write_bytes;
+}
+
+int ffbi_serialize(ffbi_t* p, uint8_t* buffer, int size_bytes)
+{
+	uint32_t total_bits = ffbi_get_significant_bits(p);
+	return ffbi_serialize_v2(p, buffer, size_bytes, total_bits);
+}
+
+void ffbi_print_words(ffbi_t* p)
+{
+	for(unsigned i=0;i<p->num_used_digits;i++)
+		fflog_print("[%llu]", (uint64_t)p->digits[i]);
+	fflog_print("\n");
+}
+
+void ffbi_deserialize(ffbi_t* p, uint8_t* buffer, int size_bytes)
+{
+	FFBI_RETURN_IF_VIEW(p);
+	ffbi_set_bytes<false>(p, buffer, size_bytes);
+}
+
+int ffbi_export_be(ffbi_t* p, uint8_t* buffer, int size_bytes)
+{
+	if(size_bytes < 0 || ffbi_digits_to_bytes<true>(p->digits, p->num_used_digits, buffer, size_bytes))
+	{
+		fflog_debug_print("p doesn't fit in %d bytes.\n", size_bytes);
+		return 1;
+	}
+	return 0;
+}
+
+void ffbi_import_be(ffbi_t* p, const uint8_t* buffer, int size_bytes)
+{
+	FFBI_RETURN_IF_VIEW(p);
+	ffbi_set_bytes<true>(p, buffer, size_bytes);
+}
+
+//Decimal strings are converted a word sized chunk of decimal digits at a time. A chunk value fits in a
+//half word, so a chunk times a digit plus a carry, or a remainder shifted up by a digit, fits in a word.
+#if FFBI_WORD_SIZE == 128
+#define FFBI_DEC_CHUNK_DIGITS 19
+static constexpr ffbi_word_t _dec_chunk = 10000000000000000000ULL;
+#else
+#define FFBI_DEC_CHUNK_DIGITS 9
+static constexpr ffbi_word_t _dec_chunk = 1000000000ULL;
+#endif
+
+static const char _hex_chars[] = "0123456789abcdef";
+
+//p = p / d, returning p % d. d has to fit in half a word.
+static ffbi_word_t ffbi_div_chunk(ffbi_t* p, ffbi_word_t d)
+{
+	ffbi_word_t r = 0;
+	for(int i=(int)p->num_used_digits-1;i>=0;i--)
+	{
+		ffbi_word_t v = (r << FFBI_BITS_PER_DIGIT) | p->digits[i];
+		ffbi_word_t q = v / d;
+		p->digits[i] = q;
+		r = v - q*d;
+	}
+	p->num_used_digits = ffbi_trim_len(p->digits, p->num_used_digits);
+	p->cache_valid = 0;
+	return r;
+}
+
+//p = p * m + a, with m and a at most _dec_chunk. p must have room for two more digits.
+static void ffbi_mul_add_chunk(ffbi_t* p, ffbi_word_t m, ffbi_word_t a)
+{
+	ffbi_word_t carry = a;
+	uint32_t i;
+	for(i=0;i<p->num_used_digits;i++)
+	{
+		ffbi_word_t v = p->digits[i]*m + carry;
+		p->digits[i] = v & _digit_max;
+		carry = v >> FFBI_BITS_PER_DIGIT;
+	}
+	for(;carry != 0;i++)
+	{
+		p->digits[i] = carry & _digit_max;
+		carry >>= FFBI_BITS_PER_DIGIT;
+	}
+	p->num_used_digits = ffbi_trim_len(p->digits, i);
+	p->cache_valid = 0;
+}
+
+//Writes the decimal digits of x into out as exactly width characters padded with leading zeros.
+//x has to be less than 10^width and is destroyed.
+static void ffbi_to_dec(ffbi_t* x, char* out, uint32_t width)
+{
+	while(width > 0)
+	{
+		uint64_t chunk = ffbi_is_zero(x) ? 0 : (uint64_t)ffbi_div_chunk(x, _dec_chunk);
+		for(int i=0;i<FFBI_DEC_CHUNK_DIGITS && width > 0;i++)
+		{
+			out[--width] = (char)('0' + chunk%10);
+			chunk /= 10;
+		}
+	}
+}
+
+static int ffbi_to_hex(ffbi_t* p, char* buffer, uint32_t num_chars)
+{
+	for(uint32_t i=0;i<num_chars;i++)
+	{
+		uint32_t bit = (num_chars - 1 - i)*4;
+		uint32_t d = bit/FFBI_BITS_PER_DIGIT;
+		uint32_t shift = bit%FFBI_BITS_PER_DIGIT;
+		ffbi_word_t v = p->digits[d] >> shift;
+		if(shift + 4 > FFBI_BITS_PER_DIGIT && d + 1 < p->num_used_digits)
+			v |= p->digits[d+1] << (FFBI_BITS_PER_DIGIT - shift);
+		buffer[i] = _hex_chars[(uint32_t)v & 15];
+	}
+	buffer[num_chars] = 0;
+	return (int)num_chars;
+}
+
+int ffbi_get_string_size(ffbi_t* p, int base)
+{
+	uint32_t bits = ffbi_get_significant_bits(p);
+	if(base == 16)
+		return bits > 0 ? (int)((bits + 3)/4 + 1) : 2;
+	if(base == 10) //1234/4096 is slightly more than log10(2)
+		return (int)(((uint64_t)bits*1234 >> 12) + 2);
+	fflog_debug_print("base %d isn't supported.\n", base);
+	return 0;
+}
+
+int ffbi_to_string(ffbi_t* p, char* buffer, int size_bytes, int base)
+{
+	int size = ffbi_get_string_size(p, base);
+	if(size == 0)
+		return 0;
+	if(size_bytes < size)
+		return -1;
+	if(base == 16)
+		return ffbi_to_hex(p, buffer, (uint32_t)size - 1);
+	uint32_t width = (uint32_t)size - 1;
+	ffbi_workspace_t* ws = ffbi_workspace_get_thread();
+	ffbi_workspace_reserve(ws, 1, p->num_used_digits);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* x = ffbi_workspace_get(ws, p->num_used_digits);
+	ffbi_copy(x, p);
+	ffbi_to_dec(x, buffer, width);
+	ffbi_workspace_pop(ws, frame);
+	uint32_t start = 0;
+	while(start + 1 < width && buffer[start] == '0')
+		start++;
+	memmove(buffer, buffer + start, width - start);
+	buffer[width - start] = 0;
+	return (int)(width - start);
+}
+
+int ffbi_from_string(ffbi_t* p, const char* str, int len, int base)
+{
+	FFBI_RETURN_IF_VIEW(p, 1);
+	if(len < 0)
+		len = (int)strlen(str);
+	if(len == 0 || (base != 10 && base != 16))
+	{
+		fflog_debug_print("can't parse %d characters in base %d.\n", len, base);
+		return 1;
+	}
+	for(int i=0;i<len;i++)
+	{
+		char c = str[i];
+		if(!(c >= '0' && c <= '9') && !(base == 16 && ((c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))))
+		{
+			fflog_debug_print("invalid character '%c' for base %d.\n", c, base);
+			return 1;
+		}
+	}
+	//3402/1024 is slightly more than log2(10)
+	uint32_t bits = base == 16 ? (uint32_t)len*4 : (uint32_t)(((uint64_t)len*3402 >> 10) + 1);
+	uint32_t num_digits = bits/FFBI_BITS_PER_DIGIT + 3;
+	if(p->num_allocated_digits < num_digits && ffbi_reallocate_digits(p, num_digits, 0))
+		return 1;
+	if(base == 16)
+	{
+		memset(p->digits, 0, num_digits*sizeof(ffbi_word_t));
+		for(int i=0;i<len;i++)
+		{
+			char c = str[len - 1 - i];
+			ffbi_word_t v = c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+			uint32_t bit = (uint32_t)i*4;
+			uint32_t d = bit/FFBI_BITS_PER_DIGIT;
+			uint32_t shift = bit%FFBI_BITS_PER_DIGIT;
+			p->digits[d] |= (v << shift) & _digit_max;
+			if(shift + 4 > FFBI_BITS_PER_DIGIT)
+				p->digits[d+1] |= v >> (FFBI_BITS_PER_DIGIT - shift);
+		}
+		p->num_used_digits = ffbi_trim_len(p->digits, num_digits);
+		p->cache_valid = 0;
+		return 0;
+	}
+	p->num_used_digits = 1;
+	p->digits[0] = 0;
+	//the first chunk takes whatever is left over so the rest are whole
+	int chunk_len = len%FFBI_DEC_CHUNK_DIGITS;
+	if(chunk_len == 0)
+		chunk_len = FFBI_DEC_CHUNK_DIGITS;
+	ffbi_word_t m = 1;
+	for(int i=0;i<chunk_len;i++)
+		m *= 10;
+	for(int i=0;i<len;i+=chunk_len, chunk_len=FFBI_DEC_CHUNK_DIGITS, m=_dec_chunk)
+	{
+		uint64_t chunk = 0;
+		for(int j=0;j<chunk_len;j++)
+			chunk = chunk*10 + (uint64_t)(str[i+j] - '0');
+		ffbi_mul_add_chunk(p, m, chunk);
+	}
+	return 0;
+}
+
+//Prints the base 10 string representation of p into stdout appended with newline.
+void ffbi_print(ffbi_t* p)
+{
+	int size = ffbi_get_string_size(p, 10);
+	char* str = ffmem_alloc_arr(char, size);
+	ffbi_to_string(p, str, size, 10);
+	fflog_print("%s\n", str);
+	ffmem_free_arr(str);
+}
+
+static int ffbi_cmp_cache(ffbi_t* a, ffbi_t* b)
+{
+	if(a->cache_num_used_digits > b->cache_num_used_digits)
+		return 1;
+	if(a->cache_num_used_digits < b->cache_num_used_digits)
+		return -1;
+	for(int k=(int)a->cache_num_used_digits-1;k>=0;k--)
+	{
+		if(a->cache[k] > b->cache[k])
+			return 1;
+		if(a->cache[k] < b->cache[k])
+			return -1;
+	}
+	return 0;
+}
+
+//[compare] returns 0 if a == b, 1 if a > b, or -1 if a < b.
+int ffbi_cmp(ffbi_t* a, ffbi_t* b)
+{
+	//if a has more digits than b, it can be concluded that a is bigger
+	if(a->num_used_digits > b->num_used_digits)
+		return 1;
+	//if b has more digits than a, it can be concluded that b is bigger
+	if(a->num_used_digits < b->num_used_digits)
+		return -1;
+	//if code reaches here, a and b take up the same number of digits
+	//check digit values starting from most significant
+	for(int k=(int)a->num_used_digits-1;k>=0;k--)
+	{
+		if(a->digits[k] > b->digits[k])
+			return 1;
+		if(a->digits[k] < b->digits[k])
+			return -1;
+	}
+	return 0;
+}
+
+//[addition] dest = a + b
+void ffbi_add(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	ffbi_t* larger;
+	uint32_t max_used_digits;
+	uint32_t min_used_digits;
+	if(a->num_used_digits >= b->num_used_digits)
+	{
+		larger = a;
+		min_used_digits = b->num_used_digits;
+	}
+	else
+	{
+		larger = b;
+		min_used_digits = a->num_used_digits;
+	}
+	max_used_digits = larger->num_used_digits;
+	if(dest->num_allocated_digits < max_used_digits) //first make sure dest is big enough
+	{
+		if(ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), dest == a || dest == b))
+			return;
+	}
+
+	//add the digits
+	uint32_t k;
+	dest->digits[0] = a->digits[0] + b->digits[0];
+	for(k=1;k<min_used_digits;k++)
+	{
+		dest->digits[k] = a->digits[k] + b->digits[k] + (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
+		dest->digits[k-1] &= _digit_max; //take carry out of previous digit sum
+	}
+	//propagate carry to the rest of the digits
+	for(;k<max_used_digits;k++)
+	{
+		dest->digits[k] = larger->digits[k] + (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
+		dest->digits[k-1] &= _digit_max; //take carry out of previous digit sum
+	}
+	//if last digit still has a carry, dest needs one more digit to hold it
+	k--;
+	if(dest->digits[k] >> FFBI_BITS_PER_DIGIT != 0)
+	{
+		max_used_digits++;
+		if(dest->num_allocated_digits < max_used_digits && ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), 1))
+			return;
+		dest->digits[k] &= _digit_max; //take carry out of previous digit sum
+		k++;
+		dest->digits[k] = 1; //newly appended digit now holds the carry
+	}
+	dest->num_used_digits = max_used_digits;
+	dest->cache_valid = 0;
+}
+
+void ffbi_add_u(ffbi_t* dest, ffbi_t* a, uint32_t b)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	if(dest != a)
+	{
+		if(dest->num_allocated_digits < a->num_used_digits && ffbi_reallocate_digits(dest, a->num_used_digits + 2, 0))
+			return;
+		//the carry may run past the two lowest digits
+		memcpy(dest->digits, a->digits, a->num_used_digits*sizeof(ffbi_word_t));
+		dest->num_used_digits = a->num_used_digits;
+	}
+	dest->digits[0] = a->digits[0] + (b&_digit_max);
+	if(a->num_used_digits == 1)
+	{
+		dest->digits[1] = dest->digits[0]>>FFBI_BITS_PER_DIGIT;
+		dest->num_used_digits += dest->digits[1];
+	}
+	else
+		dest->digits[1] = a->digits[1] + (dest->digits[0]>>FFBI_BITS_PER_DIGIT);
+	dest->digits[0] &= _digit_max;
+#if FFBI_BITS_PER_DIGIT < 32
+	uint32_t hi = b>>FFBI_BITS_PER_DIGIT;
+	if(hi)
+	{
+		dest->digits[1] = a->digits[1] + hi;
+		if(dest->num_used_digits == 1)
+			dest->num_used_digits++;
+	}
+#endif
+	int i = 1;
+	uint32_t carry = dest->digits[i]>>FFBI_BITS_PER_DIGIT;
+	while(carry>0)
+	{
+		dest->digits[i] &= _digit_max; //take carry out of the digit
+		i++;
+		if(i+1 > (int)dest->num_used_digits)
+		{
+			if(dest->num_allocated_digits < (uint32_t)i+1 && ffbi_reallocate_digits(dest, i + 3, 1))
+				return;
+			dest->num_used_digits = i+1;
+			dest->digits[i] = 0;
+		}
+		dest->digits[i] += carry;
+		carry = dest->digits[i]>>FFBI_BITS_PER_DIGIT;
+	}
+	dest->cache_valid = 0;
+}
+
+#if FFBI_DIV_CACHE_ENABLED
+//a and b's cache is assumed to be already built. dest must not point to a or b.
+static void ffbi_sub_cache(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	//dest should have enough allocated digits to fit the larger of a and b
+	uint32_t a_used_digits = a->cache_num_used_digits;
+	uint32_t b_used_digits = b->cache_num_used_digits;
+	uint32_t max_used_digits;
+	uint32_t min_used_digits;
+	if(b_used_digits > a_used_digits)
+	{
+		max_used_digits = b_used_digits;
+		min_used_digits = a_used_digits;
+	}
+	else
+	{
+		max_used_digits = a_used_digits;
+		min_used_digits = b_used_digits;
+	}
+	if(dest->cache_num_allocated_digits < max_used_digits)
+		ffbi_cache_prepare(dest, (int)max_used_digits, 0);
+
+	//subtract digits of a and b
+	uint32_t k;
+	dest->cache[0] = a->cache[0] + _cache_div_digit_max_plus_1 - b->cache[0];
+	for(k=1;k<min_used_digits;k++)
+	{
+		ffbi_cache_word_t carry = 1 - (dest->cache[k-1] >> dest->cache_bits_per_digit);
+		dest->cache[k-1] &= _cache_div_digit_max; //clear previous carry
+		dest->cache[k] = a->cache[k] + _cache_div_digit_max_plus_1 - b->cache[k] - carry;
+	}
+	if(b_used_digits > a_used_digits) //then use value of 0 for any digit of a beyond this point
+	{
+		for(;k<max_used_digits;k++)
+		{
+			ffbi_cache_word_t carry = 1 - (dest->cache[k-1] >> dest->cache_bits_per_digit);
+			dest->cache[k-1] &= _cache_div_digit_max; //clear previous carry
+			dest->cache[k] = _cache_div_digit_max_plus_1 - b->cache[k] - carry;
+		}
+	}
+	else
+	{
+		for(;k<max_used_digits;k++) //continue propagating carry as normal since a has at least b number of digits
+		{
+			ffbi_cache_word_t carry = 1 - (dest->cache[k-1] >> dest->cache_bits_per_digit);
+			dest->cache[k-1] &= _cache_div_digit_max; //clear previous carry
+			dest->cache[k] = a->cache[k] + _cache_div_digit_max_plus_1 - carry;
+		}
+	}
+	k--;
+	dest->cache[k] &= _cache_div_digit_max; //clear previous carry
+
+	//see if dest can have less used digits than a, then assign number of used digits
+	for(;k>0;k--)
+	{
+		if(dest->cache[k] != 0)
+			break;
+	}
+	dest->cache_num_used_digits = k+1;
+}
+#endif
+
+//[subtraction] dest = a - b
+void ffbi_sub(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	//dest should have enough allocated digits to fit the larger of a and b
+	uint32_t a_used_digits = a->num_used_digits;
+	uint32_t b_used_digits = b->num_used_digits;
+	uint32_t max_used_digits;
+	uint32_t min_used_digits;
+	if(b_used_digits > a_used_digits)
+	{
+		max_used_digits = b_used_digits;
+		min_used_digits = a_used_digits;
+	}
+	else
+	{
+		max_used_digits = a_used_digits;
+		min_used_digits = b_used_digits;
+	}
+	if(dest->num_allocated_digits < max_used_digits)
+	{
+		if(ffbi_reallocate_digits(dest, (int)(max_used_digits*FFBI_REALLOC_GROWTH_FACTOR+1), dest == a))
+			return;
+	}
+
+	//subtract digits of a and b
+	uint32_t k;
+	dest->digits[0] = a->digits[0] + _digit_max_plus_1 - b->digits[0];
+	for(k=1;k<min_used_digits;k++)
+	{
+		ffbi_word_t carry = 1 - (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
+		dest->digits[k-1] &= _digit_max; //clear previous carry
+		dest->digits[k] = a->digits[k] + _digit_max_plus_1 - b->digits[k] - carry;
+	}
+	if(b_used_digits > a_used_digits) //then use value of 0 for any digit of a beyond this point
+	{
+		for(;k<max_used_digits;k++)
+		{
+			ffbi_word_t carry = 1 - (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
+			dest->digits[k-1] &= _digit_max; //clear previous carry
+			dest->digits[k] = _digit_max_plus_1 - b->digits[k] - carry;
+		}
+	}
+	else
+	{
+		for(;k<max_used_digits;k++) //continue propagating carry as normal since a has at least b number of digits
+		{
+			ffbi_word_t carry = 1 - (dest->digits[k-1] >> FFBI_BITS_PER_DIGIT);
+			dest->digits[k-1] &= _digit_max; //clear previous carry
+			dest->digits[k] = a->digits[k] + _digit_max_plus_1 - carry;
+		}
+	}
+	k--;
+	dest->digits[k] &= _digit_max; //clear previous carry
+
+	//see if dest can have less used digits than a, then assign number of used digits
+	for(;k>0;k--)
+	{
+		if(dest->digits[k] != 0)
+			break;
+	}
+	dest->num_used_digits = k+1;
+	dest->cache_valid = 0;
+}
+
+#if FFBI_MUL_CACHE_ENABLED
+static void ffbi_mul_cache(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	ffbi_cache_update(a, FFBI_CACHE_MUL_BITS_PER_DIGIT, _cache_mul_digit_max);
+	ffbi_cache_update(b, FFBI_CACHE_MUL_BITS_PER_DIGIT, _cache_mul_digit_max);
+	uint32_t product_len = a->cache_num_used_digits+b->cache_num_used_digits;
+	ffbi_cache_prepare(dest, product_len, 0);
+	dest->cache_num_used_digits = product_len;
+	dest->cache_bits_per_digit = FFBI_CACHE_MUL_BITS_PER_DIGIT;
+	memset(dest->cache, 0, product_len*sizeof(ffbi_cache_word_t));
+	uint32_t k, i;
+	for(k=0;k<a->cache_num_used_digits;k++)
+	{
+		for(i=0;i<b->cache_num_used_digits;i++)
+		{
+			uint32_t add_index = k+i;
+			dest->cache[add_index] += a->cache[k] * b->cache[i];
+			dest->cache[add_index+1] += dest->cache[add_index]>>FFBI_CACHE_MUL_BITS_PER_DIGIT;
+			dest->cache[add_index] &= _cache_mul_digit_max;
+			add_index++;
+			while((dest->cache[add_index]>>FFBI_CACHE_MUL_BITS_PER_DIGIT) != 0) //propagate carry as long as it exists
+			{
+				dest->cache[add_index] &= _cache_mul_digit_max;
+				add_index++;
+				dest->cache[add_index] += 1;
+				if(add_index >= product_len)
+					break;
+			}
+		}
+	}
+	//see if there are trailing 0-value digits that can be trimmed off of the product
+	if(dest->cache_num_used_digits > 1 && dest->cache[product_len-1] == 0)
+		dest->cache_num_used_digits--;
+
+	ffbi_cache_retrieve(dest);
+}
+#endif
+
+#if FFBI_DIV_CACHE_ENABLED
+static void ffbi_div_cache_mul(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	uint32_t product_len = a->cache_num_used_digits+b->cache_num_used_digits;
+	ffbi_cache_prepare(dest, product_len, 0);
+	dest->cache_num_used_digits = product_len;
+	dest->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
+	memset(dest->cache, 0, product_len*sizeof(ffbi_cache_word_t));
+	uint32_t k, i;
+	for(k=0;k<a->cache_num_used_digits;k++)
+	{
+		for(i=0;i<b->cache_num_used_digits;i++)
+		{
+			uint32_t add_index = k+i;
+			//ffbi_cache_word_t p = a->cache[k] * b->cache[i];
+			//dest->cache[add_index+1] += p>>FFBI_CACHE_DIV_BITS_PER_DIGIT;
+			//dest->cache[add_index] += p&_cache_div_digit_max;
+			dest->cache[add_index] += a->cache[k] * b->cache[i];
+			/*
+			add_index++;
+			while((dest->cache[add_index]>>FFBI_CACHE_DIV_BITS_PER_DIGIT) != 0) //propagate carry as long as it exists
+			{
+				dest->cache[add_index] &= _cache_div_digit_max;
+				add_index++;
+				dest->cache[add_index] += 1;
+				if(add_index >= product_len)
+					break;
+			}*/
+		}
+	}
+	for(i=0;i<product_len-1;i++)
+	{
+		dest->cache[i+1] += dest->cache[i]>>FFBI_CACHE_DIV_BITS_PER_DIGIT;
+		dest->cache[i] &= _cache_div_digit_max;
+	}
+	//see if there are trailing 0-value digits that can be trimmed off of the product
+	if(dest->cache_num_used_digits > 1 && dest->cache[product_len-1] == 0)
+		dest->cache_num_used_digits--;
+}
+#endif
+
+//product = a * b, where product has room for the digits of a and b combined. Both operands are walked in tiles of
+//FFBI_MUL_TILE_DIGITS, so a tile of a stays in cache while b and the product stream past it once.
+//Each product is split across two columns, which lets a column take up to 2^(FFBI_WORD_SIZE - FFBI_BITS_PER_DIGIT)
+//of them, so carries are only propagated once at the end. Mapped operands are given access hints as
+//they are walked, and tiles of a are dropped from memory once they are done.
+static void ffbi_mul_blocked(ffbi_t* product, ffbi_t* a, ffbi_t* b)
+{
+	uint32_t a_len = a->num_used_digits;
+	uint32_t b_len = b->num_used_digits;
+	uint32_t product_len = a_len + b_len;
+	memset(product->digits, 0, product_len*sizeof(ffbi_word_t));
+	ffbi_advise(b, 0, b_len, MADV_SEQUENTIAL);
+	ffbi_advise(product, 0, product_len, MADV_SEQUENTIAL);
+	for(uint32_t k0=0;k0<a_len;k0+=FFBI_MUL_TILE_DIGITS)
+	{
+		uint32_t k1 = k0 + FFBI_MUL_TILE_DIGITS < a_len ? k0 + FFBI_MUL_TILE_DIGITS : a_len;
+		ffbi_advise(a, k0, k1 - k0, MADV_WILLNEED);
+		for(uint32_t i0=0;i0<b_len;i0+=FFBI_MUL_TILE_DIGITS)
+		{
+			uint32_t i1 = i0 + FFBI_MUL_TILE_DIGITS < b_len ? i0 + FFBI_MUL_TILE_DIGITS : b_len;
+			for(uint32_t k=k0;k<k1;k++)
+			{
+				ffbi_word_t d = a->digits[k];
+				ffbi_word_t* column = product->digits + k;
+				for(uint32_t i=i0;i<i1;i++)
+				{
+					ffbi_word_t p = d * b->digits[i];
+					column[i] += p & _digit_max;
+					column[i+1] += p >> FFBI_BITS_PER_DIGIT;
+				}
+			}
+		}
+		if(a != b)
+			ffbi_advise(a, k0, k1 - k0, MADV_DONTNEED);
+	}
+	for(uint32_t i=0;i<product_len-1;i++)
+	{
+		product->digits[i+1] += product->digits[i] >> FFBI_BITS_PER_DIGIT;
+		product->digits[i] &= _digit_max;
+	}
+	product->num_used_digits = ffbi_trim_len(product->digits, product_len);
+	product->cache_valid = 0;
+}
+
+//[multiplication] dest = a * b
+void ffbi_mul(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	FFBI_STATS_COUNT(a == b ? FFBI_STATS_SQR : FFBI_STATS_MUL);
+	if(ffbi_is_zero(a) || ffbi_is_zero(b))
+	{
+		dest->num_used_digits = 1;
+		dest->digits[0] = 0;
+		dest->cache_valid = 0;
+		return;
+	}
+	ffbi_t* product;
+	uint32_t a_len = a->num_used_digits;
+	uint32_t b_len = b->num_used_digits;
+	uint32_t product_len =  a_len+b_len;
+	ffbi_workspace_t* ws = NULL;
+	uint32_t frame = 0;
+	if(dest != a && dest != b)
+	{
+		product = dest;
+		if(product->num_allocated_digits < product_len && ffbi_reallocate_digits(product, product_len+1, 0))
+			return;
+	}
+	else if(a->is_mapped || b->is_mapped || dest->is_mapped)
+	{
+		//a product too large for the heap goes to a mapped temporary as well
+		product = ffbi_create_mapped(NULL, product_len*FFBI_BITS_PER_DIGIT);
+		if(product == NULL)
+			return;
+	}
+	else
+	{
+		ws = ffbi_workspace_get_thread();
+		frame = ffbi_workspace_push(ws);
+		product = ffbi_workspace_get(ws, product_len+FFBI_MIN_ALLOC_DIGITS);
+	}
+	FFBI_STATS_CHARGE((uint64_t)a_len*b_len, (uint64_t)(a_len + b_len + product_len)*sizeof(ffbi_word_t));
+	uint32_t min_len = a_len < b_len ? a_len : b_len;
+	//column sums of 64 or more whole digit products overflow a word
+	if((((ffbi_word_t)min_len) << FFBI_BITS_PER_DIGIT) >= FFBI_ACC_MAX_TERMS - 1 || a->is_mapped || b->is_mapped || product->is_mapped)
+		ffbi_mul_blocked(product, a, b);
+	else
+#if FFBI_MUL_CACHE_ENABLED
+	if(a_len > _min_mul_cache_len || b_len > _min_mul_cache_len)
+		ffbi_mul_cache(product, a, b);
+	else
+#endif
+	{
+		product->num_used_digits = product_len;
+		//product->digits[product_len-1] = 0;
+		memset(product->digits, 0, product_len*sizeof(ffbi_word_t));
+		uint32_t k, i;
+		for(k=0;k<a_len;k++)
+		{
+			for(i=0;i<b_len;i++)
+			{
+				uint32_t add_index = k+i;
+				//ffbi_word_t p = a->digits[k] * b->digits[i];
+				//product->digits[add_index] += p&_digit_max;
+				//product->digits[add_index+1] += p>>FFBI_BITS_PER_DIGIT;
+				product->digits[add_index] += a->digits[k] * b->digits[i];
+				/*
+				add_index++;
+				while((product->digits[add_index]>>FFBI_BITS_PER_DIGIT) != 0) //propagate carry as long as it exists
+				{
+					product->digits[add_index] &= _digit_max;
+					add_index++;
+					product->digits[add_index] += 1;
+					if(add_index >= product_len)
+						break;
+				}*/
+			}
+		}
+		for(i=0;i<product_len-1;i++)
+		{
+			product->digits[i+1] += product->digits[i]>>FFBI_BITS_PER_DIGIT;
+			product->digits[i] &= _digit_max;
+		}
+		//see if there are trailing 0-value digits that can be trimmed off of the product
+		if(product->num_used_digits > 1 && product->digits[product_len-1] == 0)
+			product->num_used_digits--;
+		dest->cache_valid = 0;
+	}
+	if(product != dest) //then copy product to dest
+	{
+		FFBI_STATS_CHARGE(0, (uint64_t)product->num_used_digits*sizeof(ffbi_word_t));
+		ffbi_copy(dest, product);
+		if(ws)
+			ffbi_workspace_pop(ws, frame);
+		else
+			ffbi_destroy(product);
+	}
+}
+
+void ffbi_mul_add(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	if(ffbi_is_zero(a) || ffbi_is_zero(b))
+		return;
+	ffbi_workspace_t* ws = NULL;
+	uint32_t frame = 0;
+	if(dest == a || dest == b)
+	{
+		//a and b have to stay intact while dest is added into
+		ws = ffbi_workspace_get_thread();
+		frame = ffbi_workspace_push(ws);
+		ffbi_t* copy = ffbi_workspace_get(ws, dest->num_used_digits);
+		ffbi_copy(copy, dest);
+		if(a == dest)
+			a = copy;
+		if(b == dest)
+			b = copy;
+	}
+	uint32_t a_len = a->num_used_digits;
+	uint32_t b_len = b->num_used_digits;
+	ffbi_word_t min_len = a_len < b_len ? a_len : b_len;
+	uint32_t len = dest->num_used_digits > a_len + b_len ? dest->num_used_digits : a_len + b_len;
+	if(dest->num_allocated_digits < len + 1 && ffbi_reallocate_digits(dest, (int)((len+1)*FFBI_REALLOC_GROWTH_FACTOR), 1))
+	{
+		if(ws)
+			ffbi_workspace_pop(ws, frame);
+		return;
+	}
+	memset(dest->digits + dest->num_used_digits, 0, (len + 1 - dest->num_used_digits)*sizeof(ffbi_word_t));
+	uint32_t k, i;
+	//products go straight into the digits of dest, whose values leave room for one more term
+	if((min_len << FFBI_BITS_PER_DIGIT) < FFBI_ACC_MAX_TERMS - 1)
+	{
+		for(k=0;k<a_len;k++)
+		{
+			ffbi_word_t d = a->digits[k];
+			ffbi_word_t* column = dest->digits + k;
+			for(i=0;i<b_len;i++)
+				column[i] += d * b->digits[i];
+		}
+	}
+	else
+	{
+		for(k=0;k<a_len;k++)
+		{
+			ffbi_word_t d = a->digits[k];
+			ffbi_word_t* column = dest->digits + k;
+			for(i=0;i<b_len;i++)
+			{
+				ffbi_word_t p = d * b->digits[i];
+				column[i] += p & _digit_max;
+				column[i+1] += p >> FFBI_BITS_PER_DIGIT;
+			}
+		}
+	}
+	for(i=0;i<len;i++)
+	{
+		dest->digits[i+1] += dest->digits[i] >> FFBI_BITS_PER_DIGIT;
+		dest->digits[i] &= _digit_max;
+	}
+	dest->num_used_digits = ffbi_trim_len(dest->digits, len + 1);
+	dest->cache_valid = 0;
+	if(ws)
+		ffbi_workspace_pop(ws, frame);
+}
+
+/*
+static void ffbi_mul_karatsuba(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_scratch_t* scratch)
+{
+	if(a->num_used_digits == 1 || b->num_used_digits == 1)
+	{
+		ffbi_mul_long(dest, a, b);
+		return;
+	}
+	ffbi_scratch_prepare(scratch, FFBI_KARATSUBA_NUM_VALS, a->num_used_digits+b->num_used_digits);
+	if(scratch->num_children == 0)
+	{
+		scratch->num_children = 1;
+		scratch->child = ffbi_scratch_create();
+	}
+	uint32_t m = a->num_used_digits;
+	if(m < b->num_used_digits)
+		m = b->num_used_digits;
+	uint32_t m2 = m>>1;
+	ffbi_t* high_a = scratch->val[0];
+	ffbi_t* high_b = scratch->val[1];
+	ffbi_t* low_a = scratch->val[2];
+	ffbi_t* low_b = scratch->val[3];
+	ffbi_t* z0 = scratch->val[4];
+	ffbi_t* z1 = scratch->val[5];
+	ffbi_t* z2 = scratch->val[6];
+	uint8_t z2_is_zero = 0;
+	if(m2 >= a->num_used_digits) //then there's no high_a
+	{
+		z2->num_used_digits = 1;
+		z2->digits[0] = 0;
+		z2_is_zero = 1;
+		high_a->num_used_digits = 1;
+		high_a->digits[0] = 0;
+	}
+	else
+	{
+		high_a->num_used_digits = a->num_used_digits - m2;
+		memcpy(high_a->digits, &a->digits[m2], high_a->num_used_digits*sizeof(uint32_t));
+	}
+	if(m2 >= b->num_used_digits) //then there's no high_b
+	{
+		z2->num_used_digits = 1;
+		z2->digits[0] = 0;
+		z2_is_zero = 1;
+		high_b->num_used_digits = 1;
+		high_b->digits[0] = 0;
+	}
+	else
+	{
+		high_b->num_used_digits = b->num_used_digits - m2;
+		memcpy(high_b->digits, &b->digits[m2], high_b->num_used_digits*sizeof(uint32_t));
+	}
+	if(!z2_is_zero)
+		ffbi_mul_karatsuba(z2, high_a, high_b, scratch->child);
+	low_a->num_used_digits = m2;
+	if(low_a->num_used_digits > a->num_used_digits)
+		low_a->num_used_digits = a->num_used_digits;
+	memcpy(low_a->digits, a->digits, low_a->num_used_digits*sizeof(uint32_t));
+	low_b->num_used_digits = m2;
+	if(low_b->num_used_digits > b->num_used_digits)
+		low_b->num_used_digits = b->num_used_digits;
+	memcpy(low_b->digits, b->digits, low_b->num_used_digits*sizeof(uint32_t));
+	ffbi_mul_karatsuba(z0, low_a, low_b, scratch->child);
+	ffbi_add(low_a, low_a, high_a);
+	ffbi_add(low_b, low_b, high_b);
+	ffbi_mul_karatsuba(z1, low_a, low_b, scratch->child);
+	uint32_t m3 = m2<<1;
+	uint32_t temp = z2->num_used_digits + m3;
+	if(temp > scratch->val[0]->num_allocated_digits)
+		ffbi_reallocate_digits(scratch->val[0], temp);
+	scratch->val[0]->num_used_digits = temp;
+	memset(scratch->val[0]->digits, 0, sizeof(uint32_t)*m3);
+	memcpy(&scratch->val[0]->digits[m3], z2->digits, sizeof(uint32_t)*z2->num_used_digits);
+	uint32_t greatest = z1->num_used_digits;
+	if(z2->num_used_digits > greatest)
+		greatest = z2->num_used_digits;
+	if(z0->num_used_digits > greatest)
+		greatest = z0->num_used_digits;
+	temp = greatest + m2;
+	if(temp > scratch->val[2]->num_allocated_digits)
+		ffbi_reallocate_digits(scratch->val[2], temp);
+	memset(scratch->val[2]->digits, 0, sizeof(uint32_t)*m2);
+
+	scratch->val[2]->num_used_digits = z1->num_used_digits + m2;
+	memcpy(&scratch->val[2]->digits[m2],z1->digits, sizeof(uint32_t)*z1->num_used_digits);
+	ffbi_add(scratch->val[0], scratch->val[0], scratch->val[2]);
+
+	scratch->val[2]->num_used_digits = z2->num_used_digits + m2;
+	memcpy(&scratch->val[2]->digits[m2],z2->digits, sizeof(uint32_t)*z2->num_used_digits);
+	ffbi_sub(scratch->val[0], scratch->val[0], scratch->val[2]);
+
+	scratch->val[2]->num_used_digits = z0->num_used_digits + m2;
+	memcpy(&scratch->val[2]->digits[m2],z0->digits, sizeof(uint32_t)*z0->num_used_digits);
+	ffbi_sub(scratch->val[0], scratch->val[0], scratch->val[2]);
+
+	ffbi_add(dest, scratch->val[0], z0);
+}*/
+/*
+void ffbi_mul_impl(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_scratch_t* scratch)
+{
+	ffbi_t* product = dest;
+	uint8_t destroy_product = 0;
+	uint32_t product_len = a->num_used_digits+b->num_used_digits;
+	if(dest == a || dest == b)
+	{
+		product = ffbi_create_reserved_digits(product_len);
+		destroy_product = 1;
+	}
+	if(product->num_allocated_digits < product_len)
+		ffbi_reallocate_digits(product, product_len);
+	uint8_t destroy_scratch = 0;
+	if(scratch == NULL)
+	{
+		scratch = ffbi_scratch_create();
+		destroy_scratch = 1;
+	}
+	ffbi_mul_karatsuba(product, a, b, scratch);
+	if(destroy_product)
+	{
+		ffbi_copy(dest, product);
+		ffbi_destroy(product);
+	}
+	if(destroy_scratch)
+		ffbi_scratch_destroy(scratch);
+}*/
+
+#if FFBI_DIV_CACHE_ENABLED
+static void ffbi_get_quotient_digit_cache(int q_index, ffbi_t * q, ffbi_t* rem, ffbi_t* a, ffbi_t* b, int b_len, ffbi_t* product, uint32_t is_not_last_digit, ffbi_t* scratch)
+{
+	uint32_t k;
+	int cmp = ffbi_cmp_cache(rem, b);
+	if(cmp == 0) //if r = b, then this digit of q is 1
+	{
+		q->cache[q_index] = 1;
+		rem->cache_num_used_digits = 1;
+		if(q_index > 0)
+			rem->cache[0] = a->cache[q_index-1]; //update remainder with next digit in dividend
+		else
+			rem->cache[0] = 0;
+	}
+	else if(cmp == -1) //if r < b, then this digit of q is 0
+	{
+		q->cache[q_index] = 0;
+		if(q_index > 0)
+		{
+			if(rem->cache_num_used_digits > 1 || rem->cache[0] > 0)
+			{
+				rem->cache_num_used_digits++;
+				if(rem->cache_num_allocated_digits < rem->cache_num_used_digits)
+					ffbi_cache_prepare(rem, rem->cache_num_used_digits, 1);
+				for(k=rem->cache_num_used_digits-1;k>0;k--) //shift remainder digits to the left
+					rem->cache[k] = rem->cache[k-1];
+			}
+			rem->cache[0] = a->cache[q_index-1]; //update remainder with next digit in dividend
+		}
+	}
+	else //if r > b, divide
+	{
+		uint32_t r_len = rem->cache_num_used_digits;
+		//ffbi_cache_word_t leftmost_r;
+		ffbi_cache_word_t leftmost_b = 0;
+		if(r_len == 1)
+		{
+			q->cache[q_index] = rem->cache[0]/b->cache[0];
+			goto skip_q_set;
+		}
+		else if(r_len == 2)
+		{
+			q->cache[q_index] = (rem->cache[1]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + rem->cache[0];
+			if(b_len == 2)
+				leftmost_b = (b->cache[1]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[0];
+			else
+				leftmost_b = b->cache[0];
+		}
+		else if(r_len == 3)
+		{
+			ffbi_cache_word_t shift_amount_x_2 = FFBI_CACHE_DIV_BITS_PER_DIGIT*2;
+			q->cache[q_index] = (rem->cache[r_len-1]<< shift_amount_x_2) + (rem->cache[r_len-2]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + rem->cache[r_len-3];
+			if(r_len > (uint32_t)b_len)
+				leftmost_b = (b->cache[b_len-1]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-2];
+			else
+				leftmost_b = (b->cache[b_len-1]<< shift_amount_x_2) + (b->cache[b_len-2]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-3];
+		}
+		else
+		{
+			ffbi_cache_word_t shift_amount_x_2 = FFBI_CACHE_DIV_BITS_PER_DIGIT*2;
+			ffbi_cache_word_t shift_amount_x_3 = FFBI_CACHE_DIV_BITS_PER_DIGIT*3;
+			q->cache[q_index] = (rem->cache[r_len-1]<<shift_amount_x_3) + (rem->cache[r_len-2]<<shift_amount_x_2) + (rem->cache[r_len-3]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + rem->cache[r_len-4];
+			if(r_len > (uint32_t)b_len)
+				leftmost_b = (b->cache[b_len-1]<<shift_amount_x_2) + (b->cache[b_len-2]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-3];
+			else
+				leftmost_b = (b->cache[b_len-1]<<shift_amount_x_3) + (b->cache[b_len-2]<<shift_amount_x_2) + (b->cache[b_len-3]<<FFBI_CACHE_DIV_BITS_PER_DIGIT) + b->cache[b_len-4];
+		}
+		//leftmost_r = q->cache[q_index];
+		q->cache[q_index] /= leftmost_b;
+	skip_q_set:
+		product->cache_num_used_digits = 1;
+		product->cache[0] = q->cache[q_index];
+		ffbi_div_cache_mul(scratch, product, b);
+		uint32_t q_miss_count = 0;
+		while(ffbi_cmp_cache(rem, scratch) == -1)
+		{
+			q_miss_count++;
+			//fflog_debug_print("product more than remainder. q_miss_count=%u\n", q_miss_count);
+			if(product->cache[0] == 0)
+				break;
+			product->cache[0]--;
+			q->cache[q_index]--;
+			ffbi_div_cache_mul(scratch, product, b);
+		}
+		ffbi_sub_cache(product, rem, scratch); //use product to temporarily hold the new remainder
+		//replace the old remainder with the new remainder
+		if(ffbi_cmp_cache(product, b) == 1)
+		{
+			fflog_debug_print("r greater than b.\n");
+		}
+		if(product->cache_num_used_digits > 1 || product->cache[0] > 0)
+		{
+			rem->cache_num_used_digits = product->cache_num_used_digits+is_not_last_digit;
+			if(rem->cache_num_allocated_digits < rem->cache_num_used_digits)
+				ffbi_cache_prepare(rem, rem->cache_num_used_digits, 0);
+			rem->cache[0] = 0;
+			for(k=0;k<product->cache_num_used_digits;k++)
+				rem->cache[k+is_not_last_digit] = product->cache[k];
+			rem->cache[0] += a->cache[q_index-is_not_last_digit]*is_not_last_digit; //update remainder with next digit in dividend
+		}
+		else
+		{
+			rem->cache_num_used_digits = product->cache_num_used_digits;
+			rem->cache[0] = a->cache[q_index-is_not_last_digit]*is_not_last_digit;
+		}
+	}
+}
+#endif
+
+//Returns 0 on success and 1 if the remainder can't be reallocated.
+static int ffbi_get_quotient_digit(int q_index, ffbi_t * q, ffbi_t* r, ffbi_t* a, ffbi_t* b, int b_len, ffbi_t* product, uint32_t is_not_last_digit, ffbi_t* scratch)
+{
+	uint32_t k;
+	int cmp = ffbi_cmp(r, b);
+	r->cache_valid = 0;
+	q->cache_valid = 0;
+	if(cmp == 0) //if r = b, then this digit of q is 1
+	{
+		q->digits[q_index] = 1;
+		r->num_used_digits = 1;
+		if(q_index > 0)
+			r->digits[0] = a->digits[q_index-1]; //update remainder with next digit in dividend
+		else
+			r->digits[0] = 0;
+	}
+	else if(cmp == -1) //if r < b, then this digit of q is 0
+	{
+		q->digits[q_index] = 0;
+		if(q_index > 0)
+		{
+			if(r->num_used_digits > 1 || r->digits[0] > 0)
+			{
+				if(r->num_allocated_digits<r->num_used_digits+1 && ffbi_reallocate_digits(r, r->num_used_digits+1, 1))
+					return 1;
+				r->num_used_digits++;
+				for(k=r->num_used_digits-1;k>0;k--) //shift remainder digits to the left
+					r->digits[k] = r->digits[k-1];
+			}
+			r->digits[0] = a->digits[q_index-1]; //update remainder with next digit in dividend
+		}
+	}
+	else //if r > b, divide
+	{
+		uint32_t r_len = r->num_used_digits;
+		ffbi_word_t leftmost_b = 0;
+		if(r_len == 1)
 		{
 			q->digits[q_index] = r->digits[0]/b->digits[0];
 			goto skip_q_set;
@@ -1699,485 +2931,1282 @@ static void ffbi_get_quotient_digit(int q_index, ffbi_t * q, ffbi_t* r, ffbi_t*
 		}
 		else if(r_len == 3)
 		{
-			ffbi_word_t shift_amount_x_2 = FFBI_BITS_PER_DIGIT*2;
-			q->digits[q_index] = (r->digits[r_len-1]<< shift_amount_x_2) + (r->digits[r_len-2]<<FFBI_BITS_PER_DIGIT) + r->digits[r_len-3];
-			if(r_len > (uint32_t)b_len)
-				leftmost_b = (b->digits[b_len-1]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-2];
-			else
-				leftmost_b = (b->digits[b_len-1]<< shift_amount_x_2) + (b->digits[b_len-2]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-3];
+			ffbi_word_t shift_amount_x_2 = FFBI_BITS_PER_DIGIT*2;
+			q->digits[q_index] = (r->digits[r_len-1]<< shift_amount_x_2) + (r->digits[r_len-2]<<FFBI_BITS_PER_DIGIT) + r->digits[r_len-3];
+			if(r_len > (uint32_t)b_len)
+				leftmost_b = (b->digits[b_len-1]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-2];
+			else
+				leftmost_b = (b->digits[b_len-1]<< shift_amount_x_2) + (b->digits[b_len-2]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-3];
+		}
+		else
+		{
+			ffbi_word_t shift_amount_x_2 = FFBI_BITS_PER_DIGIT*2;
+			ffbi_word_t shift_amount_x_3 = FFBI_BITS_PER_DIGIT*3;
+			q->digits[q_index] = (r->digits[r_len-1]<<shift_amount_x_3) + (r->digits[r_len-2]<<shift_amount_x_2) + (r->digits[r_len-3]<<FFBI_BITS_PER_DIGIT) + r->digits[r_len-4];
+			if(r_len > (uint32_t)b_len)
+				leftmost_b = (b->digits[b_len-1]<<shift_amount_x_2) + (b->digits[b_len-2]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-3];
+			else
+				leftmost_b = (b->digits[b_len-1]<<shift_amount_x_3) + (b->digits[b_len-2]<<shift_amount_x_2) + (b->digits[b_len-3]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-4];
+		}
+#if FFBI_DIV_DEBUG
+		fflog_print("%llu/%llu\n", q->digits[q_index], leftmost_b);
+#endif
+		q->digits[q_index] /= leftmost_b;
+	skip_q_set:
+#if FFBI_DIV_DEBUG
+		fflog_print("found q = %d, val = %llu\n", q_index, (uint64_t)q->digits[q_index]);
+#endif
+		product->num_used_digits = 1;
+		product->digits[0] = q->digits[q_index];
+		ffbi_mul(scratch, product, b);
+		uint32_t q_miss_count = 0;
+		while(ffbi_cmp(r, scratch) == -1)
+		{
+			q_miss_count++;
+			fflog_debug_print("product more than remainder. q_miss_count=%u\n", q_miss_count);
+			if(product->digits[0] == 0)
+				break;
+			product->digits[0]--;
+			q->digits[q_index]--;
+			ffbi_mul(scratch, product, b);
+		}
+/*
+		fflog_print("mul_result=");
+		for(int i=scratch->num_used_digits-1;i>=0;i--)
+			fflog_print("[%d,%llu]", i, (uint64_t)scratch->digits[i]);
+		fflog_print("\n");*/
+		//ffbi_copy(product, scratch);
+/*
+		fflog_print("r=");
+		for(int i=r->num_used_digits-1;i>=0;i--)
+			fflog_print("[%d,%u]", i, r->digits[i]);
+		fflog_print("\n");*/
+/*
+		fflog_print("rdigits=%u, product_digits=%u\n", r->num_used_digits, product->num_used_digits);
+		if(ffbi_cmp(r, product) == 1)
+			fflog_print("r >product.\n");
+		else if(ffbi_cmp(r, product) == 0)
+			fflog_print("r =product.\n");
+		else
+			fflog_print("r <product.\n");*/
+		ffbi_sub(product, r, scratch); //use product to temporarily hold the new remainder
+		//replace the old remainder with the new remainder
+		if(ffbi_cmp(product, b) == 1)
+		{
+			fflog_debug_print("r greater than b.\n");
+			fflog_print("dig=%u r=", product->num_used_digits);
+			for(int i=product->num_used_digits-1;i>=0;i--)
+				fflog_print("[%d,%llu]", i, (uint64_t)product->digits[i]);
+			fflog_print("\n");
+			fflog_print("dig=%u b=", b->num_used_digits);
+			for(int i=b->num_used_digits-1;i>=0;i--)
+				fflog_print("[%d,%llu]", i, (uint64_t)b->digits[i]);
+			fflog_print("\n");
+		}
+		if(product->num_used_digits > 1 || product->digits[0] > 0)
+		{
+			if(r->num_allocated_digits < product->num_used_digits+is_not_last_digit && ffbi_reallocate_digits(r, product->num_used_digits+is_not_last_digit, 0))
+				return 1;
+			r->num_used_digits = product->num_used_digits+is_not_last_digit;
+			r->digits[0] = 0;
+			for(k=0;k<product->num_used_digits;k++)
+				r->digits[k+is_not_last_digit] = product->digits[k];
+			r->digits[0] += a->digits[q_index-is_not_last_digit]*is_not_last_digit; //update remainder with next digit in dividend
+		}
+		else
+		{
+			r->num_used_digits = product->num_used_digits;
+			r->digits[0] = a->digits[q_index-is_not_last_digit]*is_not_last_digit;
+		}
+#if FFBI_DIV_DEBUG
+		fflog_print("new remainder = ");
+		for(int i=r->num_used_digits-1;i>=0;i--)
+			fflog_print("[%u]", r->digits[i]);
+		fflog_print("\n");
+#endif
+	}
+	return 0;
+}
+
+#if FFBI_DIV_CACHE_ENABLED
+//Returns 0 on success and 1 if the quotient or remainder can't be allocated.
+int ffbi_div_cache(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_t* rem, ffbi_t* scratch1, ffbi_t* scratch2)
+{
+	ffbi_cache_update(a, FFBI_CACHE_DIV_BITS_PER_DIGIT, _cache_div_digit_max);
+	ffbi_cache_update(b, FFBI_CACHE_DIV_BITS_PER_DIGIT, _cache_div_digit_max);
+	scratch1->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
+	ffbi_cache_prepare(scratch1, b->cache_num_used_digits+1, 0);
+
+	//determine the starting quotient digit index
+	int a_len = a->cache_num_used_digits;
+	int b_len = b->cache_num_used_digits;
+	int q_index = a_len - b_len;
+
+	//create or reallocate quotient with appropriate size
+	ffbi_cache_prepare(dest, q_index+1, 0);
+	dest->cache_num_used_digits = q_index+1;
+	dest->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
+
+	//create or reallocate remainder with size of b. remainder bigint is also used as temporary dividends on iteration
+	ffbi_workspace_t* ws = NULL;
+	uint32_t frame = 0;
+	ffbi_t* r;
+	if(rem == NULL)
+	{
+		ws = ffbi_workspace_get_thread();
+		frame = ffbi_workspace_push(ws);
+		r = ffbi_workspace_get(ws, b->num_used_digits+1+FFBI_MIN_ALLOC_DIGITS);
+		if(r == NULL)
+		{
+			ffbi_workspace_pop(ws, frame);
+			return 1;
+		}
+	}
+	else
+		r = rem;
+	ffbi_cache_prepare(r, b_len+1, 0);
+	r->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
+
+	uint32_t k;
+	for(k=0;k<(uint32_t)b_len;k++) //fill r with first partial iteration dividend
+		r->cache[k] = a->cache[q_index+k];
+	r->cache_num_used_digits = b_len;
+	//iterate and divide once per quotient digit, starting with leftmost digit and ending on one before the rightmost
+	for(;q_index>0;q_index--)
+		ffbi_get_quotient_digit_cache(q_index, dest, r, a, b, b_len, scratch1, 1, scratch2);
+	ffbi_get_quotient_digit_cache(q_index, dest, r, a, b, b_len, scratch1, 0, scratch2);
+	//see if the most significant digit of the quotient is 0, if so, trim it off.
+	if(dest->cache_num_used_digits > 1 && dest->cache[dest->cache_num_used_digits-1] == 0)
+		dest->cache_num_used_digits--;
+
+	int ret = 0;
+	if(rem == NULL)
+		ffbi_workspace_pop(ws, frame);
+	else
+		ret = ffbi_cache_retrieve(rem);
+	ret |= ffbi_cache_retrieve(dest);
+	scratch1->cache_valid = 0;
+	scratch2->cache_valid = 0;
+	return ret;
+}
+#endif
+
+//scratch 1 and 2 are user allocated bigints that has at least b's number of digits plus 1 used for
+//internal calculations. This is required.
+//remainder may be NULL if user does not need it, in which case it comes from the thread's default workspace.
+//Ideally, remainder is also a user allocated bigint with at least b's number of digits plus 1
+//for internal calculations in the case where optimizations may be possible with bigint reuse.
+//Returns 0 on success and 1 on error. dest may not be NULL or point to another argument.
+int ffbi_div_impl(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_t* rem, ffbi_t* scratch1, ffbi_t* scratch2)
+{
+#if FFBI_DIV_DEBUG
+	fflog_print("\nstarting div\n");
+	fflog_print("a=");
+	for(int i=a->num_used_digits-1;i>=0;i--)
+		fflog_print("[%u]", a->digits[i]);
+	fflog_print("\nb=");
+	for(int i=b->num_used_digits-1;i>=0;i--)
+		fflog_print("[%u]", b->digits[i]);
+	fflog_print("\n");
+#endif
+	FFBI_RETURN_IF_VIEW(dest, 1);
+	if(rem)
+		FFBI_RETURN_IF_VIEW(rem, 1);
+	FFBI_STATS_COUNT(FFBI_STATS_DIV);
+	int cmp = ffbi_cmp(b, a);
+	if(cmp == 1) //if b>a, return 0
+	{
+		if(rem)
+		{
+			if(rem != a)
+			{
+				if(a->num_used_digits > rem->num_allocated_digits && ffbi_reallocate_digits(rem, a->num_used_digits, 0))
+					return 1;
+				rem->num_used_digits = a->num_used_digits;
+				memcpy(rem->digits, a->digits, a->num_used_digits*sizeof(ffbi_word_t));
+				rem->cache_valid = 0;
+			}
 		}
-		else
+		dest->num_used_digits = 1;
+		dest->digits[0] = 0;
+		dest->cache_valid = 0;
+		return 0;
+	}
+	if(cmp == 0) //if b=a, return 1
+	{
+		dest->num_used_digits = 1;
+		dest->digits[0] = 1;
+		dest->cache_valid = 0;
+		if(rem)
 		{
-			ffbi_word_t shift_amount_x_2 = FFBI_BITS_PER_DIGIT*2;
-			ffbi_word_t shift_amount_x_3 = FFBI_BITS_PER_DIGIT*3;
-			q->digits[q_index] = (r->digits[r_len-1]<<shift_amount_x_3) + (r->digits[r_len-2]<<shift_amount_x_2) + (r->digits[r_len-3]<<FFBI_BITS_PER_DIGIT) + r->digits[r_len-4];
-			if(r_len > (uint32_t)b_len)
-				leftmost_b = (b->digits[b_len-1]<<shift_amount_x_2) + (b->digits[b_len-2]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-3];
-			else
-				leftmost_b = (b->digits[b_len-1]<<shift_amount_x_3) + (b->digits[b_len-2]<<shift_amount_x_2) + (b->digits[b_len-3]<<FFBI_BITS_PER_DIGIT) + b->digits[b_len-4];
+			rem->num_used_digits = 1;
+			rem->digits[0] = 0;
+			rem->cache_valid = 0;
 		}
+		return 0;
+	}
+	//a digit of the quotient takes a product of b and a digit, and the remainder is written once
+	FFBI_STATS_CHARGE((uint64_t)(a->num_used_digits - b->num_used_digits + 1)*b->num_used_digits,
+		(uint64_t)(2*a->num_used_digits + 2*b->num_used_digits)*sizeof(ffbi_word_t));
+
+#if FFBI_DIV_CACHE_ENABLED
+	if(a->num_used_digits > 1 || b->num_used_digits > 1)
+		return ffbi_div_cache(dest, a, b, rem, scratch1, scratch2);
+#endif
+
 #if FFBI_DIV_DEBUG
-		fflog_print("%llu/%llu\n", q->digits[q_index], leftmost_b);
+	fflog_print("confirmed a>b\n");
 #endif
-		q->digits[q_index] /= leftmost_b;
-	skip_q_set:
+	//determine the starting quotient digit index
+	int a_len = a->num_used_digits;
+	int b_len = b->num_used_digits;
+	int q_index = a_len - b_len;
+
 #if FFBI_DIV_DEBUG
-		fflog_print("found q = %d, val = %llu\n", q_index, (uint64_t)q->digits[q_index]);
+	fflog_print("start q_index = %d\n", q_index);
 #endif
-		product->num_used_digits = 1;
-		product->digits[0] = q->digits[q_index];
-		ffbi_mul(scratch, product, b);
-		uint32_t q_miss_count = 0;
-		while(ffbi_cmp(r, scratch) == -1)
+
+	//create or reallocate quotient with appropriate size
+	if(dest->num_allocated_digits <= (uint32_t)q_index && ffbi_reallocate_digits(dest, q_index+2, 0))
+		return 1;
+	dest->num_used_digits = q_index+1;
+
+	ffbi_t* product = scratch1;
+	//create or reallocate remainder with size of b. remainder bigint is also used as temporary dividends on iteration
+	ffbi_workspace_t* ws = NULL;
+	uint32_t frame = 0;
+	ffbi_t* r;
+	if(rem == NULL)
+	{
+		ws = ffbi_workspace_get_thread();
+		frame = ffbi_workspace_push(ws);
+		r = ffbi_workspace_get(ws, b_len+1+FFBI_MIN_ALLOC_DIGITS);
+		if(r == NULL)
 		{
-			q_miss_count++;
-			fflog_debug_print("product more than remainder. q_miss_count=%u\n", q_miss_count);
-			if(product->digits[0] == 0)
-				break;
-			product->digits[0]--;
-			q->digits[q_index]--;
-			ffbi_mul(scratch, product, b);
+			ffbi_workspace_pop(ws, frame);
+			return 1;
 		}
-/*
-		fflog_print("mul_result=");
-		for(int i=scratch->num_used_digits-1;i>=0;i--)
-			fflog_print("[%d,%llu]", i, (uint64_t)scratch->digits[i]);
-		fflog_print("\n");*/
-		//ffbi_copy(product, scratch);
-/*
-		fflog_print("r=");
-		for(int i=r->num_used_digits-1;i>=0;i--)
-			fflog_print("[%d,%u]", i, r->digits[i]);
-		fflog_print("\n");*/
-/*
-		fflog_print("rdigits=%u, product_digits=%u\n", r->num_used_digits, product->num_used_digits);
-		if(ffbi_cmp(r, product) == 1)
-			fflog_print("r >product.\n");
-		else if(ffbi_cmp(r, product) == 0)
-			fflog_print("r =product.\n");
-		else
-			fflog_print("r <product.\n");*/
-		ffbi_sub(product, r, scratch); //use product to temporarily hold the new remainder
-		//replace the old remainder with the new remainder
-		if(ffbi_cmp(product, b) == 1)
+	}
+	else
+	{
+		r = rem;
+		if(r->num_allocated_digits < (uint32_t)b_len+1 && ffbi_reallocate_digits(r, (b_len+1)*FFBI_REALLOC_GROWTH_FACTOR+1, 0))
+			return 1;
+	}
+	uint32_t k;
+	for(k=0;k<(uint32_t)b_len;k++) //fill r with first partial iteration dividend
+		r->digits[k] = a->digits[q_index+k];
+	r->num_used_digits = b_len;
+	//iterate and divide once per quotient digit, starting with leftmost digit and ending on one before the rightmost
+	int ret = 0;
+	for(;q_index>0 && ret == 0;q_index--)
+		ret = ffbi_get_quotient_digit(q_index, dest, r, a, b, b_len, product, 1, scratch2);
+	if(ret == 0)
+		ret = ffbi_get_quotient_digit(q_index, dest, r, a, b, b_len, product, 0, scratch2);
+	//see if the most significant digit of the quotient is 0, if so, trim it off.
+	if(dest->num_used_digits > 1 && dest->digits[dest->num_used_digits-1] == 0)
+		dest->num_used_digits--;
+
+	if(rem == NULL)
+		ffbi_workspace_pop(ws, frame);
+	dest->cache_valid = 0;
+	scratch1->cache_valid = 0;
+	scratch2->cache_valid = 0;
+	return ret;
+}
+
+void ffbi_prepare_divisor(ffbi_t* p)
+{
+#if FFBI_DIV_CACHE_ENABLED
+	ffbi_cache_update(p, FFBI_CACHE_DIV_BITS_PER_DIGIT, _cache_div_digit_max);
+#endif
+}
+
+//[division] dest = a / b
+void ffbi_div(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	ffbi_workspace_t* ws = ffbi_workspace_get_thread();
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* scratch = ffbi_workspace_get(ws, b->num_used_digits+1);
+	ffbi_t* scratch2 = ffbi_workspace_get(ws, b->num_used_digits+1);
+	ffbi_div_impl(dest, a, b, NULL, scratch, scratch2);
+	ffbi_workspace_pop(ws, frame);
+}
+
+//[mod] dest = a % b
+void ffbi_mod(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	ffbi_workspace_t* ws = ffbi_workspace_get_thread();
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* scratch = ffbi_workspace_get(ws, b->num_used_digits+1);
+	ffbi_t* scratch2 = ffbi_workspace_get(ws, b->num_used_digits+1);
+	ffbi_t* quotient = ffbi_workspace_get(ws, a->num_used_digits);
+	ffbi_div_impl(quotient, a, b, dest, scratch, scratch2);
+	ffbi_workspace_pop(ws, frame);
+}
+
+//[modular exponentiation] dest = (n ^ e) % m
+//dest should have m's + n's number of digits to avoid a reallocation.
+//dest should not be the same pointer as any other arguments.
+void ffbi_mod_pow(ffbi_t* dest, ffbi_t* n, ffbi_t* e, ffbi_t* m, ffbi_workspace_t* ws)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	FFBI_STATS_COUNT(FFBI_STATS_MOD_POW);
+	if(m->num_used_digits == 1 && m->digits[0] == 1)
+	{
+		dest->num_used_digits = 1;
+		dest->digits[0] = 0;
+		return;
+	}
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	uint32_t num_digits = m->num_used_digits+n->num_used_digits;
+	//products of two values below max(m, n) fit in twice its digits
+	uint32_t product_digits = (m->num_used_digits > n->num_used_digits ? m->num_used_digits : n->num_used_digits)*2+1;
+	ffbi_workspace_reserve(ws, FFBI_MOD_POW_NUM_VALS, product_digits);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* val[FFBI_MOD_POW_NUM_VALS];
+	for(int i=0;i<FFBI_MOD_POW_NUM_VALS;i++)
+		val[i] = ffbi_workspace_get(ws, product_digits);
+	ffbi_t* ret = dest;
+	if(ret->num_allocated_digits < num_digits && ffbi_reallocate_digits(ret, num_digits, 0))
+	{
+		ffbi_workspace_pop(ws, frame);
+		return;
+	}
+	ret->num_used_digits = 1;
+	ret->digits[0] = 1;
+	ret->cache_valid = 0;
+	ffbi_t* apow = val[0];
+	ffbi_copy(apow, n);
+	uint32_t e_bits = ffbi_bit_length(e);
+	for(uint32_t i=0;i<e_bits;i++)
+	{
+		if(ffbi_test_bit(e, i))
 		{
-			fflog_debug_print("r greater than b.\n");
-			fflog_print("dig=%u r=", product->num_used_digits);
-			for(int i=product->num_used_digits-1;i>=0;i--)
-				fflog_print("[%d,%llu]", i, (uint64_t)product->digits[i]);
-			fflog_print("\n");
-			fflog_print("dig=%u b=", b->num_used_digits);
-			for(int i=b->num_used_digits-1;i>=0;i--)
-				fflog_print("[%d,%llu]", i, (uint64_t)b->digits[i]);
-			fflog_print("\n");
+			ffbi_mul(val[1], ret, apow);
+			ffbi_div_impl(val[4], val[1], m, ret, val[2], val[3]);
 		}
-		if(product->num_used_digits > 1 || product->digits[0] > 0)
+		if(i + 1 < e_bits)
 		{
-			r->num_used_digits = product->num_used_digits+is_not_last_digit;
-			if(r->num_allocated_digits < r->num_used_digits)
-				ffbi_reallocate_digits(r, r->num_used_digits, 0);
-			r->digits[0] = 0;
-			for(k=0;k<product->num_used_digits;k++)
-				r->digits[k+is_not_last_digit] = product->digits[k];
-			r->digits[0] += a->digits[q_index-is_not_last_digit]*is_not_last_digit; //update remainder with next digit in dividend
+			ffbi_mul(val[1], apow, apow);
+			ffbi_div_impl(val[4], val[1], m, apow, val[2], val[3]);
+		}
+	}
+	ffbi_workspace_pop(ws, frame);
+}
+
+//[greatest common divisor] dest = gcd(a, b)
+//Uses the binary gcd algorithm. scratch is a user allocated bigint used for internal calculations.
+//dest and scratch should not be the same pointer as any other arguments.
+void ffbi_gcd(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_t* scratch)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	if(ffbi_is_zero(a))
+	{
+		ffbi_copy(dest, b);
+		return;
+	}
+	if(ffbi_is_zero(b))
+	{
+		ffbi_copy(dest, a);
+		return;
+	}
+	ffbi_t* u = dest;
+	ffbi_t* v = scratch;
+	ffbi_copy(u, a);
+	ffbi_copy(v, b);
+	uint32_t u_shift = ffbi_trailing_zeros(u);
+	uint32_t v_shift = ffbi_trailing_zeros(v);
+	uint32_t shift = u_shift < v_shift ? u_shift : v_shift;
+	ffbi_shr(u, u, u_shift);
+	ffbi_shr(v, v, v_shift);
+	while(1)
+	{
+		//finish with machine words once both values fit in a digit
+		if(u->num_used_digits == 1 && v->num_used_digits == 1)
+		{
+			u->digits[0] = ffbi_gcd_digit((uint64_t)u->digits[0], (uint64_t)v->digits[0]);
+			break;
+		}
+		if(ffbi_cmp(u, v) == 1)
+		{
+			ffbi_t* t = u;
+			u = v;
+			v = t;
+		}
+		ffbi_sub(v, v, u);
+		if(ffbi_is_zero(v))
+			break;
+		ffbi_shr(v, v, ffbi_trailing_zeros(v));
+	}
+	if(u != dest)
+		ffbi_copy(dest, u);
+	dest->cache_valid = 0;
+	ffbi_shl(dest, dest, shift);
+}
+
+//[modular multiplicative inverse] dest = multiplicative inverse of a mod m.
+void ffbi_mod_inv(ffbi_t* dest, ffbi_t* a, ffbi_t* m)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	FFBI_STATS_COUNT(FFBI_STATS_MOD_INV);
+	if(dest->num_allocated_digits < m->num_used_digits && ffbi_reallocate_digits(dest, m->num_used_digits, 0))
+		return;
+	if(m->num_used_digits == 1 && m->digits[0] == 1)
+	{
+		dest->num_used_digits = 1;
+		dest->digits[0] = 0;
+		dest->cache_valid = 0;
+		return;
+	}
+	ffbi_workspace_t* ws = ffbi_workspace_get_thread();
+	//q*y may take twice the digits of the operands
+	uint32_t num_digits = (a->num_used_digits > m->num_used_digits ? a->num_used_digits : m->num_used_digits)*2+1;
+	ffbi_workspace_reserve(ws, FFBI_MOD_INV_NUM_VALS, num_digits);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* m_temp = ffbi_workspace_get(ws, num_digits);
+	ffbi_copy(m_temp, m);
+	ffbi_t* a_temp = ffbi_workspace_get(ws, num_digits);
+	ffbi_copy(a_temp, a);
+	ffbi_t* t = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* y = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* x = ffbi_workspace_get(ws, num_digits);
+	x->num_used_digits = 1;
+	x->digits[0] = 1;
+	ffbi_t* q = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* scratch = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* scratch2 = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* temp = ffbi_workspace_get(ws, num_digits);
+	uint8_t y_is_negative = 0;
+	uint8_t x_is_negative = 0;
+	while(a_temp->num_used_digits > 1 || a_temp->digits[0] > 1)
+	{
+		ffbi_div_impl(q, a_temp, m_temp, temp, scratch, scratch2);
+		ffbi_copy(a_temp, m_temp);
+		ffbi_copy(m_temp, temp);
+		ffbi_copy(t, y);
+		uint8_t t_is_negative = y_is_negative;
+		ffbi_mul(temp, q, y);
+		int cmp = ffbi_cmp(x, temp);
+		if(cmp == -1)
+		{
+			if(x_is_negative)
+			{
+				if(y_is_negative)
+				{
+					ffbi_sub(y, temp, x);
+					y_is_negative = 0;
+				}
+				else
+				{
+					ffbi_add(y, x, temp);
+					y_is_negative = 1;
+				}
+			}
+			else
+			{
+				if(y_is_negative)
+				{
+					ffbi_add(y, temp, x);
+					y_is_negative = 0;
+				}
+				else
+				{
+					ffbi_sub(y, temp, x);
+					y_is_negative = 1;
+				}
+			}
+		}
+		else if(cmp == 1)
+		{
+			if(x_is_negative)
+			{
+				if(y_is_negative)
+					ffbi_sub(y, x, temp);
+				else
+				{
+					ffbi_add(y, x, temp);
+					y_is_negative = 1;
+				}
+			}
+			else
+			{
+				if(y_is_negative)
+				{
+					ffbi_add(y, x, temp);
+					y_is_negative = 0;
+				}
+				else
+					ffbi_sub(y, x, temp);
+			}
 		}
 		else
 		{
-			r->num_used_digits = product->num_used_digits;
-			r->digits[0] = a->digits[q_index-is_not_last_digit]*is_not_last_digit;
+			if(x_is_negative)
+			{
+				if(y_is_negative)
+				{
+					y->num_used_digits = 1;
+					y->digits[0] = 0;
+					y->cache_valid = 0;
+					y_is_negative = 0;
+				}
+				else
+				{
+					ffbi_add(y, x, temp);
+					y_is_negative = 1;
+				}
+			}
+			else
+			{
+				if(y_is_negative)
+				{
+					ffbi_add(y, x, temp);
+					y_is_negative = 0;
+				}
+				else
+				{
+					y->num_used_digits = 1;
+					y->digits[0] = 0;
+					y->cache_valid = 0;
+				}
+			}
 		}
-#if FFBI_DIV_DEBUG
-		fflog_print("new remainder = ");
-		for(int i=r->num_used_digits-1;i>=0;i--)
-			fflog_print("[%u]", r->digits[i]);
-		fflog_print("\n");
-#endif
+		if(y->num_used_digits == 1 && y->digits[0] == 0)
+			y_is_negative = 0;
+		ffbi_copy(x, t);
+		x_is_negative = t_is_negative;
 	}
+	if(x_is_negative)
+		ffbi_sub(t, m, x);
+	ffbi_copy(dest, t);
+	ffbi_workspace_pop(ws, frame);
 }
 
-#if FFBI_DIV_CACHE_ENABLED
-void ffbi_div_cache(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_t* rem, ffbi_t* scratch1, ffbi_t* scratch2)
+void ffbi_copy(ffbi_t* dest, ffbi_t* src)
 {
-	ffbi_cache_update(a, FFBI_CACHE_DIV_BITS_PER_DIGIT, _cache_div_digit_max);
-	ffbi_cache_update(b, FFBI_CACHE_DIV_BITS_PER_DIGIT, _cache_div_digit_max);
-	scratch1->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
-	ffbi_cache_prepare(scratch1, b->cache_num_used_digits+1, 0);
+	FFBI_RETURN_IF_VIEW(dest);
+	if(dest->num_allocated_digits < src->num_used_digits && ffbi_reallocate_digits(dest, src->num_used_digits, 0))
+		return;
+	dest->num_used_digits = src->num_used_digits;
+	memcpy(dest->digits, src->digits, src->num_used_digits*sizeof(ffbi_word_t));
+	dest->cache_valid = 0;
+}
 
-	//determine the starting quotient digit index
-	int a_len = a->cache_num_used_digits;
-	int b_len = b->cache_num_used_digits;
-	int q_index = a_len - b_len;
+int ffbi_is_zero(ffbi_t* p)
+{
+	if(p->num_used_digits == 1 && p->digits[0] == 0)
+		return 1;
+	return 0;
+}
 
-	//create or reallocate quotient with appropriate size
-	ffbi_cache_prepare(dest, q_index+1, 0);
-	dest->cache_num_used_digits = q_index+1;
-	dest->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
+//Columns hold sums of digit-sized terms that are only carried into the next column by
+//ffbi_acc_normalize. Digits from num_used_digits to num_allocated_digits are always 0.
+struct FFBI_ACC
+{
+	ffbi_word_t* digits;
+	uint32_t num_allocated_digits;
+	uint32_t num_used_digits;
+	ffbi_word_t terms_left; //number of terms every column can still absorb
+};
 
-	//create or reallocate remainder with size of b. remainder bigint is also used as temporary dividends on iteration
-	ffbi_t* r;
-	if(rem == NULL)
-		r = ffbi_create_reserved_digits(b->num_used_digits+1+FFBI_MIN_ALLOC_DIGITS);
-	else
-		r = rem;
-	ffbi_cache_prepare(r, b_len+1, 0);
-	r->cache_bits_per_digit = FFBI_CACHE_DIV_BITS_PER_DIGIT;
+ffbi_acc_t* ffbi_acc_create(uint32_t bits)
+{
+	ffbi_acc_t* acc = ffmem_alloc(ffbi_acc_t);
+	acc->num_allocated_digits = (bits + FFBI_BITS_PER_DIGIT - 1)/FFBI_BITS_PER_DIGIT + FFBI_ACC_CARRY_DIGITS;
+	if(acc->num_allocated_digits < FFBI_MIN_ALLOC_DIGITS)
+		acc->num_allocated_digits = FFBI_MIN_ALLOC_DIGITS;
+	acc->digits = ffmem_alloc_arr(ffbi_word_t, acc->num_allocated_digits);
+	memset(acc->digits, 0, acc->num_allocated_digits*sizeof(ffbi_word_t));
+	acc->num_used_digits = 1;
+	acc->terms_left = FFBI_ACC_MAX_TERMS - 1;
+	return acc;
+}
 
-	uint32_t k;
-	for(k=0;k<(uint32_t)b_len;k++) //fill r with first partial iteration dividend
-		r->cache[k] = a->cache[q_index+k];
-	r->cache_num_used_digits = b_len;
-	//iterate and divide once per quotient digit, starting with leftmost digit and ending on one before the rightmost
-	for(;q_index>0;q_index--)
-		ffbi_get_quotient_digit_cache(q_index, dest, r, a, b, b_len, scratch1, 1, scratch2);
-	ffbi_get_quotient_digit_cache(q_index, dest, r, a, b, b_len, scratch1, 0, scratch2);
-	//see if the most significant digit of the quotient is 0, if so, trim it off.
-	if(dest->cache_num_used_digits > 1 && dest->cache[dest->cache_num_used_digits-1] == 0)
-		dest->cache_num_used_digits--;
+void ffbi_acc_destroy(ffbi_acc_t* acc)
+{
+	ffmem_free_arr(acc->digits);
+	ffmem_free(acc);
+}
 
-	if(rem == NULL)
-		ffbi_destroy(r);
-	else
-		ffbi_cache_retrieve(rem);
-	ffbi_cache_retrieve(dest);
-	scratch1->cache_valid = 0;
-	scratch2->cache_valid = 0;
+void ffbi_acc_clear(ffbi_acc_t* acc)
+{
+	memset(acc->digits, 0, acc->num_used_digits*sizeof(ffbi_word_t));
+	acc->num_used_digits = 1;
+	acc->terms_left = FFBI_ACC_MAX_TERMS - 1;
 }
-#endif
 
-//scratch 1 and 2 are user allocated bigints that has at least b's number of digits plus 1 used for
-//internal calculations. This is required.
-//remainder may be NULL if user does not need it, in which case an extra allocation takes place internally.
-//Ideally, remainder is also a user allocated bigint with at least b's number of digits plus 1
-//for internal calculations in the case where optimizations may be possible with bigint reuse.
-//Returns 0 on success and 1 on error. dest may not be NULL or point to another argument.
-int ffbi_div_impl(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_t* rem, ffbi_t* scratch1, ffbi_t* scratch2)
+//Makes sure columns up to num_digits plus room for their carries exist.
+static void ffbi_acc_reserve(ffbi_acc_t* acc, uint32_t num_digits)
 {
-#if FFBI_DIV_DEBUG
-	fflog_print("\nstarting div\n");
-	fflog_print("a=");
-	for(int i=a->num_used_digits-1;i>=0;i--)
-		fflog_print("[%u]", a->digits[i]);
-	fflog_print("\nb=");
-	for(int i=b->num_used_digits-1;i>=0;i--)
-		fflog_print("[%u]", b->digits[i]);
-	fflog_print("\n");
-#endif
-	int cmp = ffbi_cmp(b, a);
-	if(cmp == 1) //if b>a, return 0
+	num_digits += FFBI_ACC_CARRY_DIGITS;
+	if(num_digits <= acc->num_allocated_digits)
+		return;
+	uint32_t num_allocated_digits = (uint32_t)(num_digits*FFBI_REALLOC_GROWTH_FACTOR);
+	ffbi_word_t* digits = ffmem_alloc_arr(ffbi_word_t, num_allocated_digits);
+	memcpy(digits, acc->digits, acc->num_used_digits*sizeof(ffbi_word_t));
+	memset(digits + acc->num_used_digits, 0, (num_allocated_digits - acc->num_used_digits)*sizeof(ffbi_word_t));
+	ffmem_free_arr(acc->digits);
+	acc->digits = digits;
+	acc->num_allocated_digits = num_allocated_digits;
+}
+
+void ffbi_acc_normalize(ffbi_acc_t* acc)
+{
+	ffbi_word_t* digits = acc->digits;
+	uint32_t i;
+	for(i=0;i+1<acc->num_used_digits;i++)
 	{
-		if(rem)
+		digits[i+1] += digits[i] >> FFBI_BITS_PER_DIGIT;
+		digits[i] &= _digit_max;
+	}
+	//the top column may spill into the carry digits
+	while(digits[i] >> FFBI_BITS_PER_DIGIT)
+	{
+		digits[i+1] = digits[i] >> FFBI_BITS_PER_DIGIT;
+		digits[i] &= _digit_max;
+		i++;
+	}
+	acc->num_used_digits = ffbi_trim_len(digits, i+1);
+	acc->terms_left = FFBI_ACC_MAX_TERMS - 1;
+}
+
+//Normalizes acc first if some column can't absorb num_terms more terms.
+static inline void ffbi_acc_make_room(ffbi_acc_t* acc, ffbi_word_t num_terms)
+{
+	if(acc->terms_left < num_terms)
+		ffbi_acc_normalize(acc);
+	acc->terms_left -= num_terms;
+}
+
+void ffbi_acc_add(ffbi_acc_t* acc, ffbi_t* a)
+{
+	uint32_t a_len = a->num_used_digits;
+	ffbi_acc_reserve(acc, a_len);
+	ffbi_acc_make_room(acc, 1);
+	ffbi_word_t* digits = acc->digits;
+	for(uint32_t i=0;i<a_len;i++)
+		digits[i] += a->digits[i];
+	if(acc->num_used_digits < a_len)
+		acc->num_used_digits = a_len;
+}
+
+void ffbi_acc_mul_add(ffbi_acc_t* acc, ffbi_t* a, ffbi_t* b)
+{
+	uint32_t a_len = a->num_used_digits;
+	uint32_t b_len = b->num_used_digits;
+	ffbi_word_t min_len = a_len < b_len ? a_len : b_len;
+	ffbi_acc_reserve(acc, a_len + b_len);
+	ffbi_word_t* digits = acc->digits;
+	uint32_t k, i;
+	//a product is worth 2^FFBI_BITS_PER_DIGIT terms, and a column gets up to min_len of them
+	if((min_len << FFBI_BITS_PER_DIGIT) < FFBI_ACC_MAX_TERMS)
+	{
+		ffbi_acc_make_room(acc, min_len << FFBI_BITS_PER_DIGIT);
+		for(k=0;k<a_len;k++)
 		{
-			if(rem != a)
-			{
-				if(a->num_used_digits > rem->num_allocated_digits)
-					ffbi_reallocate_digits(rem, a->num_used_digits, 0);
-				rem->num_used_digits = a->num_used_digits;
-				memcpy(rem->digits, a->digits, a->num_used_digits*sizeof(ffbi_word_t));
-				rem->cache_valid = 0;
-			}
+			ffbi_word_t d = a->digits[k];
+			ffbi_word_t* column = digits + k;
+			for(i=0;i<b_len;i++)
+				column[i] += d * b->digits[i];
 		}
-		dest->num_used_digits = 1;
-		dest->digits[0] = 0;
-		dest->cache_valid = 0;
-		return 0;
 	}
-	if(cmp == 0) //if b=a, return 1
+	else
 	{
-		dest->num_used_digits = 1;
-		dest->digits[0] = 1;
-		dest->cache_valid = 0;
-		if(rem)
+		//too many products per column, so each one adds its low half to one column and its high half to the next
+		ffbi_acc_make_room(acc, 2*min_len);
+		for(k=0;k<a_len;k++)
 		{
-			rem->num_used_digits = 1;
-			rem->digits[0] = 0;
-			rem->cache_valid = 0;
+			ffbi_word_t d = a->digits[k];
+			ffbi_word_t* column = digits + k;
+			for(i=0;i<b_len;i++)
+			{
+				ffbi_word_t p = d * b->digits[i];
+				column[i] += p & _digit_max;
+				column[i+1] += p >> FFBI_BITS_PER_DIGIT;
+			}
 		}
-		return 0;
 	}
+	if(acc->num_used_digits < a_len + b_len)
+		acc->num_used_digits = a_len + b_len;
+}
 
-#if FFBI_DIV_CACHE_ENABLED
-	if(a->num_used_digits > 1 || b->num_used_digits > 1)
-	{
-		ffbi_div_cache(dest, a, b, rem, scratch1, scratch2);
-		return 0;
-	}
-#endif
+void ffbi_acc_get(ffbi_acc_t* acc, ffbi_t* dest)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	ffbi_acc_normalize(acc);
+	if(dest->num_allocated_digits < acc->num_used_digits && ffbi_reallocate_digits(dest, acc->num_used_digits, 0))
+		return;
+	dest->num_used_digits = acc->num_used_digits;
+	memcpy(dest->digits, acc->digits, acc->num_used_digits*sizeof(ffbi_word_t));
+	dest->cache_valid = 0;
+}
 
-#if FFBI_DIV_DEBUG
-	fflog_print("confirmed a>b\n");
-#endif
-	//determine the starting quotient digit index
-	int a_len = a->num_used_digits;
-	int b_len = b->num_used_digits;
-	int q_index = a_len - b_len;
+//Words of one cache line. Limb blocks of a vector start on a cache line.
+#define FFBI_VEC_LINE_WORDS (FFBI_CACHE_LINE_SIZE/sizeof(ffbi_word_t))
+#define FFBI_VEC_MOD_NUM_VALS 5
+#define FFBI_VEC_MOD_POW_NUM_VALS 2
 
-#if FFBI_DIV_DEBUG
-	fflog_print("start q_index = %d\n", q_index);
-#endif
+typedef struct alignas(FFBI_CACHE_LINE_SIZE) FFBI_VEC_LINE
+{
+	ffbi_word_t words[FFBI_VEC_LINE_WORDS];
+} ffbi_vec_line_t;
 
-	//create or reallocate quotient with appropriate size
-	if(dest->num_allocated_digits <= (uint32_t)q_index)
-		ffbi_reallocate_digits(dest, q_index+2, 0);
-	dest->num_used_digits = q_index+1;
+//Digit i of value j is at digits[i*stride + j], so a pass over one limb of every value reads
+//consecutive words. Every value keeps all num_digits digits, with 0 in the unused ones.
+struct FFBI_VEC
+{
+	ffbi_vec_line_t* lines;
+	ffbi_word_t* digits;
+	uint32_t count;
+	uint32_t num_digits;
+	uint32_t stride;
+};
 
-	ffbi_t* product = scratch1;
-	//create or reallocate remainder with size of b. remainder bigint is also used as temporary dividends on iteration
-	ffbi_t* r;
-	if(rem == NULL)
-		r = ffbi_create_reserved_digits(b_len+1+FFBI_MIN_ALLOC_DIGITS);
-	else
+static inline ffbi_word_t* ffbi_vec_limb(ffbi_vec_t* v, uint32_t i)
+{
+	return v->digits + (size_t)i*v->stride;
+}
+
+ffbi_vec_t* ffbi_vec_create(uint32_t count, uint32_t bits)
+{
+	if(count == 0 || bits == 0)
 	{
-		r = rem;
-		if(r->num_allocated_digits < (uint32_t)b_len+1)
-			ffbi_reallocate_digits(r, (b_len+1)*FFBI_REALLOC_GROWTH_FACTOR+1, 0);
+		fflog_debug_print("invalid argument(s).\n");
+		return NULL;
 	}
-	uint32_t k;
-	for(k=0;k<(uint32_t)b_len;k++) //fill r with first partial iteration dividend
-		r->digits[k] = a->digits[q_index+k];
-	r->num_used_digits = b_len;
-	//iterate and divide once per quotient digit, starting with leftmost digit and ending on one before the rightmost
-	for(;q_index>0;q_index--)
-		ffbi_get_quotient_digit(q_index, dest, r, a, b, b_len, product, 1, scratch2);
-	ffbi_get_quotient_digit(q_index, dest, r, a, b, b_len, product, 0, scratch2);
-	//see if the most significant digit of the quotient is 0, if so, trim it off.
-	if(dest->num_used_digits > 1 && dest->digits[dest->num_used_digits-1] == 0)
-		dest->num_used_digits--;
+	ffbi_vec_t* v = ffmem_alloc(ffbi_vec_t);
+	v->count = count;
+	v->num_digits = (bits + FFBI_BITS_PER_DIGIT - 1)/FFBI_BITS_PER_DIGIT;
+	v->stride = (uint32_t)((count + FFBI_VEC_LINE_WORDS - 1)/FFBI_VEC_LINE_WORDS*FFBI_VEC_LINE_WORDS);
+	size_t num_lines = (size_t)v->num_digits*v->stride/FFBI_VEC_LINE_WORDS;
+	v->lines = ffmem_alloc_arr(ffbi_vec_line_t, (int)num_lines);
+	v->digits = v->lines[0].words;
+	memset(v->digits, 0, num_lines*sizeof(ffbi_vec_line_t));
+	return v;
+}
 
-	int ret = 0;
-	if(rem == NULL)
-		ffbi_destroy(r);
-	dest->cache_valid = 0;
-	scratch1->cache_valid = 0;
-	scratch2->cache_valid = 0;
-	return ret;
+void ffbi_vec_destroy(ffbi_vec_t* v)
+{
+	ffmem_free_arr(v->lines);
+	ffmem_free(v);
+}
+
+uint32_t ffbi_vec_get_count(ffbi_vec_t* v)
+{
+	return v->count;
+}
+
+uint32_t ffbi_vec_get_num_digits(ffbi_vec_t* v)
+{
+	return v->num_digits;
+}
+
+//Copies value index of v into p.
+static void ffbi_vec_gather(ffbi_vec_t* v, uint32_t index, ffbi_t* p)
+{
+	if(p->num_allocated_digits < v->num_digits && ffbi_reallocate_digits(p, v->num_digits, 0))
+		return;
+	ffbi_word_t* src = v->digits + index;
+	for(uint32_t i=0;i<v->num_digits;i++)
+		p->digits[i] = src[(size_t)i*v->stride];
+	p->num_used_digits = ffbi_trim_len(p->digits, v->num_digits);
+	p->cache_valid = 0;
 }
 
-//[division] dest = a / b
-void ffbi_div(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+//Copies p into value index of v. p must fit in the digits of v.
+static void ffbi_vec_scatter(ffbi_vec_t* v, uint32_t index, ffbi_t* p)
 {
-	ffbi_t* scratch = ffbi_create_reserved_digits(b->num_used_digits+1);
-	ffbi_t* scratch2 = ffbi_create_reserved_digits(b->num_used_digits+1);
-	ffbi_div_impl(dest, a, b, NULL, scratch, scratch2);
-	ffbi_destroy(scratch);
-	ffbi_destroy(scratch2);
+	ffbi_word_t* dst = v->digits + index;
+	uint32_t i;
+	for(i=0;i<p->num_used_digits;i++)
+		dst[(size_t)i*v->stride] = p->digits[i];
+	for(;i<v->num_digits;i++)
+		dst[(size_t)i*v->stride] = 0;
 }
 
-//[mod] dest = a % b
-void ffbi_mod(ffbi_t* dest, ffbi_t* a, ffbi_t* b)
+void ffbi_vec_get(ffbi_vec_t* v, uint32_t index, ffbi_t* dest)
 {
-	ffbi_t* scratch = ffbi_create_reserved_digits(b->num_used_digits+1);
-	ffbi_t* scratch2 = ffbi_create_reserved_digits(b->num_used_digits+1);
-	ffbi_t* quotient = ffbi_create_reserved_digits(a->num_used_digits);
-	ffbi_div_impl(quotient, a, b, dest, scratch, scratch2);
-	ffbi_destroy(scratch);
-	ffbi_destroy(scratch2);
-	ffbi_destroy(quotient);
+	FFBI_RETURN_IF_VIEW(dest);
+	if(index >= v->count)
+	{
+		fflog_debug_print("index out of range.\n");
+		return;
+	}
+	ffbi_vec_gather(v, index, dest);
 }
 
-//[modular exponentiation] dest = (n ^ e) % m
-//dest should have m's + n's number of digits to avoid a reallocation.
-//dest should not be the same pointer as any other arguments.
-void ffbi_mod_pow(ffbi_t* dest, ffbi_t* n, ffbi_t* e, ffbi_t* m, ffbi_scratch_t* scratch)
+int ffbi_vec_set(ffbi_vec_t* v, uint32_t index, ffbi_t* src)
 {
-	if(m->num_used_digits == 1 && m->digits[0] == 1)
+	if(index >= v->count || ffbi_trim_len(src->digits, src->num_used_digits) > v->num_digits)
 	{
-		dest->num_used_digits = 1;
-		dest->digits[0] = 0;
-		return;
+		fflog_debug_print("index out of range or src too large.\n");
+		return 1;
 	}
-	uint8_t free_scratches = 0;
-	if(scratch == NULL)
+	ffbi_vec_scatter(v, index, src);
+	return 0;
+}
+
+//Propagates the carries of every value in v, dropping carries out of the top digit.
+static void ffbi_vec_carry(ffbi_vec_t* v)
+{
+	uint32_t count = v->count;
+	for(uint32_t i=0;i+1<v->num_digits;i++)
 	{
-		scratch = ffbi_scratch_create();
-		free_scratches = 1;
+		ffbi_word_t* limb = ffbi_vec_limb(v, i);
+		ffbi_word_t* next = limb + v->stride;
+		for(uint32_t j=0;j<count;j++)
+		{
+			next[j] += limb[j] >> FFBI_BITS_PER_DIGIT;
+			limb[j] &= _digit_max;
+		}
 	}
-	uint32_t num_digits = m->num_used_digits+n->num_used_digits;
-	ffbi_scratch_prepare(scratch, FFBI_MOD_POW_NUM_SCRATCHES, (int)num_digits);
-	ffbi_t* ret = dest;
-	if(ret->num_allocated_digits < num_digits)
-		ffbi_reallocate_digits(ret, num_digits, 0);
-	ret->num_used_digits = 1;
-	ret->digits[0] = 1;
-	ret->cache_valid = 0;
-	ffbi_t* x = scratch->val[0];
-	ffbi_copy(x, e);
-	ffbi_t* apow = scratch->val[1];
-	ffbi_copy(apow, n);
-	while(x->num_used_digits > 1 || x->digits[0] > 0)
+	ffbi_word_t* top = ffbi_vec_limb(v, v->num_digits-1);
+	for(uint32_t j=0;j<count;j++)
+		top[j] &= _digit_max;
+}
+
+void ffbi_vec_add(ffbi_vec_t* dest, ffbi_vec_t* a, ffbi_vec_t* b)
+{
+	if(a->count != dest->count || b->count != dest->count)
+	{
+		fflog_debug_print("vectors must have the same count.\n");
+		return;
+	}
+	uint32_t count = dest->count;
+	for(uint32_t i=0;i<dest->num_digits;i++)
 	{
-		if(x->digits[0]&1)
+		ffbi_word_t* d = ffbi_vec_limb(dest, i);
+		if(i < a->num_digits && i < b->num_digits)
 		{
-			ffbi_mul(scratch->val[2], ret, apow);
-			ffbi_div_impl(scratch->val[5], scratch->val[2], m, ret, scratch->val[3], scratch->val[4]);
+			ffbi_word_t* x = ffbi_vec_limb(a, i);
+			ffbi_word_t* y = ffbi_vec_limb(b, i);
+			for(uint32_t j=0;j<count;j++)
+				d[j] = x[j] + y[j];
 		}
-		ffbi_word_t carry = 0;
-		for(int i=x->num_used_digits-1;i>=0;i--)
+		else if(i < a->num_digits || i < b->num_digits)
 		{
-			x->digits[i] += carry << FFBI_BITS_PER_DIGIT;
-			carry = x->digits[i]&1;
-			x->digits[i]>>=1;
+			if(d != ffbi_vec_limb(i < a->num_digits ? a : b, i))
+				memcpy(d, ffbi_vec_limb(i < a->num_digits ? a : b, i), count*sizeof(ffbi_word_t));
 		}
-		if(x->num_used_digits > 1 && x->digits[x->num_used_digits-1] == 0)
-			x->num_used_digits--;
-		ffbi_mul(scratch->val[2], apow, apow);
-		ffbi_div_impl(scratch->val[5], scratch->val[2], m, apow, scratch->val[3], scratch->val[4]);
+		else
+			memset(d, 0, count*sizeof(ffbi_word_t));
 	}
-	x->cache_valid = 0;
-	if(free_scratches)
-		ffbi_scratch_destroy(scratch);
+	ffbi_vec_carry(dest);
 }
 
-//[modular multiplicative inverse] dest = multiplicative inverse of a mod m.
-void ffbi_mod_inv(ffbi_t* dest, ffbi_t* a, ffbi_t* m)
+void ffbi_vec_mul(ffbi_vec_t* dest, ffbi_vec_t* a, ffbi_vec_t* b)
 {
-	if(dest->num_allocated_digits < m->num_used_digits)
-		ffbi_reallocate_digits(dest, m->num_used_digits, 0);
-	if(m->num_used_digits == 1 && m->digits[0] == 1)
+	if(a->count != dest->count || b->count != dest->count)
 	{
-		dest->num_used_digits = 1;
-		dest->digits[0] = 0;
-		dest->cache_valid = 0;
+		fflog_debug_print("vectors must have the same count.\n");
 		return;
 	}
-	ffbi_t* m_temp = ffbi_create_from_bigint(m);
-	ffbi_t* a_temp = ffbi_create_from_bigint(a);
-	ffbi_t* t = ffbi_create_reserved_digits(m->num_used_digits);
-	ffbi_t* y = ffbi_create_reserved_digits(m->num_used_digits);
-	ffbi_t* x = ffbi_create_reserved_digits(m->num_used_digits);
-	x->num_used_digits = 1;
-	x->digits[0] = 1;
-	ffbi_t* q = ffbi_create_reserved_digits(m->num_used_digits);
-	ffbi_t* scratch = ffbi_create_reserved_digits(m->num_used_digits+1);
-	ffbi_t* scratch2 = ffbi_create_reserved_digits(m->num_used_digits+1);
-	ffbi_t* temp = ffbi_create_reserved_digits(m->num_used_digits);
-	ffbi_t* temp2 = ffbi_create_reserved_digits(m->num_used_digits);
-	uint8_t y_is_negative = 0;
-	uint8_t x_is_negative = 0;
-	while(a_temp->num_used_digits > 1 || a_temp->digits[0] > 1)
+	if(dest == a || dest == b)
 	{
-		ffbi_div_impl(q, a_temp, m_temp, temp, scratch, scratch2);
-		ffbi_copy(a_temp, m_temp);
-		ffbi_copy(m_temp, temp);
-		ffbi_copy(t, y);
-		uint8_t t_is_negative = y_is_negative;
-		ffbi_mul(temp, q, y);
-		int cmp = ffbi_cmp(x, temp);
-		if(cmp == -1)
+		fflog_debug_print("dest should not be the same pointer as a or b.\n");
+		return;
+	}
+	uint32_t count = dest->count;
+	memset(dest->digits, 0, (size_t)dest->num_digits*dest->stride*sizeof(ffbi_word_t));
+	ffbi_word_t min_len = a->num_digits < b->num_digits ? a->num_digits : b->num_digits;
+	//full products fit in a word as long as a column gets fewer of them than the spare bits allow, as in ffbi_acc_mul_add
+	uint8_t split = (min_len << FFBI_BITS_PER_DIGIT) >= FFBI_ACC_MAX_TERMS;
+	for(uint32_t k=0;k<a->num_digits && k<dest->num_digits;k++)
+	{
+		ffbi_word_t* x = ffbi_vec_limb(a, k);
+		for(uint32_t i=0;i<b->num_digits && k+i<dest->num_digits;i++)
 		{
-			if(x_is_negative)
+			ffbi_word_t* y = ffbi_vec_limb(b, i);
+			ffbi_word_t* d = ffbi_vec_limb(dest, k+i);
+			if(!split)
 			{
-				if(y_is_negative)
-				{
-					ffbi_sub(y, temp, x);
-					y_is_negative = 0;
-				}
-				else
-				{
-					ffbi_add(y, x, temp);
-					y_is_negative = 1;
-				}
+				for(uint32_t j=0;j<count;j++)
+					d[j] += x[j] * y[j];
 			}
 			else
 			{
-				if(y_is_negative)
-				{
-					ffbi_add(y, temp, x);
-					y_is_negative = 0;
-				}
-				else
+				ffbi_word_t* d_next = k+i+1 < dest->num_digits ? d + dest->stride : NULL;
+				for(uint32_t j=0;j<count;j++)
 				{
-					ffbi_sub(y, temp, x);
-					y_is_negative = 1;
+					ffbi_word_t p = x[j] * y[j];
+					d[j] += p & _digit_max;
+					if(d_next)
+						d_next[j] += p >> FFBI_BITS_PER_DIGIT;
 				}
 			}
 		}
-		else if(cmp == 1)
+	}
+	ffbi_vec_carry(dest);
+}
+
+void ffbi_vec_mod(ffbi_vec_t* dest, ffbi_vec_t* a, ffbi_t* m, ffbi_workspace_t* ws)
+{
+	if(a->count != dest->count || dest->num_digits < m->num_used_digits)
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return;
+	}
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	ffbi_workspace_reserve(ws, FFBI_VEC_MOD_NUM_VALS, a->num_digits + m->num_used_digits + 1);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* x = ffbi_workspace_get(ws, a->num_digits);
+	ffbi_t* rem = ffbi_workspace_get(ws, a->num_digits + m->num_used_digits);
+	ffbi_t* quotient = ffbi_workspace_get(ws, a->num_digits);
+	ffbi_t* scratch1 = ffbi_workspace_get(ws, m->num_used_digits + 1);
+	ffbi_t* scratch2 = ffbi_workspace_get(ws, m->num_used_digits + 1);
+	for(uint32_t j=0;j<a->count;j++)
+	{
+		ffbi_vec_gather(a, j, x);
+		ffbi_div_impl(quotient, x, m, rem, scratch1, scratch2);
+		ffbi_vec_scatter(dest, j, rem);
+	}
+	ffbi_workspace_pop(ws, frame);
+}
+
+void ffbi_vec_mod_pow(ffbi_vec_t* dest, ffbi_vec_t* n, ffbi_t* e, ffbi_t* m, ffbi_workspace_t* ws)
+{
+	if(n->count != dest->count || dest->num_digits < m->num_used_digits)
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return;
+	}
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	//reserve for ffbi_mod_pow as well, since it can't grow the workspace once a frame is open
+	uint32_t product_digits = (m->num_used_digits > n->num_digits ? m->num_used_digits : n->num_digits)*2+1;
+	ffbi_workspace_reserve(ws, FFBI_MOD_POW_NUM_VALS + FFBI_VEC_MOD_POW_NUM_VALS, product_digits);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* x = ffbi_workspace_get(ws, n->num_digits);
+	ffbi_t* result = ffbi_workspace_get(ws, n->num_digits + m->num_used_digits);
+	for(uint32_t j=0;j<n->count;j++)
+	{
+		ffbi_vec_gather(n, j, x);
+		ffbi_mod_pow(result, x, e, m, ws);
+		ffbi_vec_scatter(dest, j, result);
+	}
+	ffbi_workspace_pop(ws, frame);
+}
+
+int ffbi_vec_serialize(ffbi_vec_t* v, uint8_t* buffer, int record_bytes)
+{
+	ffbi_workspace_t* ws = ffbi_workspace_get_thread();
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* x = ffbi_workspace_get(ws, v->num_digits);
+	int ret = 0;
+	for(uint32_t j=0;j<v->count;j++)
+	{
+		ffbi_vec_gather(v, j, x);
+		if(ffbi_digits_to_bytes<false>(x->digits, x->num_used_digits, buffer + (size_t)j*record_bytes, record_bytes))
 		{
-			if(x_is_negative)
-			{
-				if(y_is_negative)
-					ffbi_sub(y, x, temp);
-				else
-				{
-					ffbi_add(y, x, temp);
-					y_is_negative = 1;
-				}
-			}
-			else
-			{
-				if(y_is_negative)
-				{
-					ffbi_add(y, x, temp);
-					y_is_negative = 0;
-				}
-				else
-					ffbi_sub(y, x, temp);
-			}
+			fflog_debug_print("value %u doesn't fit in %d bytes.\n", j, record_bytes);
+			ret = 1;
+			break;
 		}
-		else
+	}
+	ffbi_workspace_pop(ws, frame);
+	return ret;
+}
+
+int ffbi_vec_deserialize(ffbi_vec_t* v, const uint8_t* buffer, int record_bytes)
+{
+	ffbi_workspace_t* ws = ffbi_workspace_get_thread();
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* x = ffbi_workspace_get(ws, ((uint32_t)record_bytes*8 + FFBI_BITS_PER_DIGIT - 1)/FFBI_BITS_PER_DIGIT + 1);
+	int ret = 0;
+	for(uint32_t j=0;j<v->count;j++)
+	{
+		uint32_t num_digits = ffbi_bytes_to_digits<false>(x->digits, buffer + (size_t)j*record_bytes, record_bytes);
+		if(num_digits == 0)
 		{
-			if(x_is_negative)
-			{
-				if(y_is_negative)
-				{
-					y->num_used_digits = 1;
-					y->digits[0] = 0;
-					y->cache_valid = 0;
-					y_is_negative = 0;
-				}
-				else
-				{
-					ffbi_add(y, x, temp);
-					y_is_negative = 1;
-				}
-			}
-			else
-			{
-				if(y_is_negative)
-				{
-					ffbi_add(y, x, temp);
-					y_is_negative = 0;
-				}
-				else
-				{
-					y->num_used_digits = 1;
-					y->digits[0] = 0;
-					y->cache_valid = 0;
-				}
-			}
+			x->digits[0] = 0;
+			num_digits = 1;
 		}
-		if(y->num_used_digits == 1 && y->digits[0] == 0)
-			y_is_negative = 0;
-		ffbi_copy(x, t);
-		x_is_negative = t_is_negative;
+		x->num_used_digits = ffbi_trim_len(x->digits, num_digits);
+		if(x->num_used_digits > v->num_digits)
+		{
+			fflog_debug_print("value %u doesn't fit in the vector.\n", j);
+			ret = 1;
+			break;
+		}
+		ffbi_vec_scatter(v, j, x);
 	}
-	if(x_is_negative)
-		ffbi_sub(t, m, x);
-	ffbi_copy(dest, t);
-	ffbi_destroy(temp2);
-	ffbi_destroy(x);
-	ffbi_destroy(temp);
-	ffbi_destroy(scratch);
-	ffbi_destroy(scratch2);
-	ffbi_destroy(q);
-	ffbi_destroy(y);
-	ffbi_destroy(t);
-	ffbi_destroy(a_temp);
-	ffbi_destroy(m_temp);
+	ffbi_workspace_pop(ws, frame);
+	return ret;
 }
 
-void ffbi_copy(ffbi_t* dest, ffbi_t* src)
+#define FFBI_MODCTX_MAX_TERMS 8
+//A fold has to take at least this many bits off the value to beat ffbi_div_impl, for Solinas and
+//pseudo-Mersenne moduli respectively.
+#ifndef FFBI_MODCTX_MIN_FOLD_BITS
+#define FFBI_MODCTX_MIN_FOLD_BITS 48
+#endif
+#ifndef FFBI_MODCTX_MIN_PSEUDO_MERSENNE_FOLD_BITS
+#define FFBI_MODCTX_MIN_PSEUDO_MERSENNE_FOLD_BITS 48
+#endif
+#define FFBI_MODCTX_REDUCE_NUM_VALS 4
+#define FFBI_MODCTX_POW_NUM_VALS 2
+
+typedef struct FFBI_MODCTX
 {
-	if(dest->num_allocated_digits < src->num_used_digits)
-		ffbi_reallocate_digits(dest, src->num_used_digits, 0);
-	dest->num_used_digits = src->num_used_digits;
-	memcpy(dest->digits, src->digits, src->num_used_digits*sizeof(ffbi_word_t));
+	ffbi_t* m;
+	uint32_t k; //bits of m
+	int form;
+	ffbi_t* c; //2^k - m, for FFBI_MODCTX_PSEUDO_MERSENNE
+	//2^k - m is the sum of term_signs[i]*2^term_bits[i], for FFBI_MODCTX_SOLINAS
+	uint32_t num_terms;
+	uint32_t term_bits[FFBI_MODCTX_MAX_TERMS];
+	int term_signs[FFBI_MODCTX_MAX_TERMS];
+} ffbi_modctx_t;
+
+//p = p % 2^bits
+static void ffbi_truncate_bits(ffbi_t* p, uint32_t bits)
+{
+	uint32_t d = bits/FFBI_BITS_PER_DIGIT;
+	if(d >= p->num_used_digits)
+		return;
+	p->digits[d] &= (((ffbi_word_t)1) << (bits%FFBI_BITS_PER_DIGIT)) - 1;
+	p->num_used_digits = ffbi_trim_len(p->digits, d + 1);
+	p->cache_valid = 0;
+}
+
+//dest = dest + (a << bits)
+//The shifted digits are added in place, without a temporary for a << bits.
+static void ffbi_add_shl(ffbi_t* dest, ffbi_t* a, uint32_t bits)
+{
+	uint32_t digit_shift = bits/FFBI_BITS_PER_DIGIT;
+	uint32_t bit_shift = bits%FFBI_BITS_PER_DIGIT;
+	uint32_t len = a->num_used_digits + digit_shift + 2;
+	if(len < dest->num_used_digits + 1)
+		len = dest->num_used_digits + 1;
+	if(dest->num_allocated_digits < len && ffbi_reallocate_digits(dest, len, 1))
+		return;
+	memset(dest->digits + dest->num_used_digits, 0, (len - dest->num_used_digits)*sizeof(ffbi_word_t));
+	ffbi_word_t* column = dest->digits + digit_shift;
+	ffbi_word_t carry = 0;
+	uint32_t i;
+	for(i=0;i<a->num_used_digits;i++)
+	{
+		ffbi_word_t v = (a->digits[i] << bit_shift) + column[i] + carry;
+		column[i] = v & _digit_max;
+		carry = v >> FFBI_BITS_PER_DIGIT;
+	}
+	for(;carry != 0;i++)
+	{
+		ffbi_word_t v = column[i] + carry;
+		column[i] = v & _digit_max;
+		carry = v >> FFBI_BITS_PER_DIGIT;
+	}
+	dest->num_used_digits = ffbi_trim_len(dest->digits, len);
 	dest->cache_valid = 0;
 }
 
-int ffbi_is_zero(ffbi_t* p)
+//Writes c in non-adjacent form into the terms of ctx. c is destroyed.
+//Returns 1 if it takes more than FFBI_MODCTX_MAX_TERMS terms, 0 otherwise.
+static int ffbi_modctx_set_terms(ffbi_modctx_t* ctx, ffbi_t* c)
 {
-	if(p->num_used_digits == 1 && p->digits[0] == 0)
-		return 1;
+	uint32_t bit = 0;
+	ctx->num_terms = 0;
+	while(!ffbi_is_zero(c))
+	{
+		uint32_t zeros = ffbi_trailing_zeros(c);
+		ffbi_shr(c, c, zeros);
+		bit += zeros;
+		if(ctx->num_terms == FFBI_MODCTX_MAX_TERMS)
+			return 1;
+		//a run of ones becomes a term for the bit above it and a negative term for its lowest bit
+		int sign = (c->digits[0] & 3) == 3 ? -1 : 1;
+		ctx->term_bits[ctx->num_terms] = bit;
+		ctx->term_signs[ctx->num_terms] = sign;
+		ctx->num_terms++;
+		if(sign < 0)
+			ffbi_add_u(c, c, 1);
+		else
+			c->digits[0]--;
+	}
 	return 0;
 }
+
+//Creates a context of the given form, or the best form of m when form is -1.
+static ffbi_modctx_t* ffbi_modctx_create_impl(ffbi_t* m, int form)
+{
+	if(ffbi_is_zero(m))
+	{
+		fflog_debug_print("m can't be 0.\n");
+		return NULL;
+	}
+	ffbi_modctx_t* ctx = ffmem_alloc(ffbi_modctx_t);
+	ctx->m = ffbi_create_from_bigint(m);
+	ctx->k = ffbi_bit_length(m);
+	ctx->form = FFBI_MODCTX_GENERAL;
+	ctx->c = NULL;
+	ctx->num_terms = 0;
+	ffbi_t* c = ffbi_create();
+	c->digits[0] = 1;
+	ffbi_shl(c, c, ctx->k);
+	ffbi_sub(c, c, m);
+	//a fold has to take a few bits off to make progress at all
+	uint32_t min_fold_bits = form < 0 ? FFBI_MODCTX_MIN_FOLD_BITS : 4;
+	uint32_t min_pseudo_mersenne_fold_bits = form < 0 ? FFBI_MODCTX_MIN_PSEUDO_MERSENNE_FOLD_BITS : 4;
+	uint32_t c_bits = ffbi_bit_length(c);
+	if((form < 0 || form == FFBI_MODCTX_PSEUDO_MERSENNE) && c_bits*2 <= ctx->k && c_bits + min_pseudo_mersenne_fold_bits <= ctx->k)
+	{
+		ctx->form = FFBI_MODCTX_PSEUDO_MERSENNE;
+		ctx->c = c;
+		return ctx;
+	}
+	if((form < 0 || form == FFBI_MODCTX_SOLINAS) && ffbi_modctx_set_terms(ctx, c) == 0 && ctx->term_bits[ctx->num_terms-1] + min_fold_bits <= ctx->k)
+		ctx->form = FFBI_MODCTX_SOLINAS;
+	else
+		ctx->num_terms = 0;
+	ffbi_destroy(c);
+	if(form >= 0 && ctx->form != form)
+	{
+		fflog_debug_print("m doesn't have form %d.\n", form);
+		ffbi_modctx_destroy(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+ffbi_modctx_t* ffbi_modctx_create(ffbi_t* m)
+{
+	return ffbi_modctx_create_impl(m, -1);
+}
+
+ffbi_modctx_t* ffbi_modctx_create_form(ffbi_t* m, int form)
+{
+	return ffbi_modctx_create_impl(m, form);
+}
+
+void ffbi_modctx_destroy(ffbi_modctx_t* ctx)
+{
+	ffbi_destroy(ctx->m);
+	if(ctx->c)
+		ffbi_destroy(ctx->c);
+	ffmem_free(ctx);
+}
+
+int ffbi_modctx_get_form(ffbi_modctx_t* ctx)
+{
+	return ctx->form;
+}
+
+//Folds the bits of x above k back onto it until it fits in k bits. Returns 1 if x now holds the
+//negated value, which Solinas folds with negative terms can produce.
+static int ffbi_modctx_fold(ffbi_modctx_t* ctx, ffbi_t* x, ffbi_t* hi, ffbi_t* neg)
+{
+	int negated = 0;
+	while(ffbi_bit_length(x) > ctx->k)
+	{
+		ffbi_shr(hi, x, ctx->k);
+		ffbi_truncate_bits(x, ctx->k);
+		//x = lo + hi*(2^k - m) is the same value mod m
+		if(ctx->form == FFBI_MODCTX_PSEUDO_MERSENNE)
+		{
+			ffbi_mul_add(x, hi, ctx->c);
+			continue;
+		}
+		neg->num_used_digits = 1;
+		neg->digits[0] = 0;
+		for(uint32_t i=0;i<ctx->num_terms;i++)
+			ffbi_add_shl(ctx->term_signs[i] > 0 ? x : neg, hi, ctx->term_bits[i]);
+		if(ffbi_cmp(x, neg) >= 0)
+			ffbi_sub(x, x, neg);
+		else
+		{
+			ffbi_sub(neg, neg, x);
+			ffbi_copy(x, neg);
+			negated = !negated;
+		}
+	}
+	return negated;
+}
+
+void ffbi_modctx_reduce(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* a, ffbi_workspace_t* ws)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	uint32_t num_digits = a->num_used_digits + ctx->m->num_used_digits + 2;
+	ffbi_workspace_reserve(ws, FFBI_MODCTX_REDUCE_NUM_VALS, num_digits);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* x = ffbi_workspace_get(ws, num_digits);
+	if(ctx->form == FFBI_MODCTX_GENERAL)
+	{
+		//the remainder can't be written over the dividend
+		if(dest == a)
+		{
+			ffbi_copy(x, a);
+			a = x;
+		}
+		ffbi_t* quotient = ffbi_workspace_get(ws, num_digits);
+		ffbi_t* scratch1 = ffbi_workspace_get(ws, ctx->m->num_used_digits + 1);
+		ffbi_t* scratch2 = ffbi_workspace_get(ws, ctx->m->num_used_digits + 1);
+		ffbi_div_impl(quotient, a, ctx->m, dest, scratch1, scratch2);
+		ffbi_workspace_pop(ws, frame);
+		return;
+	}
+	ffbi_copy(x, a);
+	ffbi_t* hi = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* neg = ffbi_workspace_get(ws, num_digits);
+	int negated = ffbi_modctx_fold(ctx, x, hi, neg);
+	//x is below 2^k now, which is less than 2*m
+	while(ffbi_cmp(x, ctx->m) >= 0)
+		ffbi_sub(x, x, ctx->m);
+	if(negated && !ffbi_is_zero(x))
+		ffbi_sub(dest, ctx->m, x);
+	else
+		ffbi_copy(dest, x);
+	ffbi_workspace_pop(ws, frame);
+}
+
+void ffbi_modctx_mul(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_workspace_t* ws)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	uint32_t num_digits = a->num_used_digits + b->num_used_digits + 1;
+	ffbi_workspace_reserve(ws, FFBI_MODCTX_REDUCE_NUM_VALS + 1, num_digits + ctx->m->num_used_digits + 2);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* product = ffbi_workspace_get(ws, num_digits);
+	ffbi_mul(product, a, b);
+	ffbi_modctx_reduce(ctx, dest, product, ws);
+	ffbi_workspace_pop(ws, frame);
+}
+
+void ffbi_modctx_sqr(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* a, ffbi_workspace_t* ws)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	ffbi_modctx_mul(ctx, dest, a, a, ws);
+}
+
+void ffbi_modctx_pow(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* n, ffbi_t* e, ffbi_workspace_t* ws)
+{
+	FFBI_RETURN_IF_VIEW(dest);
+	FFBI_STATS_COUNT(FFBI_STATS_MOD_POW);
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	uint32_t m_digits = ctx->m->num_used_digits;
+	uint32_t num_digits = (n->num_used_digits > m_digits ? n->num_used_digits : m_digits)*3 + 3;
+	ffbi_workspace_reserve(ws, FFBI_MODCTX_POW_NUM_VALS + FFBI_MODCTX_REDUCE_NUM_VALS + 1, num_digits);
+	uint32_t frame = ffbi_workspace_push(ws);
+	ffbi_t* apow = ffbi_workspace_get(ws, num_digits);
+	ffbi_t* one = ffbi_workspace_get(ws, 1);
+	ffbi_modctx_reduce(ctx, apow, n, ws);
+	one->digits[0] = 1;
+	ffbi_modctx_reduce(ctx, dest, one, ws);
+	uint32_t e_bits = ffbi_bit_length(e);
+	for(uint32_t i=0;i<e_bits;i++)
+	{
+		if(ffbi_test_bit(e, i))
+			ffbi_modctx_mul(ctx, dest, dest, apow, ws);
+		if(i + 1 < e_bits)
+			ffbi_modctx_sqr(ctx, apow, apow, ws);
+	}
+	ffbi_workspace_pop(ws, frame);
+}
@@ -9,6 +9,15 @@
 #define FFBI_H_
 
 #include <stdint.h>
+#include "ffrand.h"
+
+//Thresholds measured on the host by tools/ffbi_tune.cpp, if it has been run. Each one replaces the
+//default of the same name in the library sources.
+#if defined(__has_include)
+#if __has_include("ffbi_tune.h")
+#include "ffbi_tune.h"
+#endif
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,12 +34,78 @@ typedef uint64_t ffbi_word_t;
 #endif
 
 typedef struct FFBI ffbi_t;
-typedef struct FFBI_SCRATCH ffbi_scratch_t;
-
-//Run this function before any other library function.
-//The only time omitting this initialization may cause problems is when this library is used in multiple threads.
+//A view is a read-only bigint. It may be passed as any input operand, but never as a destination.
+//Functions given a view to write to log an error and leave it as it was.
+typedef struct FFBI ffbi_view_t;
+typedef struct FFBI_SIEVE ffbi_sieve_t;
+typedef struct FFBI_WORKSPACE ffbi_workspace_t;
+typedef struct FFBI_CTX ffbi_ctx_t;
+typedef struct FFBI_ACC ffbi_acc_t;
+typedef struct FFBI_VEC ffbi_vec_t;
+typedef struct FFBI_MODCTX ffbi_modctx_t;
+
+//Kept for compatibility. The library has no global mutable state, so no initialization is needed
+//and any function may be called from any number of threads, as long as no bigint, workspace or
+//context is used by two threads at once. Sieves are read-only and may be shared.
 void ffbi_init();
 
+//A context holds the mutable state ffbi uses on behalf of a thread: the default workspace and
+//the random stream. Each thread gets its own context on first use, destroyed when the thread exits.
+ffbi_ctx_t* ffbi_ctx_create();
+void ffbi_ctx_destroy(ffbi_ctx_t* ctx);
+
+//Returns the calling thread's current context.
+ffbi_ctx_t* ffbi_ctx_get_thread();
+
+//Makes ctx the calling thread's current context and returns the previous one, or NULL if it was
+//the thread's own. Pass NULL to switch back to the thread's own context.
+ffbi_ctx_t* ffbi_ctx_set_thread(ffbi_ctx_t* ctx);
+
+//Frees the calling thread's own context. It is created again on next use.
+void ffbi_ctx_release_thread();
+
+//Returns the workspace of ctx, creating it on first use.
+ffbi_workspace_t* ffbi_ctx_get_workspace(ffbi_ctx_t* ctx);
+
+//While r is set, random values drawn with ctx current come from r instead of the thread's CSPRNG.
+//ctx doesn't take ownership of r. Returns the previous stream. Pass NULL to go back to the CSPRNG.
+ffrand_t* ffbi_ctx_set_rand(ffbi_ctx_t* ctx, ffrand_t* r);
+
+//Operations counted by ffbi_stats_snapshot. Squaring is a multiplication of a bigint by itself.
+#define FFBI_STATS_MUL 0
+#define FFBI_STATS_SQR 1
+#define FFBI_STATS_DIV 2
+#define FFBI_STATS_MOD_POW 3
+#define FFBI_STATS_MOD_INV 4
+#define FFBI_STATS_NUM_OPS 5
+
+//Counters of one operation. Work is charged to the operation doing it and to every operation it was
+//called from, so the limb operations of ffbi_mod_pow include those of the multiplications and divisions
+//it runs, which are counted under FFBI_STATS_MUL, FFBI_STATS_SQR and FFBI_STATS_DIV as well.
+typedef struct FFBI_OP_STATS
+{
+	uint64_t calls;
+	uint64_t limb_ops; //digit by digit products of the schoolbook algorithms
+	uint64_t reallocations; //times ffbi_reallocate_digits changed the storage of a bigint
+	uint64_t bytes_moved; //digits read and written, and digits copied by reallocations
+} ffbi_op_stats_t;
+
+typedef struct FFBI_STATS
+{
+	ffbi_op_stats_t ops[FFBI_STATS_NUM_OPS];
+	//all reallocations of the context, whether an operation was running or not
+	uint64_t reallocations;
+	uint64_t bytes_reallocated;
+} ffbi_stats_t;
+
+//Operations are only counted if the library is built with FFBI_STATS_ENABLED defined to 1. The counters
+//belong to the calling thread's current context, like its workspace.
+//Copies the counters into stats and returns 1, or zeroes stats and returns 0 if counting is compiled out.
+int ffbi_stats_snapshot(ffbi_stats_t* stats);
+
+//Sets the counters of the calling thread's current context to 0.
+void ffbi_stats_reset();
+
 //Create a new bigint with value of 0.
 ffbi_t* ffbi_create();
 
@@ -46,6 +121,27 @@ ffbi_t* ffbi_create_reserved_digits(uint32_t digits);
 //be aborted.
 ffbi_t* ffbi_create_preallocated(uint8_t* buffer, int size_bytes);
 
+//Create a new bigint with value of 0 whose digits live in a shared mapping of the file at path instead
+//of the heap, for values that don't fit in memory. The file is created or truncated, sized for bits
+//bits, and grows with the value. Pass NULL for path to use an unlinked temporary file in $TMPDIR or /tmp.
+//The file only holds the digits while the bigint exists. Multiplications involving a mapped bigint
+//walk it in tiles and tell the kernel which parts are needed next, and an in-place one keeps its
+//temporary product in a mapped file as well. Destroy it with ffbi_destroy.
+//NULL is returned on error.
+ffbi_t* ffbi_create_mapped(const char* path, uint32_t bits);
+
+//Create a view with value of 0. Destroy it with ffbi_destroy.
+ffbi_view_t* ffbi_view_create();
+
+//Points v at num_digits caller-owned digits in the format of ffbi_get_digits, without copying.
+//The digits must stay valid and unchanged while v refers to them.
+void ffbi_view_set_digits(ffbi_view_t* v, const ffbi_word_t* digits, uint32_t num_digits);
+
+//Sets v to the value of a little endian byte array, as ffbi_deserialize would. Since digits
+//don't fall on byte boundaries, the bytes are unpacked a word at a time into storage owned by v,
+//which is reused by later calls and only grows past 2048 bits.
+void ffbi_view_set_bytes(ffbi_view_t* v, const uint8_t* buffer, int size_bytes);
+
 //Gets the array that p uses to store digits. This can be directly manipulated but not freed by the user.
 //digits, num_used_digits, num_allocated_digits and bits_per_digit are outputs. All params are required.
 void ffbi_get_digits(ffbi_t* p, ffbi_word_t** digits, uint32_t* num_used_digits, uint32_t* num_allocated_digits, uint32_t* bits_per_digit);
@@ -55,14 +151,46 @@ void ffbi_get_digits(ffbi_t* p, ffbi_word_t** digits, uint32_t* num_used_digits,
 //gets used internally. This library will then become responsible for freeing it.
 void ffbi_set_digits(ffbi_t* p, ffbi_word_t* digits, uint32_t num_used_digits, uint32_t num_allocated_digits, uint32_t bits_per_digit);
 
-//Create and destroy scratch space used in operation optimizations.
-ffbi_scratch_t* ffbi_scratch_create();
-void ffbi_scratch_destroy(ffbi_scratch_t* scratch);
+//Create and destroy a workspace holding the temporary bigints of operations. Bigints are handed
+//out from one contiguous block in nested frames, so operations don't allocate once it is big enough.
+//A workspace must only be used by one thread at a time.
+ffbi_workspace_t* ffbi_workspace_create();
+void ffbi_workspace_destroy(ffbi_workspace_t* ws);
 
-//Create a sieve for primality testing.
+//Makes sure ws can hand out num_vals more bigints of num_digits digits each without allocating.
+//This only takes effect when no frames are open.
+void ffbi_workspace_reserve(ffbi_workspace_t* ws, uint32_t num_vals, uint32_t num_digits);
+
+//Opens a frame. Every bigint handed out after this call is given back by ffbi_workspace_pop
+//with the returned frame. Frames must be popped in the reverse order they were pushed.
+uint32_t ffbi_workspace_push(ffbi_workspace_t* ws);
+void ffbi_workspace_pop(ffbi_workspace_t* ws, uint32_t frame);
+
+//Returns a bigint with value of 0 and at least num_digits allocated digits that stays valid until
+//its frame is popped. It is owned by ws, so don't destroy it. Returns NULL if the digits can't be
+//allocated.
+ffbi_t* ffbi_workspace_get(ffbi_workspace_t* ws, uint32_t num_digits);
+
+//Returns the workspace of the calling thread's current context, used when NULL is passed for a workspace.
+ffbi_workspace_t* ffbi_workspace_get_thread();
+
+//Frees the workspace of the calling thread's current context. It is created again on next use.
+void ffbi_workspace_release_thread();
+
+//Create and destroy a sieve for primality testing.
+ffbi_sieve_t* ffbi_sieve_create();
+void ffbi_sieve_destroy(ffbi_sieve_t* sieve);
+
+//Fill a sieve for primality testing.
 //n is the max possible prime value that the sieve contains.
-//A recommended value is at least 100000. NULL is returned on error.
-void ffbi_get_sieve(ffbi_scratch_t* sieve, uint32_t n);
+//A recommended value is at least 100000.
+void ffbi_get_sieve(ffbi_sieve_t* sieve, uint32_t n);
+
+//Multiplies the primes of a sieve filled by ffbi_get_sieve into primorials of at most
+//primorial_bits bits each and keeps them in the sieve. ffbi_is_large_prime then rejects
+//composites with one ffbi_gcd per primorial instead of one division per sieve prime.
+//Primorials that fit in a single digit are the cheapest to test against.
+void ffbi_get_sieve_primorials(ffbi_sieve_t* sieve, uint32_t primorial_bits);
 
 //Generate a random bigint with specified number of bits.
 void ffbi_random(ffbi_t* p, uint32_t bits);
@@ -78,7 +206,20 @@ void ffbi_random_with_limit(ffbi_t* p, ffbi_t* limit);
 //composites before the Fermat primality test. Pass NULL for sieve to skip
 //the sieve test. It is an error if the number of bits specified can't hold
 //a value of at least 16^8. NULL is returned on error.
-ffbi_t* ffbi_create_random_large_prime(uint32_t bits, uint32_t num_tests, ffbi_scratch_t* sieve);
+ffbi_t* ffbi_create_random_large_prime(uint32_t bits, uint32_t num_tests, ffbi_sieve_t* sieve);
+
+//Same as ffbi_create_random_large_prime, but candidates are generated and tested on num_threads
+//worker threads, each with its own workspace and its own thread's random number generator. The first
+//prime found cancels the other workers. The sieve is only read, so one sieve may be shared by concurrent searches.
+//NULL is returned on error.
+ffbi_t* ffbi_create_random_large_prime_parallel(uint32_t bits, uint32_t num_tests, ffbi_sieve_t* sieve, uint32_t num_threads);
+
+//Same as ffbi_create_random_large_prime_parallel, but every random value is derived from seed
+//through SHAKE256 instead of the system random number generator. Candidates are numbered and
+//each one is built from its own stream of the seed. The prime with the lowest number is returned,
+//so the same seed produces a bit-identical prime across runs and for any num_threads.
+//NULL is returned on error.
+ffbi_t* ffbi_create_seeded_large_prime(uint32_t bits, uint32_t num_tests, ffbi_sieve_t* sieve, const uint8_t* seed, int seed_len, uint32_t num_threads);
 
 //Create a new bigint by making a copy of p. NULL is returned on error.
 ffbi_t* ffbi_create_from_bigint(ffbi_t* p);
@@ -95,18 +236,18 @@ void ffbi_reallocate(ffbi_t* p, uint32_t target_bits);
 
 //Pass 1 for retain_value if retaining the value is important. Passing 0
 //will result in memory copying and extra checks to see if target_num_digits
-//should be respected.
-void ffbi_reallocate_digits(ffbi_t* p, int target_num_digits, uint8_t retain_value);
+//should be respected. Returns 0 on success and 1 on error, in which case p is left as it was.
+int ffbi_reallocate_digits(ffbi_t* p, int target_num_digits, uint8_t retain_value);
 
 //Uses Fermat primality test to determine if p is prime. Increase
 //num_tests for higher chance p is actually prime. Probability of p being wrongly
 //detected as prime is 2^(-num_tests). If p is less than 16^8, it is not considered
 //large enough and will return false. A sieve may be optionally provided to quickly
 //weed out composites before the Fermat primality test. Pass NULL for sieve to skip
-//the sieve test. 1 is returned if p is prime and 0 is returned if otherwise.
-//scratch contains memory buffers used internally to minimize unnecessary allocations
-//for use in tight loops. Pass NULL for scratch for no optimizations.
-int ffbi_is_large_prime(ffbi_t* p, int num_tests, ffbi_scratch_t* sieve, ffbi_scratch_t* scratch);
+//the sieve test. If the sieve holds primorials from ffbi_get_sieve_primorials, p is checked
+//with one gcd per primorial instead. 1 is returned if p is prime and 0 is returned if otherwise.
+//Temporaries come from ws. Pass NULL for ws to use the thread's default workspace.
+int ffbi_is_large_prime(ffbi_t* p, int num_tests, ffbi_sieve_t* sieve, ffbi_workspace_t* ws);
 
 //Returns the size of the buffer necessary to hold the serialized bigint p in bytes.
 int ffbi_get_serialized_size(ffbi_t* p);
@@ -122,8 +263,53 @@ int ffbi_serialize_v2(ffbi_t* p, uint8_t* buffer, int size_bytes, uint32_t total
 //Deserializes buffer into bigint p.
 void ffbi_deserialize(ffbi_t* p, uint8_t* buffer, int size_bytes);
 
+//Writes p into buffer as exactly size_bytes big endian bytes, left padded with zeros, as I2OSP
+//does for a modulus of that length. Returns 1 if p doesn't fit, 0 otherwise.
+int ffbi_export_be(ffbi_t* p, uint8_t* buffer, int size_bytes);
+
+//Sets p to the value of size_bytes big endian bytes, as OS2IP.
+void ffbi_import_be(ffbi_t* p, const uint8_t* buffer, int size_bytes);
+
 uint32_t ffbi_get_significant_bits(ffbi_t* p);
 
+//Returns the number of bits needed to hold p, which is 0 if p is 0. Only looks at the top digit.
+uint32_t ffbi_bit_length(ffbi_t* p);
+
+//Returns bit number bit of p, counting from the least significant bit.
+int ffbi_test_bit(ffbi_t* p, uint32_t bit);
+
+//Returns the number of bits of p that are set.
+uint32_t ffbi_popcount(ffbi_t* p);
+
+//[shift left] dest = a << bits
+//dest can point to the same bigint as a.
+void ffbi_shl(ffbi_t* dest, ffbi_t* a, uint32_t bits);
+
+//[shift right] dest = a >> bits
+//dest can point to the same bigint as a.
+void ffbi_shr(ffbi_t* dest, ffbi_t* a, uint32_t bits);
+
+//[bitwise and, or, xor] dest = a & b, a | b, a ^ b
+//dest can point to the same bigint as a and b.
+void ffbi_and(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
+void ffbi_or(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
+void ffbi_xor(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
+
+//Returns the size of the buffer, including the terminating null, that ffbi_to_string needs to
+//hold p in base 10 or 16. For base 10 the size may be one more than what is actually written.
+//Returns 0 for other bases.
+int ffbi_get_string_size(ffbi_t* p, int base);
+
+//Writes p into buffer as a null terminated string in base 10 or 16, with lowercase hex digits and no
+//prefix. Returns the number of characters written, not counting the null. Returns -1 if size_bytes is
+//less than ffbi_get_string_size and 0 for other errors. Temporaries come from the thread's default workspace.
+int ffbi_to_string(ffbi_t* p, char* buffer, int size_bytes, int base);
+
+//Sets p to the value of the first len characters of str in base 10 or 16. Pass -1 for len if str is
+//null terminated. Hex digits may be either case. Returns 0 on success and 1 if str is empty or has
+//characters that aren't digits of the base, in which case p is left as it is.
+int ffbi_from_string(ffbi_t* p, const char* str, int len, int base);
+
 //Prints the base 10 string representation of p into stdout.
 void ffbi_print(ffbi_t* p);
 
@@ -146,19 +332,29 @@ void ffbi_add_u(ffbi_t* dest, ffbi_t* a, uint32_t b);
 void ffbi_sub(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
 
 //[multiplication] dest = a * b
-//dest can point to the same bigint as a and b, but will result in an extra internal allocation.
+//dest can point to the same bigint as a and b, in which case the product is built in the thread's default workspace.
 void ffbi_mul(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
 
+//[multiply-add] dest = dest + a * b
+//The products are added into the digits of dest in a single pass, without a temporary product.
+//dest can point to the same bigint as a or b, in which case a copy of it is made in the thread's default workspace.
+void ffbi_mul_add(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
+
 //[division] dest = a / b
 //dest should not be the same pointer as any other arguments.
 void ffbi_div(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
 
 //scratch 1 and 2 are user allocated bigints that has at least b's number of digits plus 1 used for
 //internal calculations. This is required.
-//remainder may be NULL if user does not need it, in which case an extra allocation takes place internally.
+//remainder may be NULL if user does not need it, in which case it comes from the thread's default workspace.
 //Returns 0 on success and 1 on error. dest may not be NULL or point to another argument.
 int ffbi_div_impl(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_t* remainder, ffbi_t* scratch1, ffbi_t* scratch2);
 
+//Divisions keep a converted copy of the divisor in it, built on first use. Building it ahead of time
+//makes later divisions by p only read p, so p may then be used as a divisor by several threads at
+//once, as long as none of them changes p.
+void ffbi_prepare_divisor(ffbi_t* p);
+
 //[mod] dest = a % b
 //dest should not be the same pointer as any other arguments.
 void ffbi_mod(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
@@ -166,13 +362,128 @@ void ffbi_mod(ffbi_t* dest, ffbi_t* a, ffbi_t* b);
 //[modular exponentiation] dest = (n ^ e) % m
 //dest should also have m's + n's number of digits to avoid a reallocation.
 //dest should not be the same pointer as any other arguments.
-void ffbi_mod_pow(ffbi_t* dest, ffbi_t* n, ffbi_t* e, ffbi_t* m, ffbi_scratch_t* scratch);
+//Temporaries come from ws. Pass NULL for ws to use the thread's default workspace.
+void ffbi_mod_pow(ffbi_t* dest, ffbi_t* n, ffbi_t* e, ffbi_t* m, ffbi_workspace_t* ws);
+
+//[greatest common divisor] dest = gcd(a, b)
+//scratch is a user allocated bigint used for internal calculations. This is required.
+//dest and scratch should not be the same pointer as any other arguments.
+void ffbi_gcd(ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_t* scratch);
 
 //[modular multiplicative inverse] dest = multiplicative inverse of a mod m.
 void ffbi_mod_inv(ffbi_t* dest, ffbi_t* a, ffbi_t* m);
 
 int ffbi_is_zero(ffbi_t* p);
 
+//An accumulator sums bigints and products of bigints without propagating carries. Since a digit
+//only takes FFBI_BITS_PER_DIGIT bits of its word, each column soaks up the sums and carries are only
+//propagated on ffbi_acc_get, or when a column is about to run out of headroom. Use it for sums of
+//products, where a loop of ffbi_mul and ffbi_add would normalize after every step.
+//bits is the expected size of the result. The accumulator grows past it as needed.
+ffbi_acc_t* ffbi_acc_create(uint32_t bits);
+void ffbi_acc_destroy(ffbi_acc_t* acc);
+
+//Sets the value of acc to 0.
+void ffbi_acc_clear(ffbi_acc_t* acc);
+
+//acc += a
+void ffbi_acc_add(ffbi_acc_t* acc, ffbi_t* a);
+
+//acc += a * b
+void ffbi_acc_mul_add(ffbi_acc_t* acc, ffbi_t* a, ffbi_t* b);
+
+//Propagates all pending carries. The value of acc is unchanged.
+void ffbi_acc_normalize(ffbi_acc_t* acc);
+
+//dest = acc. acc is normalized and keeps its value.
+void ffbi_acc_get(ffbi_acc_t* acc, ffbi_t* dest);
+
+//A vector holds count bigints of up to bits bits each in one cache line aligned allocation. The values
+//are stored limb by limb, with digit i of every value next to each other, so batch operations
+//stream through memory instead of chasing count separate ffbi_t allocations. All values start at 0.
+//NULL is returned on error.
+ffbi_vec_t* ffbi_vec_create(uint32_t count, uint32_t bits);
+void ffbi_vec_destroy(ffbi_vec_t* v);
+
+uint32_t ffbi_vec_get_count(ffbi_vec_t* v);
+
+//Returns the number of digits every value of v has room for.
+uint32_t ffbi_vec_get_num_digits(ffbi_vec_t* v);
+
+//Copies value index of v into dest.
+void ffbi_vec_get(ffbi_vec_t* v, uint32_t index, ffbi_t* dest);
+
+//Copies src into value index of v. Returns 1 if index is out of range or src doesn't fit, 0 otherwise.
+int ffbi_vec_set(ffbi_vec_t* v, uint32_t index, ffbi_t* src);
+
+//The batch operations below work on every value of vectors with the same count. Like fixed-width
+//integers, results that don't fit in dest's digits are truncated to them.
+
+//[addition] dest[j] = a[j] + b[j]
+//dest can point to the same vector as a and b.
+void ffbi_vec_add(ffbi_vec_t* dest, ffbi_vec_t* a, ffbi_vec_t* b);
+
+//[multiplication] dest[j] = a[j] * b[j]
+//dest should not be the same pointer as a or b, and needs the digits of a and b combined to hold full products.
+void ffbi_vec_mul(ffbi_vec_t* dest, ffbi_vec_t* a, ffbi_vec_t* b);
+
+//[mod] dest[j] = a[j] % m
+//dest can point to the same vector as a, and needs at least m's number of digits.
+//Temporaries come from ws. Pass NULL for ws to use the thread's default workspace.
+void ffbi_vec_mod(ffbi_vec_t* dest, ffbi_vec_t* a, ffbi_t* m, ffbi_workspace_t* ws);
+
+//[modular exponentiation] dest[j] = (n[j] ^ e) % m
+//dest can point to the same vector as n, and needs at least m's number of digits.
+//Temporaries come from ws. Pass NULL for ws to use the thread's default workspace.
+void ffbi_vec_mod_pow(ffbi_vec_t* dest, ffbi_vec_t* n, ffbi_t* e, ffbi_t* m, ffbi_workspace_t* ws);
+
+//Writes every value of v as a little endian record of exactly record_bytes bytes, zero padded,
+//into buffer, which must hold count*record_bytes bytes. Returns 1 if a value doesn't fit, 0 otherwise.
+int ffbi_vec_serialize(ffbi_vec_t* v, uint8_t* buffer, int record_bytes);
+
+//Reads count little endian records of record_bytes bytes each from buffer into v.
+//Returns 1 if a value doesn't fit in v, 0 otherwise.
+int ffbi_vec_deserialize(ffbi_vec_t* v, const uint8_t* buffer, int record_bytes);
+
+//Forms of moduli a modctx reduces by. m = 2^k - c where k is the number of bits of m.
+//Pseudo-Mersenne moduli have c of at most k/2 bits. Solinas moduli have a c that is a sum or difference
+//of a few powers of two, all well below 2^k. Moduli whose c comes too close to 2^k for a fold to beat
+//division, such as the NIST prime P-256, are detected as general ones.
+//Values are reduced by folding the bits above k back onto the rest, multiplied by c, which only
+//takes shifts, adds and a small multiply. Other moduli fall back to ffbi_div_impl.
+#define FFBI_MODCTX_GENERAL 0
+#define FFBI_MODCTX_PSEUDO_MERSENNE 1
+#define FFBI_MODCTX_SOLINAS 2
+
+//Creates a context for arithmetic mod m, detecting the form of m. m is copied. NULL is returned if m is 0.
+ffbi_modctx_t* ffbi_modctx_create(ffbi_t* m);
+
+//Same as ffbi_modctx_create, but uses the given form even where detection would judge the folds too
+//short to pay off. NULL is returned if m doesn't have that form.
+ffbi_modctx_t* ffbi_modctx_create_form(ffbi_t* m, int form);
+void ffbi_modctx_destroy(ffbi_modctx_t* ctx);
+
+//Returns the form of the modulus of ctx, one of FFBI_MODCTX_GENERAL, FFBI_MODCTX_PSEUDO_MERSENNE or FFBI_MODCTX_SOLINAS.
+int ffbi_modctx_get_form(ffbi_modctx_t* ctx);
+
+//The functions below take temporaries from ws. Pass NULL for ws to use the thread's default workspace.
+
+//[mod] dest = a % m
+//dest can point to the same bigint as a.
+void ffbi_modctx_reduce(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* a, ffbi_workspace_t* ws);
+
+//[modular multiplication] dest = (a * b) % m
+//dest can point to the same bigint as a and b.
+void ffbi_modctx_mul(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* a, ffbi_t* b, ffbi_workspace_t* ws);
+
+//[modular squaring] dest = (a * a) % m
+//dest can point to the same bigint as a.
+void ffbi_modctx_sqr(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* a, ffbi_workspace_t* ws);
+
+//[modular exponentiation] dest = (n ^ e) % m
+//dest can point to the same bigint as n, but not e.
+void ffbi_modctx_pow(ffbi_modctx_t* ctx, ffbi_t* dest, ffbi_t* n, ffbi_t* e, ffbi_workspace_t* ws);
+
 #ifdef __cplusplus
 }
 #endif
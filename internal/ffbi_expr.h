@@ -0,0 +1,336 @@
+/*
+ * ffbi_expr.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jesse Wang
+ */
+
+#ifndef FFBI_EXPR_H_
+#define FFBI_EXPR_H_
+
+//Expression templates over ffbi. Arithmetic on ffbi_var builds the expression as a type at
+//compile time, and nothing is computed until it is assigned. The whole expression is then
+//evaluated in one frame of a workspace:
+//
+//	ffbi_var r(pr), a(pa), b(pb), c(pc), m(pm);
+//	r = (a*b + c) % m;
+//
+//Leaves are used in place. Products inside a sum are multiply-added into the sum with ffbi_mul_add
+//instead of being materialized, a % m divides its operand with ffbi_div_impl, and ffbi_pow(n, e) % m
+//runs ffbi_mod_pow. Intermediate values come from the workspace, so nothing is allocated once it
+//has grown to fit. Negative values aren't supported, so a - b needs a >= b.
+
+#include "ffbi.h"
+#include <stddef.h>
+
+template<typename E>
+struct ffbi_expr
+{
+	const E& self() const
+	{
+		return *static_cast<const E*>(this);
+	}
+};
+
+//Evaluates e into a temporary from ws, unless e is a leaf, which is returned as is.
+template<typename E>
+inline ffbi_t* ffbi_expr_operand(const E& e, ffbi_workspace_t* ws)
+{
+	ffbi_t* t = ffbi_workspace_get(ws, e.num_digits() + 1);
+	e.eval(t, ws);
+	return t;
+}
+
+//dest += e for expressions that have nothing better to do than to be evaluated first.
+template<typename E>
+inline void ffbi_expr_add_to(ffbi_t* dest, const E& e, ffbi_workspace_t* ws)
+{
+	ffbi_add(dest, dest, e.operand(ws));
+}
+
+//A bigint owned by the caller, used as a leaf of expressions and as the target of assignments.
+struct ffbi_var : ffbi_expr<ffbi_var>
+{
+	static constexpr uint32_t num_vals = 0;
+	ffbi_t* p;
+
+	explicit ffbi_var(ffbi_t* p) : p(p) {}
+	ffbi_var(const ffbi_var& v) = default;
+
+	//Copies the value of v, like ffbi_copy. The bigint p refers to doesn't change.
+	ffbi_var& operator=(const ffbi_var& v)
+	{
+		if(p != v.p)
+			ffbi_copy(p, v.p);
+		return *this;
+	}
+
+	template<typename E>
+	ffbi_var& operator=(const ffbi_expr<E>& e);
+
+	uint32_t num_digits() const
+	{
+		ffbi_word_t* digits;
+		uint32_t num_used_digits, num_allocated_digits, bits_per_digit;
+		ffbi_get_digits(p, &digits, &num_used_digits, &num_allocated_digits, &bits_per_digit);
+		return num_used_digits;
+	}
+	int uses(const ffbi_t* q) const
+	{
+		return p == q;
+	}
+	void eval(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_copy(dest, p);
+	}
+	ffbi_t* operand(ffbi_workspace_t* ws) const
+	{
+		return p;
+	}
+	void add_to(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_add(dest, dest, p);
+	}
+};
+
+template<typename L, typename R>
+struct ffbi_add_expr : ffbi_expr<ffbi_add_expr<L, R> >
+{
+	static constexpr uint32_t num_vals = L::num_vals + R::num_vals;
+	L l;
+	R r;
+
+	ffbi_add_expr(const L& l, const R& r) : l(l), r(r) {}
+
+	uint32_t num_digits() const
+	{
+		uint32_t a = l.num_digits();
+		uint32_t b = r.num_digits();
+		return (a > b ? a : b) + 1;
+	}
+	int uses(const ffbi_t* q) const
+	{
+		return l.uses(q) || r.uses(q);
+	}
+	void eval(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		l.eval(dest, ws);
+		r.add_to(dest, ws);
+	}
+	ffbi_t* operand(ffbi_workspace_t* ws) const
+	{
+		return ffbi_expr_operand(*this, ws);
+	}
+	void add_to(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		l.add_to(dest, ws);
+		r.add_to(dest, ws);
+	}
+};
+
+template<typename L, typename R>
+struct ffbi_sub_expr : ffbi_expr<ffbi_sub_expr<L, R> >
+{
+	static constexpr uint32_t num_vals = L::num_vals + R::num_vals + 1;
+	L l;
+	R r;
+
+	ffbi_sub_expr(const L& l, const R& r) : l(l), r(r) {}
+
+	uint32_t num_digits() const
+	{
+		return l.num_digits();
+	}
+	int uses(const ffbi_t* q) const
+	{
+		return l.uses(q) || r.uses(q);
+	}
+	void eval(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		l.eval(dest, ws);
+		ffbi_sub(dest, dest, r.operand(ws));
+	}
+	ffbi_t* operand(ffbi_workspace_t* ws) const
+	{
+		return ffbi_expr_operand(*this, ws);
+	}
+	void add_to(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_expr_add_to(dest, *this, ws);
+	}
+};
+
+template<typename L, typename R>
+struct ffbi_mul_expr : ffbi_expr<ffbi_mul_expr<L, R> >
+{
+	static constexpr uint32_t num_vals = L::num_vals + R::num_vals + 2;
+	L l;
+	R r;
+
+	ffbi_mul_expr(const L& l, const R& r) : l(l), r(r) {}
+
+	uint32_t num_digits() const
+	{
+		return l.num_digits() + r.num_digits();
+	}
+	int uses(const ffbi_t* q) const
+	{
+		return l.uses(q) || r.uses(q);
+	}
+	void eval(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_mul(dest, l.operand(ws), r.operand(ws));
+	}
+	ffbi_t* operand(ffbi_workspace_t* ws) const
+	{
+		return ffbi_expr_operand(*this, ws);
+	}
+	void add_to(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_mul_add(dest, l.operand(ws), r.operand(ws));
+	}
+};
+
+//n ^ e. It can only be evaluated modulo something, as ffbi_pow(n, e) % m.
+template<typename N, typename E>
+struct ffbi_pow_expr : ffbi_expr<ffbi_pow_expr<N, E> >
+{
+	static constexpr uint32_t num_vals = N::num_vals + E::num_vals;
+	N n;
+	E e;
+
+	ffbi_pow_expr(const N& n, const E& e) : n(n), e(e) {}
+
+	int uses(const ffbi_t* q) const
+	{
+		return n.uses(q) || e.uses(q);
+	}
+};
+
+template<typename L>
+struct ffbi_mod_expr : ffbi_expr<ffbi_mod_expr<L> >
+{
+	static constexpr uint32_t num_vals = L::num_vals + 4;
+	L l;
+	ffbi_var m;
+
+	ffbi_mod_expr(const L& l, const ffbi_var& m) : l(l), m(m) {}
+
+	uint32_t num_digits() const
+	{
+		return m.num_digits();
+	}
+	int uses(const ffbi_t* q) const
+	{
+		return l.uses(q) || m.uses(q);
+	}
+	void eval(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_t* x = l.operand(ws);
+		uint32_t m_digits = m.num_digits();
+		ffbi_t* quotient = ffbi_workspace_get(ws, l.num_digits());
+		ffbi_t* scratch1 = ffbi_workspace_get(ws, m_digits + 1);
+		ffbi_t* scratch2 = ffbi_workspace_get(ws, m_digits + 1);
+		ffbi_div_impl(quotient, x, m.p, dest, scratch1, scratch2);
+	}
+	ffbi_t* operand(ffbi_workspace_t* ws) const
+	{
+		return ffbi_expr_operand(*this, ws);
+	}
+	void add_to(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_expr_add_to(dest, *this, ws);
+	}
+};
+
+template<typename N, typename E>
+struct ffbi_mod_expr<ffbi_pow_expr<N, E> > : ffbi_expr<ffbi_mod_expr<ffbi_pow_expr<N, E> > >
+{
+	static constexpr uint32_t num_vals = ffbi_pow_expr<N, E>::num_vals + 1;
+	ffbi_pow_expr<N, E> l;
+	ffbi_var m;
+
+	ffbi_mod_expr(const ffbi_pow_expr<N, E>& l, const ffbi_var& m) : l(l), m(m) {}
+
+	uint32_t num_digits() const
+	{
+		return m.num_digits();
+	}
+	int uses(const ffbi_t* q) const
+	{
+		return l.uses(q) || m.uses(q);
+	}
+	void eval(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_mod_pow(dest, l.n.operand(ws), l.e.operand(ws), m.p, ws);
+	}
+	ffbi_t* operand(ffbi_workspace_t* ws) const
+	{
+		return ffbi_expr_operand(*this, ws);
+	}
+	void add_to(ffbi_t* dest, ffbi_workspace_t* ws) const
+	{
+		ffbi_expr_add_to(dest, *this, ws);
+	}
+};
+
+template<typename L, typename R>
+inline ffbi_add_expr<L, R> operator+(const ffbi_expr<L>& l, const ffbi_expr<R>& r)
+{
+	return ffbi_add_expr<L, R>(l.self(), r.self());
+}
+
+template<typename L, typename R>
+inline ffbi_sub_expr<L, R> operator-(const ffbi_expr<L>& l, const ffbi_expr<R>& r)
+{
+	return ffbi_sub_expr<L, R>(l.self(), r.self());
+}
+
+template<typename L, typename R>
+inline ffbi_mul_expr<L, R> operator*(const ffbi_expr<L>& l, const ffbi_expr<R>& r)
+{
+	return ffbi_mul_expr<L, R>(l.self(), r.self());
+}
+
+template<typename L>
+inline ffbi_mod_expr<L> operator%(const ffbi_expr<L>& l, const ffbi_var& m)
+{
+	return ffbi_mod_expr<L>(l.self(), m);
+}
+
+template<typename N, typename E>
+inline ffbi_pow_expr<N, E> ffbi_pow(const ffbi_expr<N>& n, const ffbi_expr<E>& e)
+{
+	return ffbi_pow_expr<N, E>(n.self(), e.self());
+}
+
+//dest = e, with temporaries from ws. Pass NULL for ws to use the thread's default workspace.
+//dest may appear in e, in which case the value is built in ws and copied to dest at the end.
+template<typename E>
+inline void ffbi_eval(ffbi_t* dest, const ffbi_expr<E>& e, ffbi_workspace_t* ws)
+{
+	const E& expr = e.self();
+	if(ws == NULL)
+		ws = ffbi_workspace_get_thread();
+	uint32_t num_digits = expr.num_digits();
+	ffbi_workspace_reserve(ws, E::num_vals + 1, num_digits*2 + 1);
+	uint32_t frame = ffbi_workspace_push(ws);
+	if(expr.uses(dest))
+	{
+		ffbi_t* t = ffbi_workspace_get(ws, num_digits + 1);
+		expr.eval(t, ws);
+		ffbi_copy(dest, t);
+	}
+	else
+		expr.eval(dest, ws);
+	ffbi_workspace_pop(ws, frame);
+}
+
+template<typename E>
+inline ffbi_var& ffbi_var::operator=(const ffbi_expr<E>& e)
+{
+	ffbi_eval(p, e, NULL);
+	return *this;
+}
+
+#endif /* FFBI_EXPR_H_ */
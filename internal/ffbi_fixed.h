@@ -0,0 +1,279 @@
+/*
+ * ffbi_fixed.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jesse Wang
+ */
+
+#ifndef FFBI_FIXED_H_
+#define FFBI_FIXED_H_
+
+//Fixed-width unsigned bigints for the few key sizes in actual use. Values live on the stack in
+//the same digit format as ffbi_t, every loop runs a compile-time number of times so the compiler
+//can unroll it, and no operation checks sizes at runtime or touches the heap.
+
+#include "ffbi.h"
+#include <string.h>
+
+template<uint32_t Bits>
+struct ffbi_fixed
+{
+	static constexpr uint32_t num_digits = (Bits + FFBI_BITS_PER_DIGIT - 1)/FFBI_BITS_PER_DIGIT;
+	static constexpr ffbi_word_t digit_max = (((ffbi_word_t)1) << FFBI_BITS_PER_DIGIT) - 1;
+	ffbi_word_t digits[num_digits];
+};
+
+//Montgomery context for a fixed odd modulus, filled by ffbi_fixed_mont_init.
+template<uint32_t Bits>
+struct ffbi_fixed_mont
+{
+	ffbi_fixed<Bits> m;
+	ffbi_fixed<Bits> r2; //R^2 mod m, where R is 2^(num_digits*FFBI_BITS_PER_DIGIT)
+	ffbi_word_t m_inv; //-m^-1 mod 2^FFBI_BITS_PER_DIGIT
+};
+
+template<uint32_t Bits>
+inline void ffbi_fixed_set_u(ffbi_fixed<Bits>* dest, uint32_t val)
+{
+	memset(dest->digits, 0, sizeof(dest->digits));
+	dest->digits[0] = val;
+}
+
+//Copies src into dest. Returns 0 on success and 1 if src doesn't fit in Bits bits.
+template<uint32_t Bits>
+inline int ffbi_fixed_from_bigint(ffbi_fixed<Bits>* dest, ffbi_t* src)
+{
+	ffbi_word_t* digits;
+	uint32_t num_used_digits, num_allocated_digits, bits_per_digit;
+	ffbi_get_digits(src, &digits, &num_used_digits, &num_allocated_digits, &bits_per_digit);
+	if(ffbi_get_significant_bits(src) > Bits)
+		return 1;
+	uint32_t n = num_used_digits < ffbi_fixed<Bits>::num_digits ? num_used_digits : ffbi_fixed<Bits>::num_digits;
+	memcpy(dest->digits, digits, n*sizeof(ffbi_word_t));
+	memset(&dest->digits[n], 0, (ffbi_fixed<Bits>::num_digits - n)*sizeof(ffbi_word_t));
+	return 0;
+}
+
+template<uint32_t Bits>
+inline void ffbi_fixed_to_bigint(ffbi_t* dest, const ffbi_fixed<Bits>* src)
+{
+	ffbi_word_t* digits;
+	uint32_t num_used_digits, num_allocated_digits, bits_per_digit;
+	ffbi_get_digits(dest, &digits, &num_used_digits, &num_allocated_digits, &bits_per_digit);
+	if(num_allocated_digits < ffbi_fixed<Bits>::num_digits)
+	{
+		if(ffbi_reallocate_digits(dest, ffbi_fixed<Bits>::num_digits, 0))
+			return;
+		ffbi_get_digits(dest, &digits, &num_used_digits, &num_allocated_digits, &bits_per_digit);
+	}
+	memcpy(digits, src->digits, sizeof(src->digits));
+	uint32_t n = ffbi_fixed<Bits>::num_digits;
+	while(n > 1 && digits[n-1] == 0)
+		n--;
+	ffbi_set_digits(dest, NULL, n, num_allocated_digits, FFBI_BITS_PER_DIGIT);
+}
+
+//[compare] returns 0 if a == b, 1 if a > b, or -1 if a < b.
+template<uint32_t Bits>
+inline int ffbi_fixed_cmp(const ffbi_fixed<Bits>* a, const ffbi_fixed<Bits>* b)
+{
+	for(int i=(int)ffbi_fixed<Bits>::num_digits-1;i>=0;i--)
+	{
+		if(a->digits[i] != b->digits[i])
+			return a->digits[i] > b->digits[i] ? 1 : -1;
+	}
+	return 0;
+}
+
+//[addition] dest = a + b, modulo 2^(num_digits*FFBI_BITS_PER_DIGIT). Returns the carry out.
+//dest can point to the same value as a and b.
+template<uint32_t Bits>
+inline ffbi_word_t ffbi_fixed_add(ffbi_fixed<Bits>* dest, const ffbi_fixed<Bits>* a, const ffbi_fixed<Bits>* b)
+{
+	ffbi_word_t carry = 0;
+	for(uint32_t i=0;i<ffbi_fixed<Bits>::num_digits;i++)
+	{
+		ffbi_word_t s = a->digits[i] + b->digits[i] + carry;
+		dest->digits[i] = s & ffbi_fixed<Bits>::digit_max;
+		carry = s >> FFBI_BITS_PER_DIGIT;
+	}
+	return carry;
+}
+
+//[subtraction] dest = a - b, modulo 2^(num_digits*FFBI_BITS_PER_DIGIT). Returns 1 if b > a.
+//dest can point to the same value as a and b.
+template<uint32_t Bits>
+inline ffbi_word_t ffbi_fixed_sub(ffbi_fixed<Bits>* dest, const ffbi_fixed<Bits>* a, const ffbi_fixed<Bits>* b)
+{
+	ffbi_word_t borrow = 0;
+	for(uint32_t i=0;i<ffbi_fixed<Bits>::num_digits;i++)
+	{
+		ffbi_word_t s = a->digits[i] - b->digits[i] - borrow;
+		dest->digits[i] = s & ffbi_fixed<Bits>::digit_max;
+		borrow = s >> (FFBI_WORD_SIZE-1);
+	}
+	return borrow;
+}
+
+//[multiplication] dest = a * b
+//dest should not point to a or b.
+template<uint32_t Bits>
+inline void ffbi_fixed_mul(ffbi_fixed<Bits*2>* dest, const ffbi_fixed<Bits>* a, const ffbi_fixed<Bits>* b)
+{
+	const uint32_t n = ffbi_fixed<Bits>::num_digits;
+	ffbi_word_t r[n*2];
+	memset(r, 0, sizeof(r));
+	for(uint32_t i=0;i<n;i++)
+	{
+		ffbi_word_t carry = 0;
+		for(uint32_t j=0;j<n;j++)
+		{
+			ffbi_word_t s = r[i+j] + a->digits[i]*b->digits[j] + carry;
+			r[i+j] = s & ffbi_fixed<Bits>::digit_max;
+			carry = s >> FFBI_BITS_PER_DIGIT;
+		}
+		r[i+n] = carry;
+	}
+	//a product of two Bits bit values fits in 2*Bits bits, so any digit past dest is 0
+	memcpy(dest->digits, r, sizeof(dest->digits));
+}
+
+//[square] dest = a * a
+//Each cross product is computed once and doubled. dest should not point to a.
+template<uint32_t Bits>
+inline void ffbi_fixed_sqr(ffbi_fixed<Bits*2>* dest, const ffbi_fixed<Bits>* a)
+{
+	const uint32_t n = ffbi_fixed<Bits>::num_digits;
+	ffbi_word_t r[n*2];
+	memset(r, 0, sizeof(r));
+	for(uint32_t i=0;i<n;i++)
+	{
+		ffbi_word_t carry = 0;
+		for(uint32_t j=i+1;j<n;j++)
+		{
+			ffbi_word_t s = r[i+j] + a->digits[i]*a->digits[j] + carry;
+			r[i+j] = s & ffbi_fixed<Bits>::digit_max;
+			carry = s >> FFBI_BITS_PER_DIGIT;
+		}
+		r[i+n] = carry;
+	}
+	ffbi_word_t carry = 0;
+	for(uint32_t i=0;i<n;i++)
+	{
+		ffbi_word_t s = (r[i*2]<<1) + a->digits[i]*a->digits[i] + carry;
+		r[i*2] = s & ffbi_fixed<Bits>::digit_max;
+		s = (r[i*2+1]<<1) + (s >> FFBI_BITS_PER_DIGIT);
+		r[i*2+1] = s & ffbi_fixed<Bits>::digit_max;
+		carry = s >> FFBI_BITS_PER_DIGIT;
+	}
+	memcpy(dest->digits, r, sizeof(dest->digits));
+}
+
+//dest = a * b / R mod m for a*b < R*m. dest can point to a or b.
+template<uint32_t Bits>
+inline void ffbi_fixed_mont_mul(ffbi_fixed<Bits>* dest, const ffbi_fixed<Bits>* a, const ffbi_fixed<Bits>* b, const ffbi_fixed_mont<Bits>* ctx)
+{
+	const uint32_t n = ffbi_fixed<Bits>::num_digits;
+	const ffbi_word_t digit_max = ffbi_fixed<Bits>::digit_max;
+	ffbi_word_t t[n+2];
+	memset(t, 0, sizeof(t));
+	for(uint32_t i=0;i<n;i++)
+	{
+		ffbi_word_t carry = 0;
+		for(uint32_t j=0;j<n;j++)
+		{
+			ffbi_word_t s = t[j] + a->digits[j]*b->digits[i] + carry;
+			t[j] = s & digit_max;
+			carry = s >> FFBI_BITS_PER_DIGIT;
+		}
+		ffbi_word_t s = t[n] + carry;
+		t[n] = s & digit_max;
+		t[n+1] = s >> FFBI_BITS_PER_DIGIT;
+
+		//add a multiple of m that clears the lowest digit, then drop it
+		ffbi_word_t u = (t[0]*ctx->m_inv) & digit_max;
+		carry = (t[0] + u*ctx->m.digits[0]) >> FFBI_BITS_PER_DIGIT;
+		for(uint32_t j=1;j<n;j++)
+		{
+			s = t[j] + u*ctx->m.digits[j] + carry;
+			t[j-1] = s & digit_max;
+			carry = s >> FFBI_BITS_PER_DIGIT;
+		}
+		s = t[n] + carry;
+		t[n-1] = s & digit_max;
+		t[n] = t[n+1] + (s >> FFBI_BITS_PER_DIGIT);
+	}
+	//t < 2m, so one subtraction brings it below m
+	memcpy(dest->digits, t, sizeof(dest->digits));
+	if(t[n] != 0 || ffbi_fixed_cmp(dest, &ctx->m) != -1)
+		ffbi_fixed_sub(dest, dest, &ctx->m);
+}
+
+//Prepares ctx for arithmetic modulo m. Returns 0 on success and 1 if m is even.
+template<uint32_t Bits>
+inline int ffbi_fixed_mont_init(ffbi_fixed_mont<Bits>* ctx, const ffbi_fixed<Bits>* m)
+{
+	if((m->digits[0]&1) == 0)
+		return 1;
+	ctx->m = *m;
+	//Newton's iteration doubles the correct low bits of m0^-1 on each step, starting from 3
+	uint64_t m0 = (uint64_t)m->digits[0];
+	uint64_t inv = m0;
+	for(int i=0;i<5;i++)
+		inv *= 2 - m0*inv;
+	ctx->m_inv = ((ffbi_word_t)(0 - inv)) & ffbi_fixed<Bits>::digit_max;
+	//double 1 up to R^2 mod m
+	ffbi_fixed_set_u(&ctx->r2, 1);
+	for(uint32_t i=0;i<2*ffbi_fixed<Bits>::num_digits*FFBI_BITS_PER_DIGIT;i++)
+	{
+		ffbi_word_t carry = ffbi_fixed_add(&ctx->r2, &ctx->r2, &ctx->r2);
+		if(carry || ffbi_fixed_cmp(&ctx->r2, &ctx->m) != -1)
+			ffbi_fixed_sub(&ctx->r2, &ctx->r2, &ctx->m);
+	}
+	return 0;
+}
+
+#ifndef FFBI_FIXED_WINDOW_BITS
+#define FFBI_FIXED_WINDOW_BITS 4
+#endif
+
+//[modular exponentiation] dest = (n ^ e) % m, where m is the modulus of ctx.
+//Uses Montgomery multiplication with fixed windows of WindowBits bits of e. dest can point to n or e.
+template<uint32_t Bits, uint32_t WindowBits = FFBI_FIXED_WINDOW_BITS>
+inline void ffbi_fixed_mod_pow(ffbi_fixed<Bits>* dest, const ffbi_fixed<Bits>* n, const ffbi_fixed<Bits>* e, const ffbi_fixed_mont<Bits>* ctx)
+{
+	const uint32_t num_window_vals = 1 << WindowBits;
+	ffbi_fixed<Bits> window[num_window_vals];
+	ffbi_fixed<Bits> one;
+	ffbi_fixed_set_u(&one, 1);
+	ffbi_fixed_mont_mul(&window[0], &one, &ctx->r2, ctx);
+	ffbi_fixed_mont_mul(&window[1], n, &ctx->r2, ctx);
+	for(uint32_t i=2;i<num_window_vals;i++)
+		ffbi_fixed_mont_mul(&window[i], &window[i-1], &window[1], ctx);
+	ffbi_fixed<Bits> ret = window[0];
+	int started = 0;
+	for(int bit=(int)(ffbi_fixed<Bits>::num_digits*FFBI_BITS_PER_DIGIT/WindowBits+1)*WindowBits-WindowBits;bit>=0;bit-=WindowBits)
+	{
+		uint32_t w = 0;
+		for(int k=WindowBits-1;k>=0;k--)
+		{
+			uint32_t b = (uint32_t)(bit+k);
+			w <<= 1;
+			if(b < ffbi_fixed<Bits>::num_digits*FFBI_BITS_PER_DIGIT)
+				w |= (uint32_t)(e->digits[b/FFBI_BITS_PER_DIGIT] >> (b%FFBI_BITS_PER_DIGIT)) & 1;
+		}
+		if(started)
+		{
+			for(uint32_t k=0;k<WindowBits;k++)
+				ffbi_fixed_mont_mul(&ret, &ret, &ret, ctx);
+		}
+		if(w != 0)
+		{
+			ffbi_fixed_mont_mul(&ret, &ret, &window[w], ctx);
+			started = 1;
+		}
+	}
+	ffbi_fixed_mont_mul(dest, &ret, &one, ctx);
+}
+
+#endif /* FFBI_FIXED_H_ */
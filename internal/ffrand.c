@@ -0,0 +1,212 @@
+#include "ffrand.h"
+#include "libkeccak/libkeccak.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <sys/random.h>
+#endif
+
+#define FFRAND_SHAKE_BITS 256
+#define FFRAND_BLOCK_BYTES 136 //SHAKE256 bitrate
+#define FFRAND_BUF_BLOCKS 30
+#define FFRAND_SYSTEM_SEED_BYTES 64
+
+struct FFRAND
+{
+	struct libkeccak_state state;
+	uint8_t buf[FFRAND_BLOCK_BYTES*FFRAND_BUF_BLOCKS];
+	int buf_pos;
+	int buf_len;
+	uint32_t fork_generation;
+};
+
+static pthread_once_t _thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t _thread_key;
+static __thread ffrand_t* _thread_rand = NULL;
+static volatile uint32_t _fork_generation = 0;
+
+//Fills buf with len bytes from the operating system's entropy source. Returns 0 on success.
+static int ffrand_system_entropy(uint8_t* buf, int len)
+{
+	int fd;
+#if defined(__linux__) && !defined(__ANDROID__)
+	while(len > 0)
+	{
+		ssize_t n = getrandom(buf, len, 0);
+		if(n <= 0)
+			break;
+		buf += n;
+		len -= (int)n;
+	}
+	if(len == 0)
+		return 0;
+#endif
+	fd = open("/dev/urandom", O_RDONLY);
+	if(fd < 0)
+		return 1;
+	while(len > 0)
+	{
+		ssize_t n = read(fd, buf, len);
+		if(n <= 0)
+			break;
+		buf += n;
+		len -= (int)n;
+	}
+	close(fd);
+	return len != 0;
+}
+
+//Reseeds r from the operating system. Returns 0 on success.
+static int ffrand_reseed_system(ffrand_t* r)
+{
+	uint8_t seed[FFRAND_SYSTEM_SEED_BYTES];
+	if(ffrand_system_entropy(seed, FFRAND_SYSTEM_SEED_BYTES))
+		return 1;
+	ffrand_reseed(r, seed, FFRAND_SYSTEM_SEED_BYTES, 0);
+	memset(seed, 0, FFRAND_SYSTEM_SEED_BYTES);
+	r->fork_generation = _fork_generation;
+	return 0;
+}
+
+static void ffrand_atfork_child()
+{
+	_fork_generation++;
+}
+
+static void ffrand_thread_destroy(void* r)
+{
+	ffrand_destroy((ffrand_t*)r);
+}
+
+static void ffrand_thread_key_create()
+{
+	pthread_key_create(&_thread_key, ffrand_thread_destroy);
+	pthread_atfork(NULL, NULL, ffrand_atfork_child);
+}
+
+ffrand_t* ffrand_create()
+{
+	ffrand_t* ret = ffrand_create_seeded("", 0);
+	if(ret && ffrand_reseed_system(ret))
+	{
+		ffrand_destroy(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+ffrand_t* ffrand_get_thread()
+{
+	ffrand_t* r = _thread_rand;
+	if(r == NULL)
+	{
+		pthread_once(&_thread_key_once, ffrand_thread_key_create);
+		r = ffrand_create();
+		if(r == NULL)
+			abort(); //continuing without entropy would silently produce predictable keys
+		pthread_setspecific(_thread_key, r);
+		_thread_rand = r;
+	}
+	else if(r->fork_generation != _fork_generation)
+	{
+		//a forked child must not repeat the parent's output
+		if(ffrand_reseed_system(r))
+			abort();
+	}
+	return r;
+}
+
+ffrand_t* ffrand_create_seeded(const void* seed, int seed_len)
+{
+	struct libkeccak_spec spec;
+	ffrand_t* ret = (ffrand_t*)malloc(sizeof(ffrand_t));
+	if(ret == NULL)
+		return NULL;
+	libkeccak_spec_shake(&spec, FFRAND_SHAKE_BITS, FFRAND_BLOCK_BYTES*8);
+	if(libkeccak_state_initialise(&ret->state, &spec))
+	{
+		free(ret);
+		return NULL;
+	}
+	ffrand_reseed(ret, seed, seed_len, 0);
+	ret->fork_generation = _fork_generation;
+	return ret;
+}
+
+void ffrand_destroy(ffrand_t* r)
+{
+	libkeccak_state_destroy(&r->state);
+	memset(r->buf, 0, sizeof(r->buf));
+	free(r);
+}
+
+void ffrand_reseed(ffrand_t* r, const void* seed, int seed_len, uint64_t stream)
+{
+	uint8_t stream_bytes[8];
+	int i;
+	for(i=0;i<8;i++)
+		stream_bytes[i] = (uint8_t)(stream >> (i*8));
+	libkeccak_state_reset(&r->state);
+	libkeccak_fast_update(&r->state, seed, seed_len);
+	libkeccak_fast_digest(&r->state, stream_bytes, 8, 0, LIBKECCAK_SHAKE_SUFFIX, r->buf);
+	r->buf_pos = 0;
+	r->buf_len = FFRAND_BLOCK_BYTES;
+}
+
+static void ffrand_refill(ffrand_t* r)
+{
+	int i;
+	for(i=0;i<FFRAND_BUF_BLOCKS;i++)
+		libkeccak_squeeze(&r->state, r->buf + i*FFRAND_BLOCK_BYTES);
+	r->buf_pos = 0;
+	r->buf_len = FFRAND_BLOCK_BYTES*FFRAND_BUF_BLOCKS;
+}
+
+void ffrand_bytes(ffrand_t* r, void* out, int len)
+{
+	uint8_t* p = (uint8_t*)out;
+	while(len > 0)
+	{
+		int n;
+		if(r->buf_pos == r->buf_len)
+			ffrand_refill(r);
+		n = r->buf_len - r->buf_pos;
+		if(n > len)
+			n = len;
+		memcpy(p, r->buf + r->buf_pos, n);
+		r->buf_pos += n;
+		p += n;
+		len -= n;
+	}
+}
+
+uint32_t ffrand_u32(ffrand_t* r)
+{
+	uint8_t b[4];
+	ffrand_bytes(r, b, 4);
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+uint64_t ffrand_u64(ffrand_t* r)
+{
+	uint8_t b[8];
+	const uint8_t* p;
+	int i;
+	uint64_t ret = 0;
+	if(r->buf_len - r->buf_pos >= 8)
+	{
+		p = r->buf + r->buf_pos;
+		r->buf_pos += 8;
+	}
+	else
+	{
+		ffrand_bytes(r, b, 8);
+		p = b;
+	}
+	for(i=7;i>=0;i--)
+		ret = (ret << 8) | p[i];
+	return ret;
+}
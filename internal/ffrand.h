@@ -0,0 +1,53 @@
+/*
+ * ffrand.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jesse Wang
+ */
+
+#ifndef FFRAND_H_
+#define FFRAND_H_
+
+//Random number generator producing the SHAKE256 output stream of a seed, using libkeccak.
+//The same seed and stream number always produce the same bytes on every platform. Generators
+//seeded from the operating system's entropy source serve as the library's CSPRNG.
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct FFRAND ffrand_t;
+
+//Create a generator seeded from the operating system's entropy source. NULL is returned on error.
+ffrand_t* ffrand_create();
+
+//Returns the calling thread's generator, creating it on first use. It is seeded from the
+//operating system's entropy source and reseeded in the child after a fork. It is owned by the
+//thread and destroyed when the thread exits, so don't destroy it or share it with other threads.
+ffrand_t* ffrand_get_thread();
+
+//Create a generator positioned at the start of stream 0 of seed. NULL is returned on error.
+ffrand_t* ffrand_create_seeded(const void* seed, int seed_len);
+
+void ffrand_destroy(ffrand_t* r);
+
+//Restart r at the beginning of the specified stream of seed. Different stream numbers of the
+//same seed give independent output, which lets each unit of work have its own reproducible stream.
+void ffrand_reseed(ffrand_t* r, const void* seed, int seed_len, uint64_t stream);
+
+//Fill out with the next len bytes of the stream.
+void ffrand_bytes(ffrand_t* r, void* out, int len);
+
+//Returns the next 4 bytes of the stream as a little endian value.
+uint32_t ffrand_u32(ffrand_t* r);
+
+//Returns the next 8 bytes of the stream as a little endian value.
+uint64_t ffrand_u64(ffrand_t* r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FFRAND_H_ */
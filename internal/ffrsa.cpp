@@ -12,13 +12,37 @@
 #include <string.h>
 #include "ffbit.h"
 #include "ffdigest.h"
+#include "ffrand.h"
 #include <vector>
+#include <atomic>
 #include <stdlib.h>
-#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sched.h>
+#endif
 
 #define FFRSA_DEFAULT_KEY_RESERVED_BITS 2048
+//Largest prime of the sieve used to weed out composite candidates, and the size of the primorials it is packed into.
+#ifndef FFRSA_SIEVE_SIZE
+#define FFRSA_SIEVE_SIZE 100000
+#endif
+#ifndef FFRSA_SIEVE_PRIMORIAL_BITS
+#define FFRSA_SIEVE_PRIMORIAL_BITS FFBI_BITS_PER_DIGIT
+#endif
 
-typedef struct FFRSA
+//Scratch of one thread is aligned to this so that contexts of different threads never share a cache line.
+#define FFRSA_CACHE_LINE_SIZE 64
+//Most requests a ring worker takes from the submission queue at once.
+#define FFRSA_RING_BATCH_SIZE 16
+
+//Key material. Nothing in it is written once ffrsa_key_init is done, which is what lets one key
+//be used by many threads at once, each through its own ffrsa_ctx_t.
+typedef struct FFRSA_KEY
 {
 	ffbi_t* p;
 	ffbi_t* q;
@@ -27,107 +51,275 @@ typedef struct FFRSA
 	ffbi_t* dp;
 	ffbi_t* dq;
 	ffbi_t* qinv;
+	ffbi_t* m1_inc;
+	uint32_t max_msg_size;
+	uint32_t rsa_usable_size;
+	uint8_t is_private;
+} ffrsa_key_t;
+
+//Everything an encryption or decryption writes to.
+typedef struct alignas(FFRSA_CACHE_LINE_SIZE) FFRSA_CTX
+{
+	const ffrsa_key_t* key;
 	ffbi_t* temp;
 	ffbi_t* temp2;
 	ffbi_t* temp3;
 	ffbi_t* m1;
 	ffbi_t* m2;
 	ffbi_t* h;
-	ffbi_t* m1_inc;
-	ffbi_scratch_t* scratch;
+	ffbi_view_t* input;
+	ffbi_workspace_t* ws;
 	uint8_t* result;
 	uint32_t result_alloc_size;
 	uint32_t result_used_size;
-	uint32_t max_msg_size;
-	uint32_t rsa_usable_size;
-	uint8_t is_private;
 	std::vector<uint8_t>* padding_scratch;
 	std::vector<uint8_t>* padding_scratch2;
 	std::vector<uint8_t>* padding_scratch3;
 	std::vector<uint8_t>* padding_seed;
 	std::vector<uint8_t>* padding_mask;
+} ffrsa_ctx_t;
+
+//A key together with the context its owner encrypts and decrypts with.
+typedef struct FFRSA
+{
+	ffrsa_key_t* key;
+	ffrsa_ctx_t* ctx;
 } ffrsa_t;
 
-static void ffrsa_init(ffrsa_t* ret, uint32_t bits, uint8_t is_private)
+static void ffrsa_key_destroy(ffrsa_key_t* key)
 {
-	ret->temp = ffbi_create_reserved_bits(bits);
-	ret->rsa_usable_size = (ffbi_get_significant_bits(ret->n) - 1)/8;
+	if(key->p)
+		ffbi_destroy(key->p);
+	if(key->q)
+		ffbi_destroy(key->q);
+	if(key->n)
+		ffbi_destroy(key->n);
+	if(key->e)
+		ffbi_destroy(key->e);
+	if(key->dp)
+		ffbi_destroy(key->dp);
+	if(key->dq)
+		ffbi_destroy(key->dq);
+	if(key->qinv)
+		ffbi_destroy(key->qinv);
+	if(key->m1_inc)
+		ffbi_destroy(key->m1_inc);
+	ffmem_free(key);
+}
+
+//Computes the values derived from the key material and builds the division caches of the moduli,
+//which would otherwise be built by the first division that uses them.
+static void ffrsa_key_init(ffrsa_key_t* key, uint8_t is_private)
+{
+	key->rsa_usable_size = (ffbi_get_significant_bits(key->n) - 1)/8;
 	uint32_t padsize = (FFDIGEST_BUFLEN << 1) + 1;
-	if(padsize > ret->rsa_usable_size)
-		ret->max_msg_size = 0;
+	if(padsize > key->rsa_usable_size)
+		key->max_msg_size = 0;
 	else
-		ret->max_msg_size = ret->rsa_usable_size - padsize;
+		key->max_msg_size = key->rsa_usable_size - padsize;
+	key->is_private = is_private;
+	ffbi_prepare_divisor(key->n);
+	if(is_private)
+	{
+		uint32_t bits = ffbi_get_significant_bits(key->n);
+		ffbi_t* rem = ffbi_create_reserved_bits(bits);
+		ffbi_t* scratch1 = ffbi_create_reserved_bits(bits);
+		ffbi_t* scratch2 = ffbi_create_reserved_bits(bits);
+		key->m1_inc = ffbi_create_reserved_bits(bits);
+		ffbi_div_impl(key->m1_inc, key->q, key->p, rem, scratch1, scratch2);
+		ffbi_add_u(key->m1_inc, key->m1_inc, 1);
+		ffbi_mul(key->m1_inc, key->m1_inc, key->p);
+		ffbi_destroy(rem);
+		ffbi_destroy(scratch1);
+		ffbi_destroy(scratch2);
+		ffbi_prepare_divisor(key->p);
+		ffbi_prepare_divisor(key->q);
+	}
+}
+
+ffrsa_ctx_t* ffrsa_ctx_create(const ffrsa_key_t* key)
+{
+	ffrsa_ctx_t* ret = ffmem_alloc(ffrsa_ctx_t);
+	memset(ret, 0, sizeof(ffrsa_ctx_t));
+	uint32_t bits = ffbi_get_significant_bits(key->n);
+	ret->key = key;
+	ret->temp = ffbi_create_reserved_bits(bits);
 	ret->temp2 = ffbi_create_reserved_bits(bits);
 	ret->temp3 = ffbi_create_reserved_bits(bits);
-	ret->scratch = ffbi_scratch_create();
-	ret->is_private = is_private;
+	ret->input = ffbi_view_create();
+	ret->ws = ffbi_workspace_create();
+	//ciphertexts always take the full modulus size, so they can be sent as fixed-size records
+	ret->result_alloc_size = key->rsa_usable_size + 1;
+	ret->result = ffmem_alloc_arr(uint8_t, ret->result_alloc_size);
 	ret->padding_scratch = ffmem_alloc(std::vector<uint8_t>);
 	ret->padding_scratch2 = ffmem_alloc(std::vector<uint8_t>);
 	ret->padding_scratch3 = ffmem_alloc(std::vector<uint8_t>);
 	ret->padding_seed = ffmem_alloc(std::vector<uint8_t>);
 	ret->padding_mask = ffmem_alloc(std::vector<uint8_t>);
-	if(is_private)
+	if(key->is_private)
 	{
 		ret->m1 = ffbi_create_reserved_bits(bits);
 		ret->m2 = ffbi_create_reserved_bits(bits);
 		ret->h = ffbi_create_reserved_bits(bits);
-		ret->m1_inc = ffbi_create_reserved_bits(bits);
-		ffbi_div_impl(ret->m1_inc, ret->q, ret->p, ret->temp2, ret->m1, ret->m2);
-		ffbi_add_u(ret->m1_inc, ret->m1_inc, 1);
-		ffbi_mul(ret->m1_inc, ret->m1_inc, ret->p);
 	}
+	return ret;
+}
+
+//Takes ownership of key.
+static ffrsa_t* ffrsa_init(ffrsa_key_t* key, uint8_t is_private)
+{
+	ffrsa_key_init(key, is_private);
+	ffrsa_t* ret = ffmem_alloc(ffrsa_t);
+	ret->key = key;
+	ret->ctx = ffrsa_ctx_create(key);
+	return ret;
 }
 
+typedef struct FFRSA_PRIME_JOB
+{
+	uint32_t bits;
+	uint32_t num_threads;
+	ffbi_sieve_t* sieve;
+	const uint8_t* seed;
+	int seed_len;
+	ffbi_t* result;
+} ffrsa_prime_job_t;
+
+static void* ffrsa_prime_job_thread(void* param)
+{
+	ffrsa_prime_job_t* job = (ffrsa_prime_job_t*)param;
+	if(job->seed)
+		job->result = ffbi_create_seeded_large_prime(job->bits, 20, job->sieve, job->seed, job->seed_len, job->num_threads);
+	else if(job->num_threads < 2)
+		job->result = ffbi_create_random_large_prime(job->bits, 20, job->sieve);
+	else
+		job->result = ffbi_create_random_large_prime_parallel(job->bits, 20, job->sieve, job->num_threads);
+	return NULL;
+}
+
+static uint32_t ffrsa_get_num_cpus()
+{
+	long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	return num_cpus > 0 ? (uint32_t)num_cpus : 1;
+}
+
+static ffrsa_t* ffrsa_create_impl(uint32_t bits, uint32_t num_threads, const uint8_t* seed, int seed_len);
+
 //Create rsa key with specified number of bits.
 ffrsa_t* ffrsa_create(uint32_t bits)
 {
-	srand(time(NULL));
-	ffrsa_t* ret = ffmem_alloc(ffrsa_t);
-	memset(ret, 0, sizeof(ffrsa_t));
-	ffbi_scratch_t* sieve = ffbi_scratch_create();
-	ffbi_get_sieve(sieve, 100000);
+	return ffrsa_create_impl(bits, ffrsa_get_num_cpus(), NULL, 0);
+}
+
+//Create rsa key with specified number of bits, searching for primes on num_threads threads.
+ffrsa_t* ffrsa_create_parallel(uint32_t bits, uint32_t num_threads)
+{
+	return ffrsa_create_impl(bits, num_threads, NULL, 0);
+}
+
+//Create rsa key with specified number of bits, deriving all randomness from seed.
+ffrsa_t* ffrsa_create_seeded(uint32_t bits, const uint8_t* seed, int seed_len)
+{
+	if(seed == NULL || seed_len < 1)
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return NULL;
+	}
+	return ffrsa_create_impl(bits, ffrsa_get_num_cpus(), seed, seed_len);
+}
+
+//seed may be NULL to use the system random number generator.
+static ffrsa_t* ffrsa_create_impl(uint32_t bits, uint32_t num_threads, const uint8_t* seed, int seed_len)
+{
+	ffrsa_t* ret = NULL;
+	ffrsa_key_t* key = ffmem_alloc(ffrsa_key_t);
+	memset(key, 0, sizeof(ffrsa_key_t));
+	ffbi_sieve_t* sieve = ffbi_sieve_create();
+	ffbi_get_sieve(sieve, FFRSA_SIEVE_SIZE);
+	ffbi_get_sieve_primorials(sieve, FFRSA_SIEVE_PRIMORIAL_BITS);
 	uint32_t p_bits = (bits*5)/11;
 	uint32_t q_bits = bits - p_bits;
-	ret->p = ffbi_create_random_large_prime(p_bits, 20, sieve);
-	ret->q = ffbi_create_random_large_prime(q_bits, 20, sieve);
-	ret->n = ffbi_create_reserved_bits(bits);
-	ffbi_mul(ret->n, ret->p, ret->q);
-	ffbi_t* q_minus_1 = ffbi_create_from_bigint(ret->q);
-	ffbi_t* p_minus_1 = ffbi_create_from_bigint(ret->p);
+	ffrsa_prime_job_t p_job;
+	ffrsa_prime_job_t q_job;
+	p_job.bits = p_bits;
+	q_job.bits = q_bits;
+	p_job.sieve = q_job.sieve = sieve;
+	p_job.seed = q_job.seed = NULL;
+	p_job.seed_len = q_job.seed_len = 0;
+	p_job.result = q_job.result = NULL;
+	uint8_t p_seed[FFDIGEST_BUFLEN];
+	uint8_t q_seed[FFDIGEST_BUFLEN];
+	if(seed)
+	{
+		//p and q each get their own seed derived from the user's seed
+		std::vector<uint8_t> domain_seed(seed_len+1);
+		memcpy(&domain_seed[0], seed, seed_len);
+		domain_seed[seed_len] = 'p';
+		ffdigest_buf(p_seed, &domain_seed[0], seed_len+1);
+		domain_seed[seed_len] = 'q';
+		ffdigest_buf(q_seed, &domain_seed[0], seed_len+1);
+		p_job.seed = p_seed;
+		q_job.seed = q_seed;
+		p_job.seed_len = q_job.seed_len = FFDIGEST_BUFLEN;
+	}
+	if(num_threads < 2)
+	{
+		p_job.num_threads = q_job.num_threads = 1;
+		ffrsa_prime_job_thread(&p_job);
+		ffrsa_prime_job_thread(&q_job);
+	}
+	else
+	{
+		//search for q on a helper thread while this thread searches for p, splitting the workers between them
+		q_job.num_threads = num_threads/2;
+		p_job.num_threads = num_threads - q_job.num_threads;
+		pthread_t q_thread;
+		uint8_t q_thread_started = pthread_create(&q_thread, NULL, ffrsa_prime_job_thread, &q_job) == 0;
+		ffrsa_prime_job_thread(&p_job);
+		if(q_thread_started)
+			pthread_join(q_thread, NULL);
+		else
+			ffrsa_prime_job_thread(&q_job);
+	}
+	key->p = p_job.result;
+	key->q = q_job.result;
+	key->n = ffbi_create_reserved_bits(bits);
+	ffbi_mul(key->n, key->p, key->q);
+	ffbi_t* q_minus_1 = ffbi_create_from_bigint(key->q);
+	ffbi_t* p_minus_1 = ffbi_create_from_bigint(key->p);
 	ffbi_t* one = ffbi_create();
 	ffbi_add_u(one, one, 1);
 	ffbi_sub(q_minus_1, q_minus_1, one);
 	ffbi_sub(p_minus_1, p_minus_1, one);
 	ffbi_t* totient = ffbi_create_reserved_bits(bits);
 	ffbi_mul(totient, p_minus_1, q_minus_1);
-	ret->e = ffbi_create();
-	ffbi_add_u(ret->e, ret->e, 65537);
+	key->e = ffbi_create();
+	ffbi_add_u(key->e, key->e, 65537);
 	ffbi_t* d = ffbi_create_reserved_bits(bits);
-	ffbi_mod_inv(d, ret->e, totient);
+	ffbi_mod_inv(d, key->e, totient);
 	//ffbi_print(d);
 	//check d
 	ffbi_t* temp1 = ffbi_create_reserved_bits(bits);
 	ffbi_t* temp2 = ffbi_create_reserved_bits(bits);
-	ffbi_mul(temp1, d, ret->e);
+	ffbi_mul(temp1, d, key->e);
 	ffbi_mod(temp2, temp1, totient);
 	if(ffbi_cmp(temp2, one) != 0)
 	{
 		fflog_debug_print("mod inverse failed. remainder=");
 		ffbi_print(temp2);
-		ffrsa_destroy(ret);
-		ret = NULL;
+		ffrsa_key_destroy(key);
 		goto finish;
 	}
 
-	ret->dp = ffbi_create_reserved_bits(bits);
-	ret->dq = ffbi_create_reserved_bits(bits);
-	ret->qinv = ffbi_create_reserved_bits(bits);
-	ffbi_mod(ret->dp, d, p_minus_1);
-	ffbi_mod(ret->dq, d, q_minus_1);
-	ffbi_mod_inv(ret->qinv, ret->q, ret->p);
+	key->dp = ffbi_create_reserved_bits(bits);
+	key->dq = ffbi_create_reserved_bits(bits);
+	key->qinv = ffbi_create_reserved_bits(bits);
+	ffbi_mod(key->dp, d, p_minus_1);
+	ffbi_mod(key->dq, d, q_minus_1);
+	ffbi_mod_inv(key->qinv, key->q, key->p);
 
-	ffrsa_init(ret, bits, 0);
-	if(ret->max_msg_size == 0)
+	ret = ffrsa_init(key, 0);
+	if(key->max_msg_size == 0)
 	{
 		ffrsa_destroy(ret);
 		ret = NULL;
@@ -141,7 +333,7 @@ finish:
 	ffbi_destroy(p_minus_1);
 	ffbi_destroy(one);
 	ffbi_destroy(totient);
-	ffbi_scratch_destroy(sieve);
+	ffbi_sieve_destroy(sieve);
 	return ret;
 }
 
@@ -149,8 +341,8 @@ finish:
 //only encrypt.
 ffrsa_t* ffrsa_create_from_public_key(const uint8_t* key)
 {
-	ffrsa_t* ret = ffmem_alloc(ffrsa_t);
-	memset(ret, 0, sizeof(ffrsa_t));
+	ffrsa_key_t* ret = ffmem_alloc(ffrsa_key_t);
+	memset(ret, 0, sizeof(ffrsa_key_t));
 	ret->e = ffbi_create();
 	ret->n = ffbi_create_reserved_bits(FFRSA_DEFAULT_KEY_RESERVED_BITS);
 	uint8_t* p = (uint8_t*)key;
@@ -164,16 +356,15 @@ ffrsa_t* ffrsa_create_from_public_key(const uint8_t* key)
 	p += 4;
 	ffbi_deserialize(ret->n, p, n_size);
 	ffbit_destroy(bp);
-	ffrsa_init(ret, ffbi_get_significant_bits(ret->n), 0);
-	return ret;
+	return ffrsa_init(ret, 0);
 }
 
 //Create rsa key from a private key buffer. Keys created in this manner can
 //both encrypt and decrypt.
 ffrsa_t* ffrsa_create_from_private_key(const uint8_t* key)
 {
-	ffrsa_t* ret = ffmem_alloc(ffrsa_t);
-	memset(ret, 0, sizeof(ffrsa_t));
+	ffrsa_key_t* ret = ffmem_alloc(ffrsa_key_t);
+	memset(ret, 0, sizeof(ffrsa_key_t));
 	ret->p = ffbi_create_reserved_bits(FFRSA_DEFAULT_KEY_RESERVED_BITS);
 	ret->q = ffbi_create_reserved_bits(FFRSA_DEFAULT_KEY_RESERVED_BITS);
 	ret->n = ffbi_create_reserved_bits(FFRSA_DEFAULT_KEY_RESERVED_BITS);
@@ -217,54 +408,46 @@ ffrsa_t* ffrsa_create_from_private_key(const uint8_t* key)
 	p += 4;
 	ffbi_deserialize(ret->qinv, p, deserialized_size);
 	ffbit_destroy(bp);
-	ffrsa_init(ret, ffbi_get_significant_bits(ret->n), 1);
-	return ret;
+	return ffrsa_init(ret, 1);
+}
+
+void ffrsa_ctx_destroy(ffrsa_ctx_t* ctx)
+{
+	if(ctx->temp)
+		ffbi_destroy(ctx->temp);
+	if(ctx->temp2)
+		ffbi_destroy(ctx->temp2);
+	if(ctx->temp3)
+		ffbi_destroy(ctx->temp3);
+	if(ctx->input)
+		ffbi_destroy(ctx->input);
+	if(ctx->ws)
+		ffbi_workspace_destroy(ctx->ws);
+	if(ctx->m1)
+		ffbi_destroy(ctx->m1);
+	if(ctx->m2)
+		ffbi_destroy(ctx->m2);
+	if(ctx->h)
+		ffbi_destroy(ctx->h);
+	if(ctx->result)
+		ffmem_free_arr(ctx->result);
+	if(ctx->padding_scratch)
+		ffmem_free(ctx->padding_scratch);
+	if(ctx->padding_scratch2)
+		ffmem_free(ctx->padding_scratch2);
+	if(ctx->padding_scratch3)
+		ffmem_free(ctx->padding_scratch3);
+	if(ctx->padding_seed)
+		ffmem_free(ctx->padding_seed);
+	if(ctx->padding_mask)
+		ffmem_free(ctx->padding_mask);
+	ffmem_free(ctx);
 }
 
 void ffrsa_destroy(ffrsa_t* rsa)
 {
-	if(rsa->p)
-		ffbi_destroy(rsa->p);
-	if(rsa->q)
-		ffbi_destroy(rsa->q);
-	if(rsa->n)
-		ffbi_destroy(rsa->n);
-	if(rsa->e)
-		ffbi_destroy(rsa->e);
-	if(rsa->dp)
-		ffbi_destroy(rsa->dp);
-	if(rsa->dq)
-		ffbi_destroy(rsa->dq);
-	if(rsa->qinv)
-		ffbi_destroy(rsa->qinv);
-	if(rsa->temp)
-		ffbi_destroy(rsa->temp);
-	if(rsa->temp2)
-		ffbi_destroy(rsa->temp2);
-	if(rsa->temp3)
-		ffbi_destroy(rsa->temp3);
-	if(rsa->scratch)
-		ffbi_scratch_destroy(rsa->scratch);
-	if(rsa->m1)
-		ffbi_destroy(rsa->m1);
-	if(rsa->m2)
-		ffbi_destroy(rsa->m2);
-	if(rsa->h)
-		ffbi_destroy(rsa->h);
-	if(rsa->m1_inc)
-		ffbi_destroy(rsa->m1_inc);
-	if(rsa->result)
-		ffmem_free_arr(rsa->result);
-	if(rsa->padding_scratch)
-		ffmem_free(rsa->padding_scratch);
-	if(rsa->padding_scratch2)
-		ffmem_free(rsa->padding_scratch2);
-	if(rsa->padding_scratch3)
-		ffmem_free(rsa->padding_scratch3);
-	if(rsa->padding_seed)
-		ffmem_free(rsa->padding_seed);
-	if(rsa->padding_mask)
-		ffmem_free(rsa->padding_mask);
+	ffrsa_ctx_destroy(rsa->ctx);
+	ffrsa_key_destroy(rsa->key);
 	ffmem_free(rsa);
 }
 
@@ -272,33 +455,33 @@ void ffrsa_destroy(ffrsa_t* rsa)
 int ffrsa_get_private_key_size(ffrsa_t* rsa)
 {
 	int ret = 0;
-	ret += ffbi_get_serialized_size(rsa->p) + 4;
-	ret += ffbi_get_serialized_size(rsa->q) + 4;
-	ret += ffbi_get_serialized_size(rsa->n) + 4;
-	ret += ffbi_get_serialized_size(rsa->e) + 4;
-	ret += ffbi_get_serialized_size(rsa->dp) + 4;
-	ret += ffbi_get_serialized_size(rsa->dq) + 4;
-	ret += ffbi_get_serialized_size(rsa->qinv) + 4;
+	ret += ffbi_get_serialized_size(rsa->key->p) + 4;
+	ret += ffbi_get_serialized_size(rsa->key->q) + 4;
+	ret += ffbi_get_serialized_size(rsa->key->n) + 4;
+	ret += ffbi_get_serialized_size(rsa->key->e) + 4;
+	ret += ffbi_get_serialized_size(rsa->key->dp) + 4;
+	ret += ffbi_get_serialized_size(rsa->key->dq) + 4;
+	ret += ffbi_get_serialized_size(rsa->key->qinv) + 4;
 	return ret;
 }
 
 //Get buffer size required to hold public key.
 int ffrsa_get_public_key_size(ffrsa_t* rsa)
 {
-	return ffbi_get_serialized_size(rsa->e) + ffbi_get_serialized_size(rsa->n) + 8;
+	return ffbi_get_serialized_size(rsa->key->e) + ffbi_get_serialized_size(rsa->key->n) + 8;
 }
 
 //Write private key into key. Returns number of bytes written on success or
 //-1 if buffer isn't big enough. Returns 0 for other errors.
 int ffrsa_get_private_key(ffrsa_t* rsa, uint8_t* key, int size_bytes)
 {
-	uint32_t p_size = (uint32_t)ffbi_get_serialized_size(rsa->p);
-	uint32_t q_size = (uint32_t)ffbi_get_serialized_size(rsa->q);
-	uint32_t n_size = (uint32_t)ffbi_get_serialized_size(rsa->n);
-	uint32_t e_size = (uint32_t)ffbi_get_serialized_size(rsa->e);
-	uint32_t dp_size = (uint32_t)ffbi_get_serialized_size(rsa->dp);
-	uint32_t dq_size = (uint32_t)ffbi_get_serialized_size(rsa->dq);
-	uint32_t qinv_size = (uint32_t)ffbi_get_serialized_size(rsa->qinv);
+	uint32_t p_size = (uint32_t)ffbi_get_serialized_size(rsa->key->p);
+	uint32_t q_size = (uint32_t)ffbi_get_serialized_size(rsa->key->q);
+	uint32_t n_size = (uint32_t)ffbi_get_serialized_size(rsa->key->n);
+	uint32_t e_size = (uint32_t)ffbi_get_serialized_size(rsa->key->e);
+	uint32_t dp_size = (uint32_t)ffbi_get_serialized_size(rsa->key->dp);
+	uint32_t dq_size = (uint32_t)ffbi_get_serialized_size(rsa->key->dq);
+	uint32_t qinv_size = (uint32_t)ffbi_get_serialized_size(rsa->key->qinv);
 	int total_size = p_size + 4 + q_size + 4 + n_size + 4 + e_size + 4 + dp_size + 4 + dq_size + 4 + qinv_size + 4;
 	if(total_size > size_bytes)
 		return -1;
@@ -306,37 +489,37 @@ int ffrsa_get_private_key(ffrsa_t* rsa, uint8_t* key, int size_bytes)
 	ffbit_t* bp = ffbit_create(p);
 	ffbit_write(bp, 32, p_size);
 	p += 4;
-	ffbi_serialize(rsa->p, p, p_size);
+	ffbi_serialize(rsa->key->p, p, p_size);
 	p += p_size;
 	ffbit_set(bp, p, 0);
 	ffbit_write(bp, 32, q_size);
 	p += 4;
-	ffbi_serialize(rsa->q, p, q_size);
+	ffbi_serialize(rsa->key->q, p, q_size);
 	p += q_size;
 	ffbit_set(bp, p, 0);
 	ffbit_write(bp, 32, n_size);
 	p += 4;
-	ffbi_serialize(rsa->n, p, n_size);
+	ffbi_serialize(rsa->key->n, p, n_size);
 	p += n_size;
 	ffbit_set(bp, p, 0);
 	ffbit_write(bp, 32, e_size);
 	p += 4;
-	ffbi_serialize(rsa->e, p, e_size);
+	ffbi_serialize(rsa->key->e, p, e_size);
 	p += e_size;
 	ffbit_set(bp, p, 0);
 	ffbit_write(bp, 32, dp_size);
 	p += 4;
-	ffbi_serialize(rsa->dp, p, dp_size);
+	ffbi_serialize(rsa->key->dp, p, dp_size);
 	p += dp_size;
 	ffbit_set(bp, p, 0);
 	ffbit_write(bp, 32, dq_size);
 	p += 4;
-	ffbi_serialize(rsa->dq, p, dq_size);
+	ffbi_serialize(rsa->key->dq, p, dq_size);
 	p += dq_size;
 	ffbit_set(bp, p, 0);
 	ffbit_write(bp, 32, qinv_size);
 	p += 4;
-	ffbi_serialize(rsa->qinv, p, qinv_size);
+	ffbi_serialize(rsa->key->qinv, p, qinv_size);
 	ffbit_destroy(bp);
 	return total_size;
 }
@@ -345,123 +528,122 @@ int ffrsa_get_private_key(ffrsa_t* rsa, uint8_t* key, int size_bytes)
 //-1 if buffer isn't big enough. Returns 0 for other errors.
 int ffrsa_get_public_key(ffrsa_t* rsa, uint8_t* key, int size_bytes)
 {
-	uint32_t e_size = (uint32_t)ffbi_get_serialized_size(rsa->e);
-	uint32_t n_size = (uint32_t)ffbi_get_serialized_size(rsa->n);
+	uint32_t e_size = (uint32_t)ffbi_get_serialized_size(rsa->key->e);
+	uint32_t n_size = (uint32_t)ffbi_get_serialized_size(rsa->key->n);
 	int total_size = (int)(e_size + n_size + 8);
 	if(total_size > size_bytes)
 		return -1;
 	ffbit_t* bp = ffbit_create(key);
 	ffbit_write(bp, 32, e_size);
 	uint8_t* p = key + 4;
-	ffbi_serialize(rsa->e, p, e_size);
+	ffbi_serialize(rsa->key->e, p, e_size);
 	p += e_size;
 	ffbit_set(bp, p, 0);
 	ffbit_write(bp, 32, n_size);
 	p += 4;
-	ffbi_serialize(rsa->n, p, n_size);
+	ffbi_serialize(rsa->key->n, p, n_size);
 	ffbit_destroy(bp);
 	return total_size;
 }
 
 int ffrsa_get_max_msg_len(ffrsa_t* rsa)
 {
-	return (int)rsa->max_msg_size;
+	return (int)rsa->key->max_msg_size;
 }
 
-static void ffrsa_update_result(ffrsa_t* rsa, ffbi_t* val)
+//Ciphertexts are padded to one byte more than the usable size, which is the byte length of the modulus.
+int ffrsa_get_ciphertext_len(ffrsa_t* rsa)
 {
-	int serialized_size = ffbi_get_serialized_size(val);
-	if(rsa->result == NULL)
-	{
-		rsa->result = ffmem_alloc_arr(uint8_t, serialized_size);
-		rsa->result_alloc_size = serialized_size;
-	}
-	else if(serialized_size > (int)rsa->result_alloc_size)
-	{
-		ffmem_free_arr(rsa->result);
-		rsa->result = ffmem_alloc_arr(uint8_t, serialized_size);
-		rsa->result_alloc_size = serialized_size;
-	}
-	rsa->result_used_size = serialized_size;
-	ffbi_serialize(val, rsa->result, rsa->result_used_size);
+	return (int)rsa->key->rsa_usable_size + 1;
 }
 
-static void ffrsa_mgf1(ffrsa_t* rsa, std::vector<uint8_t>* mask, std::vector<uint8_t>* seed, int seed_offset, int seed_len, int desired_len)
+//Writes val into the result buffer as exactly num_bytes bytes. The buffer is allocated in ffrsa_init
+//to fit a value of the modulus size, so results never need to be resized. Returns 1 if val doesn't fit.
+static int ffrsa_update_result(ffrsa_ctx_t* ctx, ffbi_t* val, uint32_t num_bytes)
+{
+	ctx->result_used_size = 0;
+	if(num_bytes > ctx->result_alloc_size || ffbi_serialize_v2(val, ctx->result, (int)num_bytes, num_bytes*8) != (int)num_bytes)
+		return 1;
+	ctx->result_used_size = num_bytes;
+	return 0;
+}
+
+static void ffrsa_mgf1(ffrsa_ctx_t* ctx, std::vector<uint8_t>* mask, std::vector<uint8_t>* seed, int seed_offset, int seed_len, int desired_len)
 {
 	int hlen = FFDIGEST_BUFLEN;
 	int offset = 0;
 	int i = 0;
 	mask->resize(desired_len);
-	rsa->padding_scratch->resize(seed_len+4);
-	memcpy(&(*rsa->padding_scratch)[4], &(*seed)[seed_offset], seed_len);
+	ctx->padding_scratch->resize(seed_len+4);
+	memcpy(&(*ctx->padding_scratch)[4], &(*seed)[seed_offset], seed_len);
 	while(offset < desired_len)
 	{
-		(*rsa->padding_scratch)[0] = (uint8_t)(i >> 24);
-		(*rsa->padding_scratch)[1] = (uint8_t)(i >> 16);
-		(*rsa->padding_scratch)[2] = (uint8_t)(i >> 8);
-		(*rsa->padding_scratch)[3] = (uint8_t)i;
+		(*ctx->padding_scratch)[0] = (uint8_t)(i >> 24);
+		(*ctx->padding_scratch)[1] = (uint8_t)(i >> 16);
+		(*ctx->padding_scratch)[2] = (uint8_t)(i >> 8);
+		(*ctx->padding_scratch)[3] = (uint8_t)i;
 		int remaining = desired_len - offset;
 		if(remaining > hlen)
 			remaining = hlen;
 		uint8_t buf[FFDIGEST_BUFLEN];
-		ffdigest_buf(buf, &(*rsa->padding_scratch)[0], rsa->padding_scratch->size());
+		ffdigest_buf(buf, &(*ctx->padding_scratch)[0], ctx->padding_scratch->size());
 		memcpy(&(*mask)[offset], buf, remaining);
 		offset += hlen;
 		i++;
 	}
 }
 
-static void ffrsa_pad(ffrsa_t* rsa, std::vector<uint8_t>* out, uint8_t* msg, int msg_len, int desired_len)
+static void ffrsa_pad(ffrsa_ctx_t* ctx, std::vector<uint8_t>* out, uint8_t* msg, int msg_len, int desired_len)
 {
 	out->clear();
 	int hlen = FFDIGEST_BUFLEN;
 	if(msg_len > desired_len - (hlen << 1) - 1)
 		return;
 	int zero_pad = desired_len - msg_len - (hlen << 1) - 1;
-	rsa->padding_scratch2->resize(desired_len - hlen);
-	memset(&(*rsa->padding_scratch2)[0], 8, hlen);
-	memcpy(&(*rsa->padding_scratch2)[hlen + zero_pad + 1], msg, msg_len);
-	(*rsa->padding_scratch2)[hlen + zero_pad] = 1;
-	rsa->padding_seed->resize(hlen);
-	for(unsigned i=0;i<rsa->padding_seed->size();i++)
-		(*rsa->padding_seed)[i] = rand()%0x100;
-	ffrsa_mgf1(rsa, rsa->padding_mask, rsa->padding_seed, 0, hlen, desired_len - hlen);
+	ctx->padding_scratch2->resize(desired_len - hlen);
+	memset(&(*ctx->padding_scratch2)[0], 8, hlen);
+	memcpy(&(*ctx->padding_scratch2)[hlen + zero_pad + 1], msg, msg_len);
+	(*ctx->padding_scratch2)[hlen + zero_pad] = 1;
+	ctx->padding_seed->resize(hlen);
+	//the oaep seed must be unpredictable, so it comes from the csprng even when keys were created from a seed
+	ffrand_bytes(ffrand_get_thread(), &(*ctx->padding_seed)[0], hlen);
+	ffrsa_mgf1(ctx, ctx->padding_mask, ctx->padding_seed, 0, hlen, desired_len - hlen);
 	for(int i=0;i<desired_len - hlen;i++)
-		(*rsa->padding_scratch2)[i] ^= (*rsa->padding_mask)[i];
-	ffrsa_mgf1(rsa, rsa->padding_mask, rsa->padding_scratch2, 0, desired_len-hlen, hlen);
+		(*ctx->padding_scratch2)[i] ^= (*ctx->padding_mask)[i];
+	ffrsa_mgf1(ctx, ctx->padding_mask, ctx->padding_scratch2, 0, desired_len-hlen, hlen);
 	for(int i=0;i<hlen;i++)
-		(*rsa->padding_seed)[i] ^= (*rsa->padding_mask)[i];
+		(*ctx->padding_seed)[i] ^= (*ctx->padding_mask)[i];
 	out->resize(desired_len);
-	memcpy(&(*out)[0], &(*rsa->padding_seed)[0], hlen);
-	memcpy(&(*out)[hlen], &(*rsa->padding_scratch2)[0], desired_len-hlen);
+	memcpy(&(*out)[0], &(*ctx->padding_seed)[0], hlen);
+	memcpy(&(*out)[hlen], &(*ctx->padding_scratch2)[0], desired_len-hlen);
 }
 
-static void ffrsa_unpad(ffrsa_t* rsa, std::vector<uint8_t>* out, uint8_t* msg, int msg_len)
+static void ffrsa_unpad(ffrsa_ctx_t* ctx, std::vector<uint8_t>* out, uint8_t* msg, int msg_len)
 {
 	out->clear();
 	int hlen = FFDIGEST_BUFLEN;
 	if(msg_len < (hlen << 1) + 1)
 		return;
-	rsa->padding_scratch2->resize(msg_len);
-	memcpy(&(*rsa->padding_scratch2)[0], msg, msg_len);
-	ffrsa_mgf1(rsa, rsa->padding_mask, rsa->padding_scratch2, hlen, msg_len-hlen, hlen);
+	ctx->padding_scratch2->resize(msg_len);
+	memcpy(&(*ctx->padding_scratch2)[0], msg, msg_len);
+	ffrsa_mgf1(ctx, ctx->padding_mask, ctx->padding_scratch2, hlen, msg_len-hlen, hlen);
 	for(int i=0;i<hlen;i++)
-		(*rsa->padding_scratch2)[i] ^= (*rsa->padding_mask)[i];
+		(*ctx->padding_scratch2)[i] ^= (*ctx->padding_mask)[i];
 	uint8_t temp[FFDIGEST_BUFLEN];
 	memset(temp, 8, FFDIGEST_BUFLEN);
-	ffrsa_mgf1(rsa, rsa->padding_mask, rsa->padding_scratch2, 0, hlen, msg_len-hlen);
+	ffrsa_mgf1(ctx, ctx->padding_mask, ctx->padding_scratch2, 0, hlen, msg_len-hlen);
 	int index = -1;
 	for(int i=hlen;i<msg_len;i++)
 	{
-		(*rsa->padding_scratch2)[i] ^= (*rsa->padding_mask)[i-hlen];
+		(*ctx->padding_scratch2)[i] ^= (*ctx->padding_mask)[i-hlen];
 		if(i<(hlen << 1))
 		{
-			if((*rsa->padding_scratch2)[i] != temp[i-hlen])
+			if((*ctx->padding_scratch2)[i] != temp[i-hlen])
 				return;
 		}
 		else if(i < msg_len - FFDIGEST_BUFLEN)
 		{
-			if((*rsa->padding_scratch2)[i] == 1)
+			if((*ctx->padding_scratch2)[i] == 1)
 				index = i+1;
 		}
 	}
@@ -471,67 +653,857 @@ static void ffrsa_unpad(ffrsa_t* rsa, std::vector<uint8_t>* out, uint8_t* msg, i
 		return;
 	}
 	out->resize(msg_len-index);
-	memcpy(&(*out)[0], &(*rsa->padding_scratch2)[index], msg_len-index);
+	memcpy(&(*out)[0], &(*ctx->padding_scratch2)[index], msg_len-index);
 }
 
 //Returns 0 on success and 1 on error.
-int ffrsa_encrypt(ffrsa_t* rsa, uint8_t* src, int msg_len)
+int ffrsa_ctx_encrypt(ffrsa_ctx_t* ctx, uint8_t* src, int msg_len)
 {
-	if(msg_len > (int)rsa->max_msg_size)
+	const ffrsa_key_t* key = ctx->key;
+	if(msg_len > (int)key->max_msg_size)
 	{
-		fflog_print("ffrsa_encrypt failed. msg_len (%d) can't be greater than max message size of %u, dictated by the bit length of the RSA key.\n", msg_len, rsa->max_msg_size);
+		fflog_print("ffrsa_encrypt failed. msg_len (%d) can't be greater than max message size of %u, dictated by the bit length of the RSA key.\n", msg_len, key->max_msg_size);
 		return 1;
 	}
-	rsa->padding_scratch3->resize(rsa->rsa_usable_size);
+	ctx->padding_scratch3->resize(key->rsa_usable_size);
 	while(1)
 	{
-		ffrsa_pad(rsa, rsa->padding_scratch3, src, msg_len, rsa->rsa_usable_size);
-		if(((*rsa->padding_scratch3)[rsa->rsa_usable_size-1]&1) == 1)
+		ffrsa_pad(ctx, ctx->padding_scratch3, src, msg_len, key->rsa_usable_size);
+		if(((*ctx->padding_scratch3)[key->rsa_usable_size-1]&1) == 1)
 			break;
 	}
-	ffbi_deserialize(rsa->temp, &(*rsa->padding_scratch3)[0], rsa->rsa_usable_size);
-	ffbi_mod_pow(rsa->temp2, rsa->temp, rsa->e, rsa->n, rsa->scratch);
-	ffrsa_update_result(rsa, rsa->temp2);
+	ffbi_view_set_bytes(ctx->input, &(*ctx->padding_scratch3)[0], key->rsa_usable_size);
+	ffbi_mod_pow(ctx->temp2, ctx->input, key->e, key->n, ctx->ws);
+	if(ffrsa_update_result(ctx, ctx->temp2, ctx->result_alloc_size))
+		return 1;
 	return 0;
 }
 
 //Returns 0 on success and 1 on error.
-int ffrsa_decrypt(ffrsa_t* rsa, uint8_t* src, int msg_len)
+int ffrsa_ctx_decrypt(ffrsa_ctx_t* ctx, uint8_t* src, int msg_len)
 {
-	if(msg_len > (int)rsa->rsa_usable_size+1)
+	const ffrsa_key_t* key = ctx->key;
+	if(msg_len > (int)key->rsa_usable_size+1)
 	{
-		fflog_print("ffrsa_decrypt failed. msg_len (%d) can't be greater than %u, dictated by the bit length of the RSA key.\n", msg_len, rsa->rsa_usable_size+1);
+		fflog_print("ffrsa_decrypt failed. msg_len (%d) can't be greater than %u, dictated by the bit length of the RSA key.\n", msg_len, key->rsa_usable_size+1);
 		return 1;
 	}
-	if(rsa->is_private == 0)
+	if(key->is_private == 0)
 	{
 		fflog_print("ffrsa_decrypt failed. RSA public key used and cannot be used for decryption.\n");
 		return 1;
 	}
-	ffbi_deserialize(rsa->temp, src, msg_len);
-	ffbi_mod_pow(rsa->m1, rsa->temp, rsa->dp, rsa->p, rsa->scratch);
-	ffbi_mod_pow(rsa->m2, rsa->temp, rsa->dq, rsa->q, rsa->scratch);
-	if(ffbi_cmp(rsa->m1, rsa->m2) == -1)
-		ffbi_add(rsa->m1, rsa->m1, rsa->m1_inc);
-	ffbi_sub(rsa->m1, rsa->m1, rsa->m2);
-	ffbi_mul(rsa->temp2, rsa->m1, rsa->qinv);
-	ffbi_div_impl(rsa->temp, rsa->temp2, rsa->p, rsa->h, rsa->m1, rsa->temp3);
-	ffbi_mul(rsa->temp2, rsa->h, rsa->q);
-	ffbi_add(rsa->temp2, rsa->temp2, rsa->m2);
-	ffrsa_update_result(rsa, rsa->temp2);
-	ffrsa_unpad(rsa, rsa->padding_scratch3, rsa->result, rsa->result_used_size);
-	if(rsa->padding_scratch3->size() == 0)
-	{
-		fflog_print("ffrsa_decrypt failed. Unpadding failed for unknown reasons. result_used_size=%u\n", rsa->result_used_size);
+	ffbi_view_set_bytes(ctx->input, src, msg_len);
+	ffbi_mod_pow(ctx->m1, ctx->input, key->dp, key->p, ctx->ws);
+	ffbi_mod_pow(ctx->m2, ctx->input, key->dq, key->q, ctx->ws);
+	if(ffbi_cmp(ctx->m1, ctx->m2) == -1)
+		ffbi_add(ctx->m1, ctx->m1, key->m1_inc);
+	ffbi_sub(ctx->m1, ctx->m1, ctx->m2);
+	ffbi_mul(ctx->temp2, ctx->m1, key->qinv);
+	ffbi_div_impl(ctx->temp, ctx->temp2, key->p, ctx->h, ctx->m1, ctx->temp3);
+	ffbi_mul(ctx->temp2, ctx->h, key->q);
+	ffbi_add(ctx->temp2, ctx->temp2, ctx->m2);
+	//a valid padded message always fills rsa_usable_size bytes, since encryption makes its top byte odd
+	if(ffrsa_update_result(ctx, ctx->temp2, key->rsa_usable_size))
+	{
+		fflog_print("ffrsa_decrypt failed. The decrypted value is larger than a padded message.\n");
+		return 1;
+	}
+	ffrsa_unpad(ctx, ctx->padding_scratch3, ctx->result, ctx->result_used_size);
+	if(ctx->padding_scratch3->size() == 0)
+	{
+		fflog_print("ffrsa_decrypt failed. Unpadding failed for unknown reasons. result_used_size=%u\n", ctx->result_used_size);
 		return 1;
 	}
-	memcpy(rsa->result, &(*rsa->padding_scratch3)[0], rsa->padding_scratch3->size());
-	rsa->result_used_size = rsa->padding_scratch3->size();
+	memcpy(ctx->result, &(*ctx->padding_scratch3)[0], ctx->padding_scratch3->size());
+	ctx->result_used_size = ctx->padding_scratch3->size();
 	return 0;
 }
 
+void ffrsa_ctx_get_result(ffrsa_ctx_t* ctx, uint8_t** result, int* msg_len)
+{
+	*result = ctx->result;
+	*msg_len = (int)ctx->result_used_size;
+}
+
+int ffrsa_encrypt(ffrsa_t* rsa, uint8_t* src, int msg_len)
+{
+	return ffrsa_ctx_encrypt(rsa->ctx, src, msg_len);
+}
+
+int ffrsa_decrypt(ffrsa_t* rsa, uint8_t* src, int msg_len)
+{
+	return ffrsa_ctx_decrypt(rsa->ctx, src, msg_len);
+}
+
 void ffrsa_get_result(ffrsa_t* rsa, uint8_t** result, int* msg_len)
 {
-	*result = rsa->result;
-	*msg_len = (int)rsa->result_used_size;
+	ffrsa_ctx_get_result(rsa->ctx, result, msg_len);
+}
+
+const ffrsa_key_t* ffrsa_get_key(ffrsa_t* rsa)
+{
+	return rsa->key;
+}
+
+//Runs op on src with ctx and copies the result to out, which has room for out_size bytes. Returns what
+//ffrsa_encrypt or ffrsa_decrypt would, or 1 if the result doesn't fit in out or op is unknown.
+static int ffrsa_ctx_run(ffrsa_ctx_t* ctx, int op, uint8_t* src, int src_len, uint8_t* out, int out_size, int* out_len)
+{
+	int ret = 1;
+	*out_len = 0;
+	if(op == FFRSA_OP_ENCRYPT)
+		ret = ffrsa_ctx_encrypt(ctx, src, src_len);
+	else if(op == FFRSA_OP_DECRYPT)
+		ret = ffrsa_ctx_decrypt(ctx, src, src_len);
+	if(ret == 0)
+	{
+		if((int)ctx->result_used_size > out_size)
+			return 1;
+		memcpy(out, ctx->result, ctx->result_used_size);
+		*out_len = (int)ctx->result_used_size;
+	}
+	return ret;
+}
+
+//Items of a batch owned by one worker. The owner and workers that ran out of items of their own
+//both take the next item from the front.
+typedef struct alignas(FFRSA_CACHE_LINE_SIZE) FFRSA_POOL_QUEUE
+{
+	std::atomic<int> next;
+	int end;
+} ffrsa_pool_queue_t;
+
+//Worker 0 is the thread that calls a batch function. Workers 1 and up are threads of the pool.
+typedef struct FFRSA_POOL
+{
+	const ffrsa_key_t* key;
+	int num_workers;
+	ffrsa_ctx_t** ctxs;
+	ffrsa_pool_queue_t* queues;
+	pthread_t* threads;
+	int num_threads;
+	pthread_mutex_t batch_mutex; //held for the whole of a batch, so batches run one at a time
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+	uint32_t generation; //incremented when a batch starts
+	int num_busy;
+	uint8_t stopping;
+	//the batch being run
+	int op;
+	uint8_t* const* src;
+	const int* src_lens;
+	uint8_t* out;
+	int out_stride;
+	int* out_lens;
+	int* status;
+} ffrsa_pool_t;
+
+typedef struct FFRSA_POOL_WORKER
+{
+	ffrsa_pool_t* pool;
+	int index;
+} ffrsa_pool_worker_t;
+
+static void ffrsa_pool_run_item(ffrsa_pool_t* pool, ffrsa_ctx_t* ctx, int i)
+{
+	pool->status[i] = ffrsa_ctx_run(ctx, pool->op, pool->src[i], pool->src_lens[i], pool->out + (size_t)i*pool->out_stride, pool->out_stride, &pool->out_lens[i]);
+}
+
+//Runs the items of worker index, then those left to other workers.
+static void ffrsa_pool_work(ffrsa_pool_t* pool, int index)
+{
+	ffrsa_ctx_t* ctx = pool->ctxs[index];
+	for(int k=0;k<pool->num_workers;k++)
+	{
+		ffrsa_pool_queue_t* queue = &pool->queues[(index + k)%pool->num_workers];
+		while(1)
+		{
+			int i = queue->next.fetch_add(1, std::memory_order_relaxed);
+			if(i >= queue->end)
+				break;
+			ffrsa_pool_run_item(pool, ctx, i);
+		}
+	}
+}
+
+static void* ffrsa_pool_thread(void* param)
+{
+	ffrsa_pool_worker_t* worker = (ffrsa_pool_worker_t*)param;
+	ffrsa_pool_t* pool = worker->pool;
+	int index = worker->index;
+	ffmem_free(worker);
+	//a thread that starts late still sees batches posted before it got here
+	uint32_t generation = 0;
+	pthread_mutex_lock(&pool->mutex);
+	while(1)
+	{
+		while(!pool->stopping && pool->generation == generation)
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+		if(pool->stopping)
+			break;
+		generation = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+		ffrsa_pool_work(pool, index);
+		pthread_mutex_lock(&pool->mutex);
+		if(--pool->num_busy == 0)
+			pthread_cond_signal(&pool->done_cond);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+ffrsa_pool_t* ffrsa_pool_create(const ffrsa_key_t* key, int num_threads)
+{
+	if(num_threads < 0)
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return NULL;
+	}
+	if(num_threads == 0)
+		num_threads = (int)ffrsa_get_num_cpus();
+	ffrsa_pool_t* ret = ffmem_alloc(ffrsa_pool_t);
+	memset(ret, 0, sizeof(ffrsa_pool_t));
+	ret->key = key;
+	ret->num_workers = num_threads;
+	ret->ctxs = ffmem_alloc_arr(ffrsa_ctx_t*, num_threads);
+	for(int i=0;i<num_threads;i++)
+		ret->ctxs[i] = ffrsa_ctx_create(key);
+	ret->queues = ffmem_alloc_arr(ffrsa_pool_queue_t, num_threads);
+	for(int i=0;i<num_threads;i++)
+	{
+		ret->queues[i].next.store(0, std::memory_order_relaxed);
+		ret->queues[i].end = 0;
+	}
+	pthread_mutex_init(&ret->batch_mutex, NULL);
+	pthread_mutex_init(&ret->mutex, NULL);
+	pthread_cond_init(&ret->start_cond, NULL);
+	pthread_cond_init(&ret->done_cond, NULL);
+	ret->threads = ffmem_alloc_arr(pthread_t, num_threads);
+	for(int i=1;i<num_threads;i++)
+	{
+		ffrsa_pool_worker_t* worker = ffmem_alloc(ffrsa_pool_worker_t);
+		worker->pool = ret;
+		worker->index = i;
+		if(pthread_create(&ret->threads[ret->num_threads], NULL, ffrsa_pool_thread, worker) != 0)
+		{
+			//the calling thread picks up the items of workers that didn't start
+			ffmem_free(worker);
+			break;
+		}
+		ret->num_threads++;
+	}
+	return ret;
+}
+
+void ffrsa_pool_destroy(ffrsa_pool_t* pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = 1;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for(int i=0;i<pool->num_threads;i++)
+		pthread_join(pool->threads[i], NULL);
+	for(int i=0;i<pool->num_workers;i++)
+		ffrsa_ctx_destroy(pool->ctxs[i]);
+	pthread_cond_destroy(&pool->done_cond);
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_mutex_destroy(&pool->batch_mutex);
+	ffmem_free_arr(pool->threads);
+	ffmem_free_arr(pool->queues);
+	ffmem_free_arr(pool->ctxs);
+	ffmem_free(pool);
+}
+
+static int ffrsa_batch(ffrsa_pool_t* pool, int op, uint8_t* const* src, const int* src_lens, int count, uint8_t* out, int out_stride, int* out_lens, int* status)
+{
+	if(count < 0 || (count > 0 && (src == NULL || src_lens == NULL || out == NULL || out_lens == NULL || status == NULL)))
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return 1;
+	}
+	if(count == 0)
+		return 0;
+	pthread_mutex_lock(&pool->batch_mutex);
+	pool->op = op;
+	pool->src = src;
+	pool->src_lens = src_lens;
+	pool->out = out;
+	pool->out_stride = out_stride;
+	pool->out_lens = out_lens;
+	pool->status = status;
+	//every worker starts on a contiguous share of the items
+	for(int i=0;i<pool->num_workers;i++)
+	{
+		pool->queues[i].next.store((int)((int64_t)count*i/pool->num_workers), std::memory_order_relaxed);
+		pool->queues[i].end = (int)((int64_t)count*(i + 1)/pool->num_workers);
+	}
+	pthread_mutex_lock(&pool->mutex);
+	pool->num_busy = pool->num_threads;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+	ffrsa_pool_work(pool, 0);
+	pthread_mutex_lock(&pool->mutex);
+	while(pool->num_busy > 0)
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_mutex_unlock(&pool->batch_mutex);
+	int ret = 0;
+	for(int i=0;i<count;i++)
+		ret |= status[i];
+	return ret;
+}
+
+int ffrsa_encrypt_batch(ffrsa_pool_t* pool, uint8_t* const* src, const int* msg_lens, int count, uint8_t* out, int out_stride, int* out_lens, int* status)
+{
+	return ffrsa_batch(pool, FFRSA_OP_ENCRYPT, src, msg_lens, count, out, out_stride, out_lens, status);
+}
+
+int ffrsa_decrypt_batch(ffrsa_pool_t* pool, uint8_t* const* src, const int* msg_lens, int count, uint8_t* out, int out_stride, int* out_lens, int* status)
+{
+	return ffrsa_batch(pool, FFRSA_OP_DECRYPT, src, msg_lens, count, out, out_stride, out_lens, status);
+}
+
+#if defined(__linux__)
+//Bounded queue that any number of threads push to and pop from without locks. Each cell carries a
+//sequence number telling whether it is free for the push at its position or holds the value for the pop.
+template<typename T>
+struct FFRSA_QUEUE
+{
+	struct cell
+	{
+		std::atomic<uint32_t> seq;
+		T data;
+	};
+	cell* cells;
+	uint32_t mask;
+	alignas(FFRSA_CACHE_LINE_SIZE) std::atomic<uint32_t> tail;
+	alignas(FFRSA_CACHE_LINE_SIZE) std::atomic<uint32_t> head;
+};
+
+//num_entries must be a power of 2.
+template<typename T>
+static void ffrsa_queue_init(FFRSA_QUEUE<T>* q, uint32_t num_entries)
+{
+	q->cells = ffmem_alloc_arr(typename FFRSA_QUEUE<T>::cell, num_entries);
+	for(uint32_t i=0;i<num_entries;i++)
+		q->cells[i].seq.store(i, std::memory_order_relaxed);
+	q->mask = num_entries - 1;
+	q->tail.store(0, std::memory_order_relaxed);
+	q->head.store(0, std::memory_order_relaxed);
+}
+
+//Returns 0 if q is full.
+template<typename T>
+static int ffrsa_queue_push(FFRSA_QUEUE<T>* q, const T* val)
+{
+	uint32_t pos = q->tail.load(std::memory_order_relaxed);
+	while(1)
+	{
+		typename FFRSA_QUEUE<T>::cell* c = &q->cells[pos & q->mask];
+		int32_t diff = (int32_t)(c->seq.load(std::memory_order_acquire) - pos);
+		if(diff == 0)
+		{
+			if(q->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				c->data = *val;
+				c->seq.store(pos + 1, std::memory_order_release);
+				return 1;
+			}
+		}
+		else if(diff < 0)
+			return 0;
+		else
+			pos = q->tail.load(std::memory_order_relaxed);
+	}
+}
+
+//Returns 0 if q is empty.
+template<typename T>
+static int ffrsa_queue_pop(FFRSA_QUEUE<T>* q, T* val)
+{
+	uint32_t pos = q->head.load(std::memory_order_relaxed);
+	while(1)
+	{
+		typename FFRSA_QUEUE<T>::cell* c = &q->cells[pos & q->mask];
+		int32_t diff = (int32_t)(c->seq.load(std::memory_order_acquire) - (pos + 1));
+		if(diff == 0)
+		{
+			if(q->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				*val = c->data;
+				c->seq.store(pos + q->mask + 1, std::memory_order_release);
+				return 1;
+			}
+		}
+		else if(diff < 0)
+			return 0;
+		else
+			pos = q->head.load(std::memory_order_relaxed);
+	}
+}
+
+//Values that are being pushed count as well.
+template<typename T>
+static int ffrsa_queue_is_empty(FFRSA_QUEUE<T>* q)
+{
+	return q->tail.load(std::memory_order_acquire) == q->head.load(std::memory_order_acquire);
+}
+
+//Submissions go to sq, from which the workers take up to FFRSA_RING_BATCH_SIZE at a time. Workers that
+//find sq empty count themselves in num_sleeping and block on submit_fd, which submitters only write to
+//while someone sleeps. Completions go to cq, which has room for every request in flight, and
+//complete_fd is written when cq stops being empty, so a burst of completions costs one write.
+typedef struct FFRSA_RING
+{
+	const ffrsa_key_t* key;
+	FFRSA_QUEUE<ffrsa_sqe_t> sq;
+	FFRSA_QUEUE<ffrsa_cqe_t> cq;
+	uint32_t cq_entries;
+	ffrsa_ctx_t** ctxs;
+	pthread_t* threads;
+	int num_threads;
+	int submit_fd;
+	int complete_fd;
+	alignas(FFRSA_CACHE_LINE_SIZE) std::atomic<uint32_t> in_flight;
+	alignas(FFRSA_CACHE_LINE_SIZE) std::atomic<int> num_sleeping;
+	std::atomic<uint8_t> stopping;
+	alignas(FFRSA_CACHE_LINE_SIZE) std::atomic<uint8_t> cq_signaled;
+} ffrsa_ring_t;
+
+typedef struct FFRSA_RING_WORKER
+{
+	ffrsa_ring_t* ring;
+	int index;
+} ffrsa_ring_worker_t;
+
+static void ffrsa_ring_signal(ffrsa_ring_t* ring)
+{
+	if(ring->cq_signaled.exchange(1) == 0)
+	{
+		uint64_t value = 1;
+		if(write(ring->complete_fd, &value, sizeof(value)) != sizeof(value))
+			fflog_debug_print("failed to signal completions.\n");
+	}
+}
+
+//Runs a batch taken from sq and signals its completions at once.
+static void ffrsa_ring_run(ffrsa_ring_t* ring, ffrsa_ctx_t* ctx, ffrsa_sqe_t* sqes, int count)
+{
+	for(int i=0;i<count;i++)
+	{
+		ffrsa_cqe_t cqe;
+		cqe.user_tag = sqes[i].user_tag;
+		cqe.status = ffrsa_ctx_run(ctx, sqes[i].op, sqes[i].src, sqes[i].src_len, sqes[i].out, sqes[i].out_size, &cqe.out_len);
+		//in_flight never exceeds the size of cq, so this only waits for a pop that is in progress
+		while(!ffrsa_queue_push(&ring->cq, &cqe))
+			sched_yield();
+	}
+	ffrsa_ring_signal(ring);
+}
+
+//Takes up to FFRSA_RING_BATCH_SIZE requests from sq.
+static int ffrsa_ring_drain(ffrsa_ring_t* ring, ffrsa_sqe_t* sqes)
+{
+	int ret = 0;
+	while(ret < FFRSA_RING_BATCH_SIZE && ffrsa_queue_pop(&ring->sq, &sqes[ret]))
+		ret++;
+	return ret;
+}
+
+static void* ffrsa_ring_thread(void* param)
+{
+	ffrsa_ring_worker_t* worker = (ffrsa_ring_worker_t*)param;
+	ffrsa_ring_t* ring = worker->ring;
+	ffrsa_ctx_t* ctx = ring->ctxs[worker->index];
+	ffmem_free(worker);
+	ffrsa_sqe_t sqes[FFRSA_RING_BATCH_SIZE];
+	while(1)
+	{
+		int count = ffrsa_ring_drain(ring, sqes);
+		if(count > 0)
+		{
+			ffrsa_ring_run(ring, ctx, sqes, count);
+			continue;
+		}
+		if(ring->stopping.load())
+			break;
+		//announce the sleep before looking at sq again, so a submission either is seen here or wakes us
+		ring->num_sleeping.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		count = ffrsa_ring_drain(ring, sqes);
+		if(count > 0)
+		{
+			ring->num_sleeping.fetch_sub(1);
+			ffrsa_ring_run(ring, ctx, sqes, count);
+			continue;
+		}
+		uint64_t value;
+		if(read(ring->submit_fd, &value, sizeof(value)) != sizeof(value))
+			fflog_debug_print("failed to wait for submissions.\n");
+		ring->num_sleeping.fetch_sub(1);
+	}
+	return NULL;
+}
+
+ffrsa_ring_t* ffrsa_ring_create(const ffrsa_key_t* key, uint32_t entries, int num_threads)
+{
+	if(entries < 1 || entries > (1u << 30) || num_threads < 0)
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return NULL;
+	}
+	if(num_threads == 0)
+		num_threads = (int)ffrsa_get_num_cpus();
+	uint32_t sq_entries = 1;
+	while(sq_entries < entries)
+		sq_entries <<= 1;
+	ffrsa_ring_t* ret = ffmem_alloc(ffrsa_ring_t);
+	ret->key = key;
+	ret->submit_fd = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
+	ret->complete_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(ret->submit_fd < 0 || ret->complete_fd < 0)
+	{
+		fflog_debug_print("failed to create eventfds.\n");
+		if(ret->submit_fd >= 0)
+			close(ret->submit_fd);
+		if(ret->complete_fd >= 0)
+			close(ret->complete_fd);
+		ffmem_free(ret);
+		return NULL;
+	}
+	ffrsa_queue_init(&ret->sq, sq_entries);
+	ret->cq_entries = sq_entries*2;
+	ffrsa_queue_init(&ret->cq, ret->cq_entries);
+	ret->in_flight.store(0);
+	ret->num_sleeping.store(0);
+	ret->stopping.store(0);
+	ret->cq_signaled.store(0);
+	ret->ctxs = ffmem_alloc_arr(ffrsa_ctx_t*, num_threads);
+	ret->threads = ffmem_alloc_arr(pthread_t, num_threads);
+	ret->num_threads = 0;
+	for(int i=0;i<num_threads;i++)
+	{
+		ret->ctxs[i] = ffrsa_ctx_create(key);
+		ffrsa_ring_worker_t* worker = ffmem_alloc(ffrsa_ring_worker_t);
+		worker->ring = ret;
+		worker->index = i;
+		if(pthread_create(&ret->threads[i], NULL, ffrsa_ring_thread, worker) != 0)
+		{
+			ffmem_free(worker);
+			ffrsa_ctx_destroy(ret->ctxs[i]);
+			break;
+		}
+		ret->num_threads++;
+	}
+	if(ret->num_threads == 0)
+	{
+		fflog_debug_print("failed to start any worker threads.\n");
+		ffrsa_ring_destroy(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+void ffrsa_ring_destroy(ffrsa_ring_t* ring)
+{
+	ring->stopping.store(1);
+	if(ring->num_threads > 0)
+	{
+		//one wake-up per worker, whether it sleeps yet or not
+		uint64_t value = (uint64_t)ring->num_threads;
+		if(write(ring->submit_fd, &value, sizeof(value)) != sizeof(value))
+			fflog_debug_print("failed to wake the workers.\n");
+	}
+	for(int i=0;i<ring->num_threads;i++)
+	{
+		pthread_join(ring->threads[i], NULL);
+		ffrsa_ctx_destroy(ring->ctxs[i]);
+	}
+	close(ring->submit_fd);
+	close(ring->complete_fd);
+	ffmem_free_arr(ring->threads);
+	ffmem_free_arr(ring->ctxs);
+	ffmem_free_arr(ring->sq.cells);
+	ffmem_free_arr(ring->cq.cells);
+	ffmem_free(ring);
+}
+
+int ffrsa_ring_get_fd(ffrsa_ring_t* ring)
+{
+	return ring->complete_fd;
+}
+
+int ffrsa_ring_submit(ffrsa_ring_t* ring, const ffrsa_sqe_t* sqes, int count)
+{
+	int ret = 0;
+	for(;ret<count;ret++)
+	{
+		//every request needs a place in cq once it completes
+		uint32_t in_flight = ring->in_flight.load(std::memory_order_relaxed);
+		do
+		{
+			if(in_flight >= ring->cq_entries)
+				goto wake;
+		} while(!ring->in_flight.compare_exchange_weak(in_flight, in_flight + 1, std::memory_order_relaxed));
+		if(!ffrsa_queue_push(&ring->sq, &sqes[ret]))
+		{
+			ring->in_flight.fetch_sub(1, std::memory_order_relaxed);
+			break;
+		}
+	}
+wake:
+	if(ret > 0)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int num_sleeping = ring->num_sleeping.load();
+		if(num_sleeping > 0)
+		{
+			uint64_t value = (uint64_t)(num_sleeping < ret ? num_sleeping : ret);
+			if(write(ring->submit_fd, &value, sizeof(value)) != sizeof(value))
+				fflog_debug_print("failed to wake the workers.\n");
+		}
+	}
+	return ret;
+}
+
+int ffrsa_ring_reap(ffrsa_ring_t* ring, ffrsa_cqe_t* cqes, int max)
+{
+	uint64_t value;
+	//complete_fd is nonblocking, and reading it when nothing was signaled just fails
+	if(read(ring->complete_fd, &value, sizeof(value)) < 0)
+		value = 0;
+	ring->cq_signaled.store(0);
+	int ret = 0;
+	while(ret < max && ffrsa_queue_pop(&ring->cq, &cqes[ret]))
+		ret++;
+	ring->in_flight.fetch_sub((uint32_t)ret, std::memory_order_relaxed);
+	//completions left behind keep complete_fd readable
+	if(!ffrsa_queue_is_empty(&ring->cq))
+		ffrsa_ring_signal(ring);
+	return ret;
+}
+
+int ffrsa_ring_wait(ffrsa_ring_t* ring, ffrsa_cqe_t* cqes, int max)
+{
+	while(1)
+	{
+		int ret = ffrsa_ring_reap(ring, cqes, max);
+		if(ret > 0 || max < 1)
+			return ret;
+		struct pollfd pfd;
+		pfd.fd = ring->complete_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		poll(&pfd, 1, -1);
+	}
+}
+#else
+ffrsa_ring_t* ffrsa_ring_create(const ffrsa_key_t*, uint32_t, int)
+{
+	fflog_debug_print("rings need eventfd, which this platform doesn't have.\n");
+	return NULL;
+}
+
+void ffrsa_ring_destroy(ffrsa_ring_t*)
+{
+}
+
+int ffrsa_ring_get_fd(ffrsa_ring_t*)
+{
+	return -1;
+}
+
+int ffrsa_ring_submit(ffrsa_ring_t*, const ffrsa_sqe_t*, int)
+{
+	return 0;
+}
+
+int ffrsa_ring_reap(ffrsa_ring_t*, ffrsa_cqe_t*, int)
+{
+	return 0;
+}
+
+int ffrsa_ring_wait(ffrsa_ring_t*, ffrsa_cqe_t*, int)
+{
+	return 0;
+}
+#endif
+
+typedef struct FFRSA_KEYPOOL_SLOT
+{
+	uint32_t bits;
+	ffrsa_t** keys;
+	int head;
+	int count;
+	int pending;
+} ffrsa_keypool_slot_t;
+
+typedef struct FFRSA_KEYPOOL
+{
+	ffrsa_keypool_slot_t* slots;
+	int num_sizes;
+	int pool_size;
+	pthread_t* threads;
+	int num_threads;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	uint8_t stopping;
+} ffrsa_keypool_t;
+
+//Returns the slot that is furthest from full, or NULL if every slot is full or being filled.
+//Must be called with the pool mutex held.
+static ffrsa_keypool_slot_t* ffrsa_keypool_next_slot(ffrsa_keypool_t* pool)
+{
+	ffrsa_keypool_slot_t* ret = NULL;
+	int min_fill = pool->pool_size;
+	for(int i=0;i<pool->num_sizes;i++)
+	{
+		ffrsa_keypool_slot_t* slot = &pool->slots[i];
+		int fill = slot->count + slot->pending;
+		if(slot->bits > 0 && fill < min_fill)
+		{
+			ret = slot;
+			min_fill = fill;
+		}
+	}
+	return ret;
+}
+
+static void* ffrsa_keypool_thread(void* param)
+{
+	ffrsa_keypool_t* pool = (ffrsa_keypool_t*)param;
+#if defined(__linux__)
+	//refills should only use otherwise idle cpu time
+	setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#endif
+	pthread_mutex_lock(&pool->mutex);
+	while(!pool->stopping)
+	{
+		ffrsa_keypool_slot_t* slot = ffrsa_keypool_next_slot(pool);
+		if(slot == NULL)
+		{
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+			continue;
+		}
+		slot->pending++;
+		uint32_t bits = slot->bits;
+		pthread_mutex_unlock(&pool->mutex);
+		ffrsa_t* key = ffrsa_create_parallel(bits, 1);
+		pthread_mutex_lock(&pool->mutex);
+		slot->pending--;
+		if(key == NULL)
+		{
+			fflog_debug_print("failed to create a %u bit key. No more keys of this size will be pooled.\n", bits);
+			slot->bits = 0;
+			continue;
+		}
+		slot->keys[(slot->head + slot->count)%pool->pool_size] = key;
+		slot->count++;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+//Create a pool that keeps pool_size keys ready for each of the num_sizes bit lengths in bits.
+//Keys are generated by num_threads low priority background threads.
+ffrsa_keypool_t* ffrsa_keypool_create(const uint32_t* bits, int num_sizes, int pool_size, int num_threads)
+{
+	if(bits == NULL || num_sizes < 1 || pool_size < 1 || num_threads < 1)
+	{
+		fflog_debug_print("invalid argument(s).\n");
+		return NULL;
+	}
+	ffrsa_keypool_t* ret = ffmem_alloc(ffrsa_keypool_t);
+	memset(ret, 0, sizeof(ffrsa_keypool_t));
+	ret->num_sizes = num_sizes;
+	ret->pool_size = pool_size;
+	ret->slots = ffmem_alloc_arr(ffrsa_keypool_slot_t, num_sizes);
+	for(int i=0;i<num_sizes;i++)
+	{
+		ret->slots[i].bits = bits[i];
+		ret->slots[i].keys = ffmem_alloc_arr(ffrsa_t*, pool_size);
+		ret->slots[i].head = 0;
+		ret->slots[i].count = 0;
+		ret->slots[i].pending = 0;
+	}
+	pthread_mutex_init(&ret->mutex, NULL);
+	pthread_cond_init(&ret->cond, NULL);
+	ret->threads = ffmem_alloc_arr(pthread_t, num_threads);
+	for(int i=0;i<num_threads;i++)
+	{
+		if(pthread_create(&ret->threads[i], NULL, ffrsa_keypool_thread, ret) != 0)
+			break;
+		ret->num_threads++;
+	}
+	if(ret->num_threads == 0)
+	{
+		fflog_debug_print("failed to start any key generation threads.\n");
+		ffrsa_keypool_destroy(ret);
+		return NULL;
+	}
+	return ret;
+}
+
+//Stops the background threads and destroys every key still in the pool. This blocks until
+//key generations already in progress finish.
+void ffrsa_keypool_destroy(ffrsa_keypool_t* pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+	for(int i=0;i<pool->num_threads;i++)
+		pthread_join(pool->threads[i], NULL);
+	for(int i=0;i<pool->num_sizes;i++)
+	{
+		ffrsa_keypool_slot_t* slot = &pool->slots[i];
+		for(int k=0;k<slot->count;k++)
+			ffrsa_destroy(slot->keys[(slot->head + k)%pool->pool_size]);
+		ffmem_free_arr(slot->keys);
+	}
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mutex);
+	ffmem_free_arr(pool->threads);
+	ffmem_free_arr(pool->slots);
+	ffmem_free(pool);
+}
+
+//Take a ready key with the specified number of bits out of the pool. The caller owns the
+//returned key and destroys it with ffrsa_destroy. Returns NULL if no key of that size is ready.
+ffrsa_t* ffrsa_keypool_take(ffrsa_keypool_t* pool, uint32_t bits)
+{
+	ffrsa_t* ret = NULL;
+	pthread_mutex_lock(&pool->mutex);
+	for(int i=0;i<pool->num_sizes;i++)
+	{
+		ffrsa_keypool_slot_t* slot = &pool->slots[i];
+		if(slot->bits == bits && slot->count > 0)
+		{
+			ret = slot->keys[slot->head];
+			slot->head = (slot->head + 1)%pool->pool_size;
+			slot->count--;
+			pthread_cond_signal(&pool->cond);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return ret;
+}
+
+//Returns the number of keys with the specified number of bits that are ready to be taken.
+int ffrsa_keypool_get_ready_count(ffrsa_keypool_t* pool, uint32_t bits)
+{
+	int ret = 0;
+	pthread_mutex_lock(&pool->mutex);
+	for(int i=0;i<pool->num_sizes;i++)
+	{
+		if(pool->slots[i].bits == bits)
+			ret += pool->slots[i].count;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return ret;
 }
@@ -0,0 +1,295 @@
+/*
+ * ffbi_bench.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jesse Wang
+ */
+
+//Microbenchmarks of the ffbi primitives, reported as JSON on stdout so that runs of two builds can be
+//compared line by line. Build this with the library sources and run it on an idle machine:
+//
+//	ffbi_bench [max bits] [samples]
+//
+//Operands are drawn from a fixed seed, so every build times the same values. Each benchmark is warmed
+//up, calibrated to a number of calls per sample that takes at least FFBI_BENCH_SAMPLE_NS, and then
+//sampled the given number of times (FFBI_BENCH_DEFAULT_SAMPLES by default). Times are per call in
+//nanoseconds. Sizes go from 512 bits up to max bits (16384 by default, at most 2^20), doubling each
+//time; the exponentiation and primality benchmarks stop at lower sizes unless max bits asks for more,
+//since a single call there takes seconds.
+
+#include "../internal/ffbi.h"
+#include "../internal/ffrand.h"
+#include "../internal/ffmem.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FFBI_BENCH_MIN_BITS 512
+#define FFBI_BENCH_MAX_BITS 16384
+//largest max bits accepted, which keeps the doubling sizes from overflowing
+#define FFBI_BENCH_LIMIT_BITS (1 << 20)
+#define FFBI_BENCH_MOD_POW_MAX_BITS 4096
+#define FFBI_BENCH_PRIME_MAX_BITS 2048
+#define FFBI_BENCH_DEFAULT_SAMPLES 21
+#define FFBI_BENCH_WARMUP_NS 20000000
+#define FFBI_BENCH_SAMPLE_NS 2000000
+#define FFBI_BENCH_PRIME_TESTS 20
+#define FFBI_BENCH_SIEVE_SIZE 100000
+
+static const char _seed[] = "ffbi_bench";
+
+typedef struct FFBI_BENCH
+{
+	ffbi_t* a;
+	ffbi_t* b;
+	ffbi_t* m;
+	ffbi_t* result;
+	ffbi_t* quotient;
+	ffbi_t* scratch1;
+	ffbi_t* scratch2;
+	ffbi_sieve_t* sieve;
+	uint8_t* buffer;
+	int buffer_size;
+	uint32_t bits;
+} ffbi_bench_t;
+
+static uint64_t ffbi_bench_now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static int ffbi_bench_cmp_double(const void* a, const void* b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+//Nearest rank percentile of sorted samples.
+static double ffbi_bench_percentile(const double* sorted, int num_samples, int percent)
+{
+	int rank = (percent*num_samples + 99)/100;
+	if(rank < 1)
+		rank = 1;
+	return sorted[rank - 1];
+}
+
+//Sets p to a random value of exactly bits bits, with the lowest bit set if odd is nonzero.
+static void ffbi_bench_random(ffbi_t* p, uint32_t bits, int odd)
+{
+	ffbi_random(p, bits);
+	ffbi_word_t* digits;
+	uint32_t num_used_digits, num_allocated_digits, bits_per_digit;
+	uint32_t top = (bits - 1)/FFBI_BITS_PER_DIGIT;
+	ffbi_get_digits(p, &digits, &num_used_digits, &num_allocated_digits, &bits_per_digit);
+	if(top >= num_allocated_digits)
+	{
+		ffbi_reallocate_digits(p, top + 1, 1);
+		ffbi_get_digits(p, &digits, &num_used_digits, &num_allocated_digits, &bits_per_digit);
+	}
+	if(top >= num_used_digits)
+	{
+		memset(&digits[num_used_digits], 0, (top + 1 - num_used_digits)*sizeof(ffbi_word_t));
+		num_used_digits = top + 1;
+	}
+	digits[top] |= ((ffbi_word_t)1) << ((bits - 1)%FFBI_BITS_PER_DIGIT);
+	if(odd)
+		digits[0] |= 1;
+	ffbi_set_digits(p, NULL, num_used_digits, num_allocated_digits, FFBI_BITS_PER_DIGIT);
+}
+
+static void ffbi_bench_mul(ffbi_bench_t* t)
+{
+	ffbi_mul(t->result, t->a, t->b);
+}
+
+static void ffbi_bench_div_impl(ffbi_bench_t* t)
+{
+	ffbi_div_impl(t->quotient, t->a, t->m, t->result, t->scratch1, t->scratch2);
+}
+
+static void ffbi_bench_mod_pow(ffbi_bench_t* t)
+{
+	ffbi_mod_pow(t->result, t->a, t->b, t->m, NULL);
+}
+
+static void ffbi_bench_mod_inv(ffbi_bench_t* t)
+{
+	ffbi_mod_inv(t->result, t->a, t->m);
+}
+
+static void ffbi_bench_is_large_prime(ffbi_bench_t* t)
+{
+	ffbi_is_large_prime(t->m, FFBI_BENCH_PRIME_TESTS, t->sieve, NULL);
+}
+
+static void ffbi_bench_serialize(ffbi_bench_t* t)
+{
+	ffbi_serialize(t->a, t->buffer, t->buffer_size);
+}
+
+static void ffbi_bench_deserialize(ffbi_bench_t* t)
+{
+	ffbi_deserialize(t->result, t->buffer, t->buffer_size);
+}
+
+static void ffbi_bench_random_bits(ffbi_bench_t* t)
+{
+	ffbi_random(t->result, t->bits);
+}
+
+//Draws the operands of every benchmark at the given size. Everything is reseeded first, so the
+//operands of one size don't depend on which benchmarks ran before.
+static void ffbi_bench_setup(ffbi_bench_t* t, ffrand_t* r, uint32_t bits)
+{
+	ffrand_reseed(r, _seed, sizeof(_seed), bits);
+	t->bits = bits;
+	ffbi_bench_random(t->a, bits, 0);
+	ffbi_bench_random(t->b, bits, 0);
+	ffbi_bench_random(t->m, bits, 1);
+	if(t->buffer)
+		ffmem_free_arr(t->buffer);
+	t->buffer_size = ffbi_get_serialized_size(t->a);
+	t->buffer = ffmem_alloc_arr(uint8_t, t->buffer_size);
+	ffbi_serialize(t->a, t->buffer, t->buffer_size);
+}
+
+typedef struct FFBI_BENCH_CASE
+{
+	const char* name;
+	void (*run)(ffbi_bench_t* t);
+	uint32_t max_bits; //skipped above this many bits unless they are asked for
+} ffbi_bench_case_t;
+
+//Times run and prints one JSON record. first is nonzero for the first record of the output.
+static void ffbi_bench_measure(const char* name, void (*run)(ffbi_bench_t*), ffbi_bench_t* t, int num_samples, int first)
+{
+	//warm up caches, the workspace and the branch predictors, and see how long a call takes
+	uint64_t start = ffbi_bench_now_ns();
+	uint64_t num_calls = 0;
+	uint64_t elapsed;
+	do
+	{
+		run(t);
+		num_calls++;
+		elapsed = ffbi_bench_now_ns() - start;
+	} while(elapsed < FFBI_BENCH_WARMUP_NS);
+	uint64_t reps = FFBI_BENCH_SAMPLE_NS*num_calls/elapsed;
+	if(reps < 1)
+		reps = 1;
+	double* samples = ffmem_alloc_arr(double, num_samples);
+	for(int i=0;i<num_samples;i++)
+	{
+		start = ffbi_bench_now_ns();
+		for(uint64_t j=0;j<reps;j++)
+			run(t);
+		samples[i] = (double)(ffbi_bench_now_ns() - start)/reps;
+	}
+	qsort(samples, num_samples, sizeof(double), ffbi_bench_cmp_double);
+	printf("%s\n    {\"name\": \"%s\", \"bits\": %u, \"reps\": %llu, \"samples\": %d, "
+		"\"min_ns\": %.1f, \"p10_ns\": %.1f, \"p25_ns\": %.1f, \"median_ns\": %.1f, \"p75_ns\": %.1f, \"p90_ns\": %.1f, \"max_ns\": %.1f}",
+		first ? "" : ",", name, t->bits, (unsigned long long)reps, num_samples,
+		samples[0], ffbi_bench_percentile(samples, num_samples, 10), ffbi_bench_percentile(samples, num_samples, 25),
+		ffbi_bench_percentile(samples, num_samples, 50), ffbi_bench_percentile(samples, num_samples, 75),
+		ffbi_bench_percentile(samples, num_samples, 90), samples[num_samples - 1]);
+	fflush(stdout);
+	ffmem_free_arr(samples);
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t max_bits = argc > 1 ? (uint32_t)atoi(argv[1]) : FFBI_BENCH_MAX_BITS;
+	int num_samples = argc > 2 ? atoi(argv[2]) : FFBI_BENCH_DEFAULT_SAMPLES;
+	if(max_bits < FFBI_BENCH_MIN_BITS || max_bits > FFBI_BENCH_LIMIT_BITS || num_samples < 1)
+	{
+		fprintf(stderr, "usage: %s [%d <= max bits <= %d] [samples >= 1]\n", argv[0], FFBI_BENCH_MIN_BITS, FFBI_BENCH_LIMIT_BITS);
+		return 1;
+	}
+	const ffbi_bench_case_t cases[] = {
+		{"mul", ffbi_bench_mul, FFBI_BENCH_MAX_BITS},
+		{"div_impl", ffbi_bench_div_impl, FFBI_BENCH_MAX_BITS},
+		{"mod_pow", ffbi_bench_mod_pow, FFBI_BENCH_MOD_POW_MAX_BITS},
+		{"mod_inv", ffbi_bench_mod_inv, FFBI_BENCH_MAX_BITS},
+		{"is_large_prime", ffbi_bench_is_large_prime, FFBI_BENCH_PRIME_MAX_BITS},
+		{"serialize", ffbi_bench_serialize, FFBI_BENCH_MAX_BITS},
+		{"deserialize", ffbi_bench_deserialize, FFBI_BENCH_MAX_BITS},
+		{"random", ffbi_bench_random_bits, FFBI_BENCH_MAX_BITS}};
+	const int num_cases = sizeof(cases)/sizeof(cases[0]);
+
+	ffrand_t* r = ffrand_create_seeded(_seed, sizeof(_seed));
+	ffbi_ctx_set_rand(ffbi_ctx_get_thread(), r);
+	ffbi_bench_t t;
+	t.a = ffbi_create();
+	t.b = ffbi_create();
+	t.m = ffbi_create();
+	t.result = ffbi_create();
+	t.quotient = ffbi_create();
+	t.scratch1 = ffbi_create();
+	t.scratch2 = ffbi_create();
+	t.buffer = NULL;
+	t.sieve = ffbi_sieve_create();
+	ffbi_get_sieve(t.sieve, FFBI_BENCH_SIEVE_SIZE);
+	ffbi_get_sieve_primorials(t.sieve, FFBI_BITS_PER_DIGIT);
+	ffbi_t* product = ffbi_create();
+	ffbi_t* gcd = ffbi_create();
+	ffbi_t* one = ffbi_create();
+	ffbi_from_string(one, "1", -1, 10);
+
+	printf("{\n  \"bits_per_digit\": %d,\n  \"seed\": \"%s\",\n  \"results\": [", FFBI_BITS_PER_DIGIT, _seed);
+	int first = 1;
+	for(uint32_t bits=FFBI_BENCH_MIN_BITS;bits<=max_bits;bits*=2)
+	{
+		for(int i=0;i<num_cases;i++)
+		{
+			//the default caps only apply when the caller didn't ask for sizes past them
+			if(bits > cases[i].max_bits && max_bits <= FFBI_BENCH_MAX_BITS)
+				continue;
+			ffbi_bench_setup(&t, r, bits);
+			if(cases[i].run == ffbi_bench_div_impl)
+			{
+				//a double-length dividend, as left by a multiplication
+				ffbi_mul(product, t.a, t.b);
+				ffbi_copy(t.a, product);
+			}
+			else if(cases[i].run == ffbi_bench_mod_inv)
+			{
+				//a has to be invertible
+				ffbi_gcd(gcd, t.a, t.m, product);
+				while(ffbi_cmp(gcd, one) != 0)
+				{
+					ffbi_bench_random(t.a, bits - 1, 0);
+					ffbi_gcd(gcd, t.a, t.m, product);
+				}
+			}
+			else if(cases[i].run == ffbi_bench_is_large_prime)
+			{
+				//a prime takes every round of the test, where most candidates fail on the sieve
+				ffbi_destroy(t.m);
+				t.m = ffbi_create_random_large_prime(bits, FFBI_BENCH_PRIME_TESTS, t.sieve);
+			}
+			fprintf(stderr, "%s %u\n", cases[i].name, bits);
+			ffbi_bench_measure(cases[i].name, cases[i].run, &t, num_samples, first);
+			first = 0;
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	ffbi_destroy(product);
+	ffbi_destroy(gcd);
+	ffbi_destroy(one);
+	ffbi_destroy(t.a);
+	ffbi_destroy(t.b);
+	ffbi_destroy(t.m);
+	ffbi_destroy(t.result);
+	ffbi_destroy(t.quotient);
+	ffbi_destroy(t.scratch1);
+	ffbi_destroy(t.scratch2);
+	ffbi_sieve_destroy(t.sieve);
+	ffmem_free_arr(t.buffer);
+	ffbi_ctx_set_rand(ffbi_ctx_get_thread(), NULL);
+	ffrand_destroy(r);
+	return 0;
+}
@@ -0,0 +1,390 @@
+/*
+ * ffbi_check.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jesse Wang
+ */
+
+//Self-checks of ffbi and ffrsa against known values. Build this with the library sources and run it
+//after changing either of them:
+//
+//	ffbi_check
+//
+//Values are picked so that the right answer is known in closed form, like (2^n - 1)^2 or 2^1000 mod
+//2^521 - 1, and sizes go past the point where products are tiled. Every failed check is printed, and
+//the exit status is 1 if there were any.
+
+#include "../internal/ffbi.h"
+#include "../internal/ffmem.h"
+#include "../ffrsa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define FFBI_CHECK_RSA_BITS 1024
+#define FFBI_CHECK_RSA_MSGS 8
+#define FFBI_CHECK_RSA_MSG_LEN 40
+#define FFBI_CHECK_RSA_THREADS 2
+
+//100! in base 10 and 16
+static const char _factorial_100[] = "93326215443944152681699238856266700490715968264381621468592963895217599993229915608941463976156518286253697920827223758251185210916864000000000000000000000000";
+static const char _factorial_100_hex[] = "1b30964ec395dc24069528d54bbda40d16e966ef9a70eb21b5b2943a321cdf10391745570cca9420c6ecb3b72ed2ee8b02ea2735c61a000000000000000000000000";
+static const char _seed[] = "ffbi_check";
+
+static int _num_checks = 0;
+static int _num_failed = 0;
+
+static void ffbi_check(int ok, const char* what, uint32_t bits)
+{
+	_num_checks++;
+	if(ok)
+		return;
+	_num_failed++;
+	printf("FAIL %s at %u bits\n", what, bits);
+}
+
+//Returns p in base 16 or 10.
+static std::string ffbi_check_string(ffbi_t* p, int base)
+{
+	int size = ffbi_get_string_size(p, base);
+	char* buffer = ffmem_alloc_arr(char, size);
+	std::string ret = ffbi_to_string(p, buffer, size, base) > 0 ? buffer : "";
+	ffmem_free_arr(buffer);
+	return ret;
+}
+
+//The hex digits of count copies of c.
+static std::string ffbi_check_run(char c, uint32_t count)
+{
+	return std::string(count, c);
+}
+
+//p = 2^bits + add
+static void ffbi_check_pow2(ffbi_t* p, uint32_t bits, int add)
+{
+	ffbi_from_string(p, "1", -1, 10);
+	ffbi_shl(p, p, bits);
+	if(add > 0)
+		ffbi_add_u(p, p, (uint32_t)add);
+	else if(add < 0)
+	{
+		ffbi_t* sub = ffbi_create();
+		ffbi_from_string(sub, "1", -1, 10);
+		if(add < -1)
+			ffbi_add_u(sub, sub, (uint32_t)(-add - 1));
+		ffbi_sub(p, p, sub);
+		ffbi_destroy(sub);
+	}
+}
+
+//Products and quotients of 2^n - 1 and 2^n + 1 for n a multiple of 4, whose hex digits are runs.
+static void ffbi_check_mul_div(uint32_t n)
+{
+	ffbi_t* a = ffbi_create();
+	ffbi_t* b = ffbi_create();
+	ffbi_t* d = ffbi_create();
+	ffbi_t* r = ffbi_create();
+	ffbi_check_pow2(a, n, -1);
+	ffbi_check_pow2(b, n, 1);
+	uint32_t h = n/4;
+	std::string square = ffbi_check_run('f', h - 1) + "e" + ffbi_check_run('0', h - 1) + "1";
+
+	//(2^n - 1)(2^n + 1) = 2^2n - 1
+	ffbi_mul(d, a, b);
+	ffbi_check(ffbi_check_string(d, 16) == ffbi_check_run('f', 2*h), "mul", n);
+	//(2^n - 1)^2 = 2^2n - 2^(n+1) + 1
+	ffbi_mul(r, a, a);
+	ffbi_check(ffbi_check_string(r, 16) == square, "sqr", n);
+	ffbi_copy(r, a);
+	ffbi_mul(r, r, r);
+	ffbi_check(ffbi_check_string(r, 16) == square, "sqr in place", n);
+	ffbi_copy(r, b);
+	ffbi_mul_add(r, a, b);
+	//(2^n + 1) + (2^n - 1)(2^n + 1) = 2^2n + 2^n
+	ffbi_check(ffbi_check_string(r, 16) == "1" + ffbi_check_run('0', h - 1) + "1" + ffbi_check_run('0', h), "mul_add", n);
+
+	//(2^2n - 1)/(2^n - 1) = 2^n + 1
+	ffbi_div(r, d, a);
+	ffbi_check(ffbi_check_string(r, 16) == "1" + ffbi_check_run('0', h - 1) + "1", "div", n);
+	//(2^2n + 5) % (2^n - 1) = 6
+	ffbi_add_u(d, d, 6);
+	ffbi_mod(r, d, a);
+	ffbi_check(ffbi_check_string(r, 16) == "6", "mod", n);
+
+	//the same products with every operand in a mapped file
+	ffbi_t* ma = ffbi_create_mapped(NULL, n);
+	ffbi_t* mb = ffbi_create_mapped(NULL, n);
+	ffbi_t* md = ffbi_create_mapped(NULL, FFBI_BITS_PER_DIGIT);
+	ffbi_check(ma && mb && md, "create_mapped", n);
+	if(ma && mb && md)
+	{
+		ffbi_copy(ma, a);
+		ffbi_copy(mb, b);
+		ffbi_mul(md, ma, mb);
+		ffbi_check(ffbi_check_string(md, 16) == ffbi_check_run('f', 2*h), "mapped mul", n);
+		ffbi_mul(ma, ma, ma);
+		ffbi_check(ffbi_check_string(ma, 16) == square, "mapped sqr in place", n);
+	}
+	if(ma)
+		ffbi_destroy(ma);
+	if(mb)
+		ffbi_destroy(mb);
+	if(md)
+		ffbi_destroy(md);
+	ffbi_destroy(a);
+	ffbi_destroy(b);
+	ffbi_destroy(d);
+	ffbi_destroy(r);
+}
+
+//Modular arithmetic mod the Mersenne prime 2^521 - 1.
+static void ffbi_check_mod_arith()
+{
+	ffbi_t* m = ffbi_create();
+	ffbi_t* n = ffbi_create();
+	ffbi_t* e = ffbi_create();
+	ffbi_t* r = ffbi_create();
+	ffbi_t* scratch = ffbi_create();
+	ffbi_check_pow2(m, 521, -1);
+
+	//2^1000 = 2^479 mod m
+	std::string pow2_479 = "8" + ffbi_check_run('0', 119);
+	ffbi_from_string(n, "2", -1, 10);
+	ffbi_from_string(e, "1000", -1, 10);
+	ffbi_mod_pow(r, n, e, m, NULL);
+	ffbi_check(ffbi_check_string(r, 16) == pow2_479, "mod_pow", 521);
+	//Fermat
+	ffbi_from_string(n, "3", -1, 10);
+	ffbi_check_pow2(e, 521, -2);
+	ffbi_mod_pow(r, n, e, m, NULL);
+	ffbi_check(ffbi_check_string(r, 16) == "1", "mod_pow fermat", 521);
+	//1/2 = 2^520 mod m
+	ffbi_from_string(n, "2", -1, 10);
+	ffbi_mod_inv(r, n, m);
+	ffbi_check(ffbi_check_string(r, 16) == "1" + ffbi_check_run('0', 130), "mod_inv", 521);
+
+	//gcd(2^a - 1, 2^b - 1) = 2^gcd(a, b) - 1
+	ffbi_check_pow2(n, 20004, -1);
+	ffbi_check_pow2(e, 12000, -1);
+	ffbi_gcd(r, n, e, scratch);
+	ffbi_check(ffbi_check_string(r, 16) == "fff", "gcd", 20004);
+
+	//the same exponentiation through each form of modctx
+	ffbi_modctx_t* ctx = ffbi_modctx_create(m);
+	ffbi_check(ffbi_modctx_get_form(ctx) == FFBI_MODCTX_PSEUDO_MERSENNE, "modctx form", 521);
+	ffbi_from_string(n, "2", -1, 10);
+	ffbi_from_string(e, "1000", -1, 10);
+	ffbi_modctx_pow(ctx, r, n, e, NULL);
+	ffbi_check(ffbi_check_string(r, 16) == pow2_479, "modctx_pow", 521);
+	ffbi_modctx_destroy(ctx);
+	ctx = ffbi_modctx_create_form(m, FFBI_MODCTX_GENERAL);
+	ffbi_modctx_pow(ctx, r, n, e, NULL);
+	ffbi_check(ffbi_check_string(r, 16) == pow2_479, "modctx_pow general", 521);
+	ffbi_modctx_destroy(ctx);
+
+	//(m - 1)^2 = 1 mod m, and 100!^2 reduces like ffbi_mod does, for both folding forms
+	const int forms[] = {FFBI_MODCTX_PSEUDO_MERSENNE, FFBI_MODCTX_SOLINAS};
+	const uint32_t k[] = {255, 512};
+	const uint32_t term[] = {0, 256};
+	for(int i=0;i<2;i++)
+	{
+		//2^255 - 19 and 2^512 - 2^256 - 1
+		ffbi_check_pow2(m, k[i], i == 0 ? -19 : -1);
+		if(term[i])
+		{
+			ffbi_check_pow2(scratch, term[i], 0);
+			ffbi_sub(m, m, scratch);
+		}
+		ctx = ffbi_modctx_create_form(m, forms[i]);
+		ffbi_check(ctx != NULL, "modctx_create_form", k[i]);
+		if(ctx == NULL)
+			continue;
+		ffbi_check_pow2(scratch, 0, 0);
+		ffbi_sub(n, m, scratch);
+		ffbi_mul(n, n, n);
+		ffbi_modctx_reduce(ctx, r, n, NULL);
+		ffbi_check(ffbi_check_string(r, 16) == "1", "modctx_reduce", k[i]);
+		ffbi_from_string(n, _factorial_100, -1, 10);
+		ffbi_mul(n, n, n);
+		ffbi_modctx_reduce(ctx, r, n, NULL);
+		ffbi_mod(e, n, m);
+		ffbi_check(ffbi_cmp(r, e) == 0, "modctx_reduce 100!^2", k[i]);
+		ffbi_modctx_destroy(ctx);
+	}
+	ffbi_destroy(m);
+	ffbi_destroy(n);
+	ffbi_destroy(e);
+	ffbi_destroy(r);
+	ffbi_destroy(scratch);
+}
+
+//Strings, bytes and views.
+static void ffbi_check_conversions()
+{
+	ffbi_t* p = ffbi_create();
+	ffbi_t* q = ffbi_create();
+	ffbi_t* k = ffbi_create();
+	char num[8];
+	ffbi_from_string(p, "1", -1, 10);
+	for(int i=2;i<=100;i++)
+	{
+		snprintf(num, sizeof(num), "%d", i);
+		ffbi_from_string(k, num, -1, 10);
+		ffbi_mul(p, p, k);
+	}
+	ffbi_check(ffbi_check_string(p, 10) == _factorial_100, "to_string 10", 525);
+	ffbi_check(ffbi_check_string(p, 16) == _factorial_100_hex, "to_string 16", 525);
+	ffbi_from_string(q, _factorial_100_hex, -1, 16);
+	ffbi_check(ffbi_cmp(p, q) == 0, "from_string 16", 525);
+	ffbi_from_string(q, _factorial_100, -1, 10);
+	ffbi_check(ffbi_cmp(p, q) == 0, "from_string 10", 525);
+
+	//big endian bytes 0x01 to 0x40 read as one number
+	uint8_t bytes[64];
+	uint8_t out[64];
+	std::string hex;
+	for(int i=0;i<64;i++)
+	{
+		bytes[i] = (uint8_t)(i + 1);
+		snprintf(num, sizeof(num), "%02x", i + 1);
+		hex += num;
+	}
+	ffbi_import_be(p, bytes, sizeof(bytes));
+	ffbi_check(ffbi_check_string(p, 16) == hex.substr(1), "import_be", 512);
+	ffbi_check(ffbi_export_be(p, out, sizeof(out)) == 0 && memcmp(bytes, out, sizeof(out)) == 0, "export_be", 512);
+	ffbi_check_pow2(p, 20000, -1);
+	int size = ffbi_get_serialized_size(p);
+	uint8_t* buffer = ffmem_alloc_arr(uint8_t, size);
+	ffbi_serialize(p, buffer, size);
+	ffbi_deserialize(q, buffer, size);
+	ffbi_check(ffbi_cmp(p, q) == 0, "serialize", 20000);
+	ffmem_free_arr(buffer);
+
+	//views are read as usual but never written
+	ffbi_word_t digits[2] = {5, 7};
+	ffbi_view_t* v = ffbi_view_create();
+	ffbi_view_set_digits(v, digits, 2);
+	ffbi_from_string(k, "1", -1, 10);
+	ffbi_add(p, v, k);
+	ffbi_check(ffbi_check_string(p, 16) == "e000000000000006", "view input", 64);
+	ffbi_add(v, p, k);
+	ffbi_check(digits[0] == 5 && digits[1] == 7 && ffbi_reallocate_digits(v, 100, 1) != 0, "view destination", 64);
+	ffbi_destroy(v);
+	ffbi_destroy(p);
+	ffbi_destroy(q);
+	ffbi_destroy(k);
+}
+
+//Encryption and decryption round trips through each way of running them.
+static void ffbi_check_rsa()
+{
+	ffrsa_t* created = ffrsa_create_seeded(FFBI_CHECK_RSA_BITS, (const uint8_t*)_seed, sizeof(_seed));
+	int key_size = ffrsa_get_private_key_size(created);
+	uint8_t* key = ffmem_alloc_arr(uint8_t, key_size);
+	ffrsa_get_private_key(created, key, key_size);
+	ffrsa_t* rsa = ffrsa_create_from_private_key(key);
+	ffmem_free_arr(key);
+	ffrsa_destroy(created);
+
+	int ct_len = ffrsa_get_ciphertext_len(rsa);
+	int max_len = ffrsa_get_max_msg_len(rsa);
+	uint8_t msgs[FFBI_CHECK_RSA_MSGS][FFBI_CHECK_RSA_MSG_LEN];
+	uint8_t* src[FFBI_CHECK_RSA_MSGS];
+	int lens[FFBI_CHECK_RSA_MSGS];
+	for(int i=0;i<FFBI_CHECK_RSA_MSGS;i++)
+	{
+		//no 0 or 1 bytes, which unpadding can take for the separator
+		for(int j=0;j<FFBI_CHECK_RSA_MSG_LEN;j++)
+			msgs[i][j] = (uint8_t)((i*13 + j)%200 + 2);
+		src[i] = msgs[i];
+		lens[i] = FFBI_CHECK_RSA_MSG_LEN;
+	}
+	uint8_t* ct = ffmem_alloc_arr(uint8_t, ct_len*FFBI_CHECK_RSA_MSGS);
+	uint8_t* pt = ffmem_alloc_arr(uint8_t, max_len*FFBI_CHECK_RSA_MSGS);
+	int ct_lens[FFBI_CHECK_RSA_MSGS];
+	int pt_lens[FFBI_CHECK_RSA_MSGS];
+	int status[FFBI_CHECK_RSA_MSGS];
+
+	int ok = 1;
+	for(int i=0;i<FFBI_CHECK_RSA_MSGS;i++)
+	{
+		uint8_t* result;
+		int result_len;
+		ok &= ffrsa_encrypt(rsa, msgs[i], FFBI_CHECK_RSA_MSG_LEN) == 0;
+		ffrsa_get_result(rsa, &result, &result_len);
+		ok &= result_len == ct_len;
+		memcpy(ct + i*ct_len, result, result_len);
+		ok &= ffrsa_decrypt(rsa, ct + i*ct_len, ct_len) == 0;
+		ffrsa_get_result(rsa, &result, &result_len);
+		ok &= result_len == FFBI_CHECK_RSA_MSG_LEN && memcmp(result, msgs[i], FFBI_CHECK_RSA_MSG_LEN) == 0;
+	}
+	ffbi_check(ok, "rsa", FFBI_CHECK_RSA_BITS);
+
+	ffrsa_pool_t* pool = ffrsa_pool_create(ffrsa_get_key(rsa), FFBI_CHECK_RSA_THREADS);
+	ok = ffrsa_encrypt_batch(pool, src, lens, FFBI_CHECK_RSA_MSGS, ct, ct_len, ct_lens, status) == 0;
+	uint8_t* ct_src[FFBI_CHECK_RSA_MSGS];
+	for(int i=0;i<FFBI_CHECK_RSA_MSGS;i++)
+		ct_src[i] = ct + i*ct_len;
+	ok &= ffrsa_decrypt_batch(pool, ct_src, ct_lens, FFBI_CHECK_RSA_MSGS, pt, max_len, pt_lens, status) == 0;
+	for(int i=0;i<FFBI_CHECK_RSA_MSGS;i++)
+		ok &= pt_lens[i] == FFBI_CHECK_RSA_MSG_LEN && memcmp(pt + i*max_len, msgs[i], FFBI_CHECK_RSA_MSG_LEN) == 0;
+	ffbi_check(ok, "rsa batch", FFBI_CHECK_RSA_BITS);
+	ffrsa_pool_destroy(pool);
+
+#if defined(__linux__)
+	//decrypt the batch ciphertexts through a ring, reaping in whatever order they complete
+	ffrsa_ring_t* ring = ffrsa_ring_create(ffrsa_get_key(rsa), FFBI_CHECK_RSA_MSGS/2, FFBI_CHECK_RSA_THREADS);
+	ffbi_check(ring != NULL, "rsa ring create", FFBI_CHECK_RSA_BITS);
+	if(ring)
+	{
+		ffrsa_sqe_t sqes[FFBI_CHECK_RSA_MSGS];
+		ffrsa_cqe_t cqes[FFBI_CHECK_RSA_MSGS];
+		memset(pt, 0, max_len*FFBI_CHECK_RSA_MSGS);
+		for(int i=0;i<FFBI_CHECK_RSA_MSGS;i++)
+		{
+			sqes[i].user_tag = (uint64_t)i;
+			sqes[i].op = FFRSA_OP_DECRYPT;
+			sqes[i].src = ct_src[i];
+			sqes[i].src_len = ct_lens[i];
+			sqes[i].out = pt + i*max_len;
+			sqes[i].out_size = max_len;
+		}
+		ok = 1;
+		int submitted = 0;
+		int completed = 0;
+		while(completed < FFBI_CHECK_RSA_MSGS)
+		{
+			submitted += ffrsa_ring_submit(ring, sqes + submitted, FFBI_CHECK_RSA_MSGS - submitted);
+			int n = ffrsa_ring_wait(ring, cqes, FFBI_CHECK_RSA_MSGS);
+			for(int i=0;i<n;i++)
+			{
+				int tag = (int)cqes[i].user_tag;
+				ok &= cqes[i].status == 0 && cqes[i].out_len == FFBI_CHECK_RSA_MSG_LEN;
+				ok &= memcmp(pt + tag*max_len, msgs[tag], FFBI_CHECK_RSA_MSG_LEN) == 0;
+			}
+			completed += n;
+		}
+		ffbi_check(ok, "rsa ring", FFBI_CHECK_RSA_BITS);
+		ffrsa_ring_destroy(ring);
+	}
+#endif
+	ffmem_free_arr(ct);
+	ffmem_free_arr(pt);
+	ffrsa_destroy(rsa);
+}
+
+int main()
+{
+	//below, at and well past the size from which products are tiled
+	const uint32_t sizes[] = {64, 1024, 4096, 8192, 20000, 40000};
+	for(size_t i=0;i<sizeof(sizes)/sizeof(sizes[0]);i++)
+		ffbi_check_mul_div(sizes[i]);
+	ffbi_check_mod_arith();
+	ffbi_check_conversions();
+	ffbi_check_rsa();
+	ffbi_ctx_release_thread();
+	ffbi_check(ffmem_count_get() == 0, "allocations freed", 0);
+	printf("%d checks, %d failed\n", _num_checks, _num_failed);
+	return _num_failed ? 1 : 0;
+}
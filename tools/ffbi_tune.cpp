@@ -0,0 +1,360 @@
+/*
+ * ffbi_tune.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: Jesse Wang
+ */
+
+//Measures the crossover points of ffbi on the host and writes them to a header, by default
+//internal/ffbi_tune.h, which ffbi.h includes when it exists. Build this with the library sources,
+//run it from the repository root on an idle machine like the ones the library will run on, then
+//rebuild the library. Every candidate is timed on the same inputs, drawn from a fixed seed, and the
+//median of several runs is kept.
+//
+//	ffbi_tune [output path]
+//
+//Measured:
+//	FFBI_FIXED_WINDOW_BITS                      window of ffbi_fixed_mod_pow at 1024 and 2048 bits
+//	FFBI_MODCTX_MIN_FOLD_BITS                   shortest Solinas fold that beats ffbi_div_impl
+//	FFBI_MODCTX_MIN_PSEUDO_MERSENNE_FOLD_BITS   shortest pseudo-Mersenne fold that beats ffbi_div_impl
+//	FFRSA_SIEVE_SIZE                            sieve bound of ffrsa_create, counting the time to build the sieve
+//	FFRSA_SIEVE_PRIMORIAL_BITS                  primorial size of that sieve
+//
+//FFBI_MIN_ALLOC_DIGITS isn't measured. It is the smallest size the API accepts rather than a cost
+//tradeoff, and changing it changes which arguments are rejected.
+
+#include "../internal/ffbi.h"
+#include "../internal/ffbi_fixed.h"
+#include "../internal/ffrand.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FFBI_TUNE_RUNS 7
+#define FFBI_TUNE_MAX_WINDOW_BITS 6
+#define FFBI_TUNE_SIEVE_KEYS 6
+#define FFBI_TUNE_PRIME_BITS 1024
+
+static const char _seed[] = "ffbi_tune";
+
+static double ffbi_tune_now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000.0 + ts.tv_nsec/1000000.0;
+}
+
+static int ffbi_tune_cmp_double(const void* a, const void* b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+//Returns the median time in milliseconds of FFBI_TUNE_RUNS runs of func, each calling it reps times.
+static double ffbi_tune_median(void (*func)(void*), void* param, int reps)
+{
+	double samples[FFBI_TUNE_RUNS];
+	func(param);
+	for(int i=0;i<FFBI_TUNE_RUNS;i++)
+	{
+		double start = ffbi_tune_now_ms();
+		for(int j=0;j<reps;j++)
+			func(param);
+		samples[i] = (ffbi_tune_now_ms() - start)/reps;
+	}
+	qsort(samples, FFBI_TUNE_RUNS, sizeof(double), ffbi_tune_cmp_double);
+	return samples[FFBI_TUNE_RUNS/2];
+}
+
+//Sets p to a random value of exactly bits bits, with the lowest bit set if odd is nonzero.
+static void ffbi_tune_random(ffbi_t* p, uint32_t bits, int odd)
+{
+	ffbi_random(p, bits);
+	ffbi_word_t* digits;
+	uint32_t num_used_digits, num_allocated_digits, bits_per_digit;
+	ffbi_get_digits(p, &digits, &num_used_digits, &num_allocated_digits, &bits_per_digit);
+	uint32_t top = (bits - 1)/FFBI_BITS_PER_DIGIT;
+	if(top >= num_used_digits)
+	{
+		memset(&digits[num_used_digits], 0, (top + 1 - num_used_digits)*sizeof(ffbi_word_t));
+		num_used_digits = top + 1;
+	}
+	digits[top] |= ((ffbi_word_t)1) << ((bits - 1)%FFBI_BITS_PER_DIGIT);
+	if(odd)
+		digits[0] |= 1;
+	ffbi_set_digits(p, NULL, num_used_digits, num_allocated_digits, FFBI_BITS_PER_DIGIT);
+}
+
+template<uint32_t Bits>
+struct ffbi_tune_pow
+{
+	ffbi_fixed_mont<Bits> ctx;
+	ffbi_fixed<Bits> n;
+	ffbi_fixed<Bits> e;
+	ffbi_fixed<Bits> result;
+};
+
+template<uint32_t Bits, uint32_t WindowBits>
+static void ffbi_tune_pow_run(void* param)
+{
+	ffbi_tune_pow<Bits>* t = (ffbi_tune_pow<Bits>*)param;
+	ffbi_fixed_mod_pow<Bits, WindowBits>(&t->result, &t->n, &t->e, &t->ctx);
+}
+
+//Fills times[w-1] with the time of a modular exponentiation with windows of w bits.
+template<uint32_t Bits>
+static void ffbi_tune_windows(double* times)
+{
+	static void (*const runs[FFBI_TUNE_MAX_WINDOW_BITS])(void*) = {
+		ffbi_tune_pow_run<Bits, 1>, ffbi_tune_pow_run<Bits, 2>, ffbi_tune_pow_run<Bits, 3>,
+		ffbi_tune_pow_run<Bits, 4>, ffbi_tune_pow_run<Bits, 5>, ffbi_tune_pow_run<Bits, 6>};
+	ffbi_tune_pow<Bits>* t = new ffbi_tune_pow<Bits>;
+	ffbi_t* p = ffbi_create();
+	ffbi_tune_random(p, Bits, 1);
+	ffbi_fixed<Bits> m;
+	ffbi_fixed_from_bigint(&m, p);
+	ffbi_fixed_mont_init(&t->ctx, &m);
+	ffbi_tune_random(p, Bits - 1, 0);
+	ffbi_fixed_from_bigint(&t->n, p);
+	ffbi_tune_random(p, Bits, 0);
+	ffbi_fixed_from_bigint(&t->e, p);
+	ffbi_destroy(p);
+	for(int w=0;w<FFBI_TUNE_MAX_WINDOW_BITS;w++)
+		times[w] = ffbi_tune_median(runs[w], t, 5);
+	delete t;
+}
+
+static uint32_t ffbi_tune_window_bits(FILE* out)
+{
+	double times_1024[FFBI_TUNE_MAX_WINDOW_BITS];
+	double times_2048[FFBI_TUNE_MAX_WINDOW_BITS];
+	ffbi_tune_windows<1024>(times_1024);
+	ffbi_tune_windows<2048>(times_2048);
+	uint32_t best = 0;
+	double best_score = 0;
+	fprintf(out, "//window bits: ms at 1024 bits, ms at 2048 bits\n");
+	for(uint32_t w=0;w<FFBI_TUNE_MAX_WINDOW_BITS;w++)
+	{
+		fprintf(out, "//  %u: %.3f, %.3f\n", w + 1, times_1024[w], times_2048[w]);
+		//both sizes count the same no matter how much longer one of them takes
+		double score = times_1024[w]/times_1024[0] + times_2048[w]/times_2048[0];
+		if(w == 0 || score < best_score)
+		{
+			best = w;
+			best_score = score;
+		}
+	}
+	return best + 1;
+}
+
+typedef struct FFBI_TUNE_REDUCE
+{
+	ffbi_modctx_t* ctx;
+	ffbi_t* x;
+	ffbi_t* result;
+} ffbi_tune_reduce_t;
+
+static void ffbi_tune_reduce_run(void* param)
+{
+	ffbi_tune_reduce_t* t = (ffbi_tune_reduce_t*)param;
+	ffbi_modctx_reduce(t->ctx, t->result, t->x, NULL);
+}
+
+//Folds of m = 2^k - 2^(k-g) - 1 take g bits off. Returns the smallest g from which on the Solinas
+//reduction of products beats the general one at every k.
+static uint32_t ffbi_tune_fold_bits(FILE* out)
+{
+	static const uint32_t ks[] = {256, 512, 1024};
+	static const uint32_t gs[] = {8, 16, 24, 32, 40, 48, 64, 80, 96, 128};
+	const int num_ks = sizeof(ks)/sizeof(ks[0]);
+	const int num_gs = sizeof(gs)/sizeof(gs[0]);
+	uint32_t ret = 0;
+	ffbi_t* m = ffbi_create();
+	ffbi_t* term = ffbi_create();
+	ffbi_tune_reduce_t t;
+	t.x = ffbi_create();
+	t.result = ffbi_create();
+	fprintf(out, "//fold bits: us of Solinas and general reduction at k bits\n");
+	for(int i=0;i<num_ks;i++)
+	{
+		uint32_t k = ks[i];
+		ffbi_tune_random(t.x, 2*k, 0);
+		//the smallest fold size from which on Solinas always wins
+		uint32_t crossover = 0;
+		for(int j=num_gs-1;j>=0;j--)
+		{
+			uint32_t g = gs[j];
+			ffbi_from_string(m, "1", -1, 10);
+			ffbi_shl(m, m, k);
+			ffbi_from_string(term, "1", -1, 10);
+			ffbi_shl(term, term, k - g);
+			ffbi_sub(m, m, term);
+			ffbi_from_string(term, "1", -1, 10);
+			ffbi_sub(m, m, term);
+			t.ctx = ffbi_modctx_create_form(m, FFBI_MODCTX_SOLINAS);
+			double solinas = ffbi_tune_median(ffbi_tune_reduce_run, &t, 2000);
+			ffbi_modctx_destroy(t.ctx);
+			t.ctx = ffbi_modctx_create_form(m, FFBI_MODCTX_GENERAL);
+			double general = ffbi_tune_median(ffbi_tune_reduce_run, &t, 2000);
+			ffbi_modctx_destroy(t.ctx);
+			fprintf(out, "//  k=%u g=%u: %.3f, %.3f\n", k, g, solinas*1000, general*1000);
+			if(solinas >= general)
+				break;
+			crossover = g;
+		}
+		if(crossover == 0) //Solinas never won
+			crossover = k;
+		if(crossover > ret)
+			ret = crossover;
+	}
+	ffbi_destroy(m);
+	ffbi_destroy(term);
+	ffbi_destroy(t.x);
+	ffbi_destroy(t.result);
+	return ret;
+}
+
+//Folds of m = 2^(2g) - c with c of g bits take g bits off, the fewest a pseudo-Mersenne modulus of
+//2g bits allows. Returns the smallest g from which on the pseudo-Mersenne reduction of products beats
+//the general one, or twice the largest g measured if it never does.
+static uint32_t ffbi_tune_pseudo_mersenne_fold_bits(FILE* out)
+{
+	static const uint32_t gs[] = {8, 16, 24, 32, 40, 48, 64, 80, 96, 128, 192, 256};
+	const int num_gs = sizeof(gs)/sizeof(gs[0]);
+	uint32_t ret = 0;
+	ffbi_t* m = ffbi_create();
+	ffbi_t* c = ffbi_create();
+	ffbi_tune_reduce_t t;
+	t.x = ffbi_create();
+	t.result = ffbi_create();
+	fprintf(out, "//pseudo-Mersenne fold bits: us of pseudo-Mersenne and general reduction at twice as many bits\n");
+	for(int j=num_gs-1;j>=0;j--)
+	{
+		uint32_t g = gs[j];
+		//c = 2^(g-1) + 2^(g/2) + 1, as the cost of a fold doesn't depend on the other bits of c
+		ffbi_from_string(c, "1", -1, 10);
+		ffbi_shl(c, c, g/2);
+		ffbi_add_u(c, c, 1);
+		ffbi_from_string(m, "1", -1, 10);
+		ffbi_shl(m, m, g - 1);
+		ffbi_add(c, c, m);
+		ffbi_from_string(m, "1", -1, 10);
+		ffbi_shl(m, m, 2*g);
+		ffbi_sub(m, m, c);
+		//a product of two residues, (m - c)^2
+		ffbi_sub(t.x, m, c);
+		ffbi_mul(t.x, t.x, t.x);
+		t.ctx = ffbi_modctx_create_form(m, FFBI_MODCTX_PSEUDO_MERSENNE);
+		double pseudo_mersenne = ffbi_tune_median(ffbi_tune_reduce_run, &t, 2000);
+		ffbi_modctx_destroy(t.ctx);
+		t.ctx = ffbi_modctx_create_form(m, FFBI_MODCTX_GENERAL);
+		double general = ffbi_tune_median(ffbi_tune_reduce_run, &t, 2000);
+		ffbi_modctx_destroy(t.ctx);
+		fprintf(out, "//  g=%u: %.3f, %.3f\n", g, pseudo_mersenne*1000, general*1000);
+		if(pseudo_mersenne >= general)
+			break;
+		ret = g;
+	}
+	if(ret == 0) //pseudo-Mersenne never won
+		ret = gs[num_gs-1]*2;
+	ffbi_destroy(m);
+	ffbi_destroy(c);
+	ffbi_destroy(t.x);
+	ffbi_destroy(t.result);
+	return ret;
+}
+
+//Returns the milliseconds per key that ffrsa_create spends on building a sieve and finding two primes with it.
+static double ffbi_tune_sieve_time(ffrand_t* r, uint32_t sieve_size, uint32_t primorial_bits)
+{
+	ffrand_reseed(r, _seed, sizeof(_seed), 0);
+	double start = ffbi_tune_now_ms();
+	for(int i=0;i<FFBI_TUNE_SIEVE_KEYS;i++)
+	{
+		ffbi_sieve_t* sieve = ffbi_sieve_create();
+		ffbi_get_sieve(sieve, sieve_size);
+		ffbi_get_sieve_primorials(sieve, primorial_bits);
+		for(int j=0;j<2;j++)
+			ffbi_destroy(ffbi_create_random_large_prime(FFBI_TUNE_PRIME_BITS, 20, sieve));
+		ffbi_sieve_destroy(sieve);
+	}
+	return (ffbi_tune_now_ms() - start)/FFBI_TUNE_SIEVE_KEYS;
+}
+
+static void ffbi_tune_sieve(FILE* out, ffrand_t* r, uint32_t* sieve_size, uint32_t* primorial_bits)
+{
+	static const uint32_t sizes[] = {10000, 30000, 100000, 300000, 1000000};
+	static const uint32_t primorials[] = {FFBI_BITS_PER_DIGIT, FFBI_BITS_PER_DIGIT*4, FFBI_BITS_PER_DIGIT*16};
+	double best = 0;
+	fprintf(out, "//sieve size, primorial bits: ms per key of two %u-bit primes\n", FFBI_TUNE_PRIME_BITS);
+	for(size_t i=0;i<sizeof(sizes)/sizeof(sizes[0]);i++)
+	{
+		for(size_t j=0;j<sizeof(primorials)/sizeof(primorials[0]);j++)
+		{
+			double t = ffbi_tune_sieve_time(r, sizes[i], primorials[j]);
+			fprintf(out, "//  %u, %u: %.1f\n", sizes[i], primorials[j], t);
+			if(best == 0 || t < best)
+			{
+				best = t;
+				*sieve_size = sizes[i];
+				*primorial_bits = primorials[j];
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = argc > 1 ? argv[1] : "internal/ffbi_tune.h";
+	//candidates are drawn from the same stream for every configuration
+	ffrand_t* r = ffrand_create_seeded(_seed, sizeof(_seed));
+	ffbi_ctx_set_rand(ffbi_ctx_get_thread(), r);
+	//the measurements are collected here and copied into the header once they are all done
+	FILE* notes = tmpfile();
+	if(notes == NULL)
+	{
+		fprintf(stderr, "couldn't create a temporary file.\n");
+		return 1;
+	}
+	fprintf(stderr, "measuring exponentiation windows...\n");
+	uint32_t window_bits = ffbi_tune_window_bits(notes);
+	fprintf(stderr, "measuring Solinas folds...\n");
+	uint32_t fold_bits = ffbi_tune_fold_bits(notes);
+	fprintf(stderr, "measuring pseudo-Mersenne folds...\n");
+	uint32_t pseudo_mersenne_fold_bits = ffbi_tune_pseudo_mersenne_fold_bits(notes);
+	fprintf(stderr, "measuring sieves...\n");
+	uint32_t sieve_size = 0;
+	uint32_t primorial_bits = 0;
+	ffbi_tune_sieve(notes, r, &sieve_size, &primorial_bits);
+	ffbi_ctx_set_rand(ffbi_ctx_get_thread(), NULL);
+	ffrand_destroy(r);
+
+	FILE* out = fopen(path, "w");
+	if(out == NULL)
+	{
+		fprintf(stderr, "couldn't open %s.\n", path);
+		fclose(notes);
+		return 1;
+	}
+	time_t now = time(NULL);
+	char date[64];
+	strftime(date, sizeof(date), "%b %d, %Y", localtime(&now));
+	fprintf(out, "/*\n * ffbi_tune.h\n *\n *  Generated by tools/ffbi_tune.cpp on %s. Run it again instead of editing this file.\n */\n\n", date);
+	fprintf(out, "#ifndef FFBI_TUNE_H_\n#define FFBI_TUNE_H_\n\n");
+	rewind(notes);
+	char line[256];
+	while(fgets(line, sizeof(line), notes))
+		fputs(line, out);
+	fclose(notes);
+	fprintf(out, "\n#define FFBI_FIXED_WINDOW_BITS %u\n", window_bits);
+	fprintf(out, "#define FFBI_MODCTX_MIN_FOLD_BITS %u\n", fold_bits);
+	fprintf(out, "#define FFBI_MODCTX_MIN_PSEUDO_MERSENNE_FOLD_BITS %u\n", pseudo_mersenne_fold_bits);
+	fprintf(out, "#define FFRSA_SIEVE_SIZE %u\n", sieve_size);
+	fprintf(out, "#define FFRSA_SIEVE_PRIMORIAL_BITS %u\n", primorial_bits);
+	fprintf(out, "\n#endif /* FFBI_TUNE_H_ */\n");
+	fclose(out);
+	fprintf(stderr, "wrote %s\n", path);
+	return 0;
+}